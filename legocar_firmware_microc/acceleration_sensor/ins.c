@@ -11,16 +11,112 @@
 #include "includes.h"
 
 #include <unistd.h>
+#include <math.h>
 
 #include "../terasic_lib/terasic_includes.h"
 #include "../terasic_lib/accelerometer_adxl345_spi.h"
+#include "../terasic_lib/terasic_spi.h"
 
+#include "ins_storage.h"
+#include "../telemetry/deferred_log.h"
 
 
 
+// the time between two samples is only measured, if it is at least this number of clock ticks
+#define MIN_TICKS_PER_TIMESTEP 10
+
+
+/**
+ * Current time of the clock of the INS (see INS.clock_freq).
+ */
+static alt_u32 read_ins_clock(const INS *ins) {
+	return ins->use_timestamp ? alt_timestamp() : alt_nticks();
+}
+
+/**
+ * Remember the time of a read from the sensor and update the timing statistics.
+ */
+static void record_read_time(INS *ins, alt_u32 now) {
+	INSTiming *timing = &ins->timing;
+
+	// no previous read => no interval
+	timing->last_interval = 0;
+	if(timing->has_previous) {
+		alt_u32 interval = now - timing->last_read;
+
+		if(timing->intervals == 0 || interval < timing->min_interval)
+			timing->min_interval = interval;
+		if(timing->intervals == 0 || interval > timing->max_interval)
+			timing->max_interval = interval;
+
+		timing->sum_interval    += interval;
+		timing->sum_sq_interval += (alt_u64) interval * interval;
+		timing->intervals++;
+
+		timing->last_interval = interval;
+	}
+
+	timing->last_read    = now;
+	timing->has_previous = 1;
+}
+
+
+/**
+ * Use the calibration from the flash, if it is valid for the sensor.
+ */
+static int load_ins_calibration(INS *ins) {
+	INSCalibrationRecord record;
+	double bias[GSENSOR_DIM];
+	double variance[GSENSOR_DIM];
+	int j;
+
+	if(!read_ins_calibration(EPCS_NAME, &record))
+		return 0;
+
+	// later records continue the sequence, even if this one is not valid
+	if(record.magic == INS_CALIBRATION_MAGIC)
+		ins->calibration_sequence = record.sequence;
+
+	if(!check_ins_calibration(&record, ins->sensor_id))
+		return 0;
+
+	for(j=0; j<GSENSOR_DIM; j++) {
+		bias[j]     = record.bias[j];
+		variance[j] = record.variance[j];
+		ins->sensor_calibration[j] = bias[j] * ms2_per_digi;
+	}
+
+	// as much weight as one window: the online calibration adapts quickly if the sensor has drifted
+	seed_ins_calibrator(&ins->calibrator, bias, variance, CALIBRATION_WINDOW);
+
+	return 1;
+}
+
 INS *init_ins(INS *ins, alt_u32 sensor_spi_base_addr) {
 
 	ins->sensor_spi_base_addr = sensor_spi_base_addr;
+	ins->sample_period = 0.0;
+	ins->sample_time = 0;
+	ins->samples = 0;
+
+	// the samples are tagged with the timestamp timer, or with the system timer if there is none
+	if(alt_timestamp_start() < 0) {
+		ins->use_timestamp = 0;
+		ins->clock_freq    = alt_ticks_per_second();
+	}
+	else {
+		ins->use_timestamp = 1;
+		ins->clock_freq    = alt_timestamp_freq();
+	}
+
+	ins->timing.has_previous = 0;
+	ins->timing.last_read = 0;
+	ins->timing.last_interval = 0;
+	reset_ins_timing_stats(ins);
+
+	// the calibration is computed while sampling
+	ins->online_calibration = 1;
+	init_ins_calibrator(&ins->calibrator);
 
 	ADXL345_SPI_Init( ins->sensor_spi_base_addr );
 
@@ -31,15 +127,40 @@ INS *init_ins(INS *ins, alt_u32 sensor_spi_base_addr) {
 		ins->acceleration[j]       = 0.0;
 		ins->speed[j]              = 0.0;
 		ins->distance[j]           = 0.0;
+		ins->sample[j]             = 0;
 	}
 
+	// with a calibration from the flash, the INS is calibrated right away
+	ins->sensor_id = 0;
+	ins->calibration_sequence = 0;
+	ADXL345_SPI_IdRead( ins->sensor_spi_base_addr, &ins->sensor_id );
+	ins->calibration_stored = load_ins_calibration(ins);
+
 	return ins;
 }
 
+/**
+ * Use the calibration of the INS as a start for the online calibration.
+ */
+static void seed_calibrator(INS *ins, const double variance[GSENSOR_DIM], double count) {
+	double bias[GSENSOR_DIM];
+	int j;
+
+	for(j=0; j<GSENSOR_DIM; j++)
+		bias[j] = ins->sensor_calibration[j] / ms2_per_digi;
+
+	seed_ins_calibrator(&ins->calibrator, bias, variance, count);
+}
+
 void calibrate_ins(INS *ins, double x, double y, double z) {
+	const double variance[GSENSOR_DIM] = { 0.0, 0.0, 0.0 };
+
 	ins->sensor_calibration[0] = x;
 	ins->sensor_calibration[1] = y;
 	ins->sensor_calibration[2] = z;
+
+	// as much weight as one window of the online calibration
+	seed_calibrator(ins, variance, CALIBRATION_WINDOW);
 }
 
 int auto_calibrate_ins(INS *ins, int values) {
@@ -47,36 +168,32 @@ int auto_calibrate_ins(INS *ins, int values) {
 	// set to 0 when we cannot read from the sensor
 	int success = 1;
 
-	// sensor output
-	alt_16 cal_acceleration[GSENSOR_DIM];
-
 	// initialize the array that is used below for calculating the average output
 	// of the acceleration sensor
 	double sum[GSENSOR_DIM];
+	double sum_sq[GSENSOR_DIM];
+	double variance[GSENSOR_DIM];
 	int j;
-	for(j=0; j<GSENSOR_DIM; j++)
-		sum[j] = 0.0;
+	for(j=0; j<GSENSOR_DIM; j++) {
+		sum[j]    = 0.0;
+		sum_sq[j] = 0.0;
+	}
 
 	// read #values values from the sensor
 	int i;
 	for(i=0; i<values; i++) {
 		// wait for next value from sensor
 		if(!wait_for_data(ins)) {
+			deferred_log("ERROR: cannot read from sensor!\n");
 			success = 0;
 			return success;
 		}
 
-		// read acceleration data from the sensor
-		success = ADXL345_SPI_XYZ_Read( ins->sensor_spi_base_addr, (alt_u16 *) cal_acceleration );
-
-		if(!success) {
-			printf("ERROR: cannot read from sensor!\n");
-			return success;
-		}
-
 		// update sums with the latest output
-		for(j=0; j<GSENSOR_DIM; j++)
-			sum[j] += cal_acceleration[j];
+		for(j=0; j<GSENSOR_DIM; j++) {
+			sum[j]    += ins->sample[j];
+			sum_sq[j] += ins->sample[j] * ins->sample[j];
+		}
 
 		// make a small pause until we try to get the next data from the sensor
 		OSTimeDlyHMSM(0, 0, 0, data_wait);
@@ -84,55 +201,204 @@ int auto_calibrate_ins(INS *ins, int values) {
 	}
 
 	// calculate the average values for all the dimensions
-	for(j=0; j<GSENSOR_DIM; j++)
+	for(j=0; j<GSENSOR_DIM; j++) {
 		ins->sensor_calibration[j] = sum[j] / values * ms2_per_digi;
+		variance[j] = sum_sq[j] / values - (sum[j] / values) * (sum[j] / values);
+	}
+
+	// the online calibration continues from here
+	seed_calibrator(ins, variance, values);
 
 	// reset the speed to 0 as the system has to be standing still now
 	for(j=0; j<GSENSOR_DIM; j++)
 		ins->speed[j] = 0.0;
 
+	ins->samples = 0;
+
 	return success;
 }
 
+void set_ins_online_calibration(INS *ins, int enabled) {
+	ins->online_calibration = enabled;
+}
+
+int ins_is_calibrated(const INS *ins) {
+	return ins->calibrator.converged;
+}
+
+int save_ins_calibration(INS *ins) {
+	INSCalibrationRecord record;
+
+	return prepare_ins_calibration(ins, &record) && store_ins_calibration(ins, &record);
+}
+
+int prepare_ins_calibration(INS *ins, INSCalibrationRecord *record) {
+
+	// the quietest window of a moving car is no calibration for the next boot
+	if(!ins_is_calibrated(ins) || ins->calibrator.fallback)
+		return 0;
+
+	pack_ins_calibration(record, &ins->calibrator, ins->sensor_id, ins->calibration_sequence + 1,
+	                     (alt_u32) ((alt_u64) alt_nticks() * 1000 / alt_ticks_per_second()));
+	return 1;
+}
+
+int store_ins_calibration(INS *ins, const INSCalibrationRecord *record) {
+
+	if(!write_ins_calibration(EPCS_NAME, record))
+		return 0;
+
+	ins->calibration_sequence = record->sequence;
+	ins->calibration_stored = 1;
+	return 1;
+}
+
 int wait_for_data(INS *ins) {
 	int i = 0;
+	alt_u8 int_source;
 
-	while( !ADXL345_SPI_IsDataReady( ins->sensor_spi_base_addr ) ) {
+	// status and data are read in one transaction: the data is only used if it is new
+	while( !ADXL345_SPI_ReadStatusAndXYZ( ins->sensor_spi_base_addr, &int_source, (alt_u16 *) ins->sample )
+	       || !(int_source & XL345_DATAREADY) ) {
 		if(i++ >= sensor_read_tries)
 			return 0;
 
 		OSTimeDlyHMSM(0, 0, 0, data_wait);
 	}
 
+	// tag the sample with the time it has been read
+	ins->sample_time = read_ins_clock(ins);
+	record_read_time(ins, ins->sample_time);
+
 	return 1;
 }
 
 int update_ins(INS *ins, double timestep) {
 
-	// check the sensor calibration for Z-axis: if this is 0, the ins has probably not been calibrated
-	// => g-force
-	if(ins->sensor_calibration[2] == 0)
-		printf("WARNING: g-sensor has probably not been calibrated!\n");
+	// without online calibration the INS has to be calibrated before
+	if(!ins->online_calibration && !ins_is_calibrated(ins))
+		deferred_log("WARNING: g-sensor has probably not been calibrated!\n");
 
+	// the new data is read together with the status
 	if(!wait_for_data(ins))
 		return 0;
 
-	bool success;
-	alt_16 acc[GSENSOR_DIM];
+	// use the measured time since the previous sample, if the clock resolves it well enough
+	if(ins->timing.last_interval != 0 && ins->samples > 0 && timestep * ins->clock_freq >= MIN_TICKS_PER_TIMESTEP)
+		timestep = (double) ins->timing.last_interval / ins->clock_freq;
 
-	success = ADXL345_SPI_XYZ_Read(ins->sensor_spi_base_addr, (alt_u16 *) acc);
-	if(!success) {
-		printf("ERROR: reading from sensor failed!\n");
-		return 0;
-	}
+	update_ins_sample(ins, ins->sample, timestep);
 
-	// update the state of the ins
+	return 1;
+}
+
+void update_ins_sample(INS *ins, const alt_16 acc[GSENSOR_DIM], double timestep) {
 	int j;
+
+	if(ins->online_calibration) {
+		// the car has been standing still => refine the calibration
+		if(update_ins_calibrator(&ins->calibrator, acc))
+			for(j=0; j<GSENSOR_DIM; j++)
+				ins->sensor_calibration[j] = ins->calibrator.mean[j] * ms2_per_digi;
+
+		// without calibration the integration is useless
+		if(!ins_is_calibrated(ins))
+			return;
+	}
+
 	for(j=0; j<GSENSOR_DIM; j++) {
-		ins->acceleration[j] = ((int) acc[j]) * ms2_per_digi - ins->sensor_calibration[j];
-		ins->speed[j]       += ins->acceleration[j] * timestep;
-		ins->distance[j]    += ins->speed[j]        * timestep;
+		double acceleration = ((int) acc[j]) * ms2_per_digi - ins->sensor_calibration[j];
+		double speed;
+
+		// there is no previous value for the first sample
+		if(ins->samples == 0)
+			ins->acceleration[j] = acceleration;
+
+		// trapezoidal rule: average of the previous and the current value
+		speed = ins->speed[j] + (ins->acceleration[j] + acceleration) * 0.5 * timestep;
+		ins->distance[j] += (ins->speed[j] + speed) * 0.5 * timestep;
+
+		ins->acceleration[j] = acceleration;
+		ins->speed[j]        = speed;
 	}
 
+	ins->samples++;
+}
+
+int enable_ins_fifo(INS *ins, alt_u8 rate, alt_u8 watermark) {
+
+	if(!ADXL345_SPI_FifoInit(ins->sensor_spi_base_addr, rate, watermark))
+		return 0;
+
+	// output data rate of the sensor: 3200 Hz, halved for every step below XL345_RATE_3200
+	ins->sample_period = 1.0 / 3200.0 * (1 << (XL345_RATE_3200 - rate));
+
+	// the noise of the sensor grows with the rate
+	set_ins_calibrator_rate(&ins->calibrator, 1.0 / ins->sample_period);
+
 	return 1;
 }
+
+int update_ins_batch(INS *ins) {
+	alt_16 acc[XL345_FIFO_MAX_ENTRIES][GSENSOR_DIM];
+	alt_u8 samples;
+	bool success;
+
+	// read all samples that are currently queued
+	success = ADXL345_SPI_FifoRead(ins->sensor_spi_base_addr, (alt_u16 (*)[GSENSOR_DIM]) acc, XL345_FIFO_MAX_ENTRIES, &samples);
+
+	// the samples are timed by the clock of the sensor, the time of the reads shows
+	// whether we are keeping up with the sensor
+	record_read_time(ins, read_ins_clock(ins));
+	if(samples == XL345_FIFO_MAX_ENTRIES)
+		ins->timing.fifo_overflows++;
+
+	// integrate the samples that have been read, even if the transfer failed in between
+	int i;
+	for(i=0; i<samples; i++)
+		update_ins_sample(ins, acc[i], ins->sample_period);
+
+	if(!success) {
+		SPI_STATS spi;
+
+		// a timeout of the SPI core or an error of the sensor
+		SPI_GetTotalStats(&spi);
+		deferred_log("ERROR: reading from sensor failed! (SPI timeouts: %u of %u transfers)\n",
+		             spi.nTimeouts, spi.nTransfers);
+		return -1;
+	}
+
+	return samples;
+}
+
+void get_ins_timing_stats(const INS *ins, INSTimingStats *stats) {
+	const INSTiming *timing = &ins->timing;
+
+	stats->intervals      = timing->intervals;
+	stats->fifo_overflows = timing->fifo_overflows;
+
+	if(timing->intervals == 0 || ins->clock_freq == 0) {
+		stats->mean_interval = 0.0;
+		stats->jitter        = 0.0;
+		stats->min_interval  = 0.0;
+		stats->max_interval  = 0.0;
+		return;
+	}
+
+	double mean     = (double) timing->sum_interval    / timing->intervals;
+	double variance = (double) timing->sum_sq_interval / timing->intervals - mean * mean;
+
+	stats->mean_interval = mean / ins->clock_freq;
+	stats->jitter        = (variance > 0 ? sqrt(variance) : 0.0) / ins->clock_freq;
+	stats->min_interval  = (double) timing->min_interval / ins->clock_freq;
+	stats->max_interval  = (double) timing->max_interval / ins->clock_freq;
+}
+
+void reset_ins_timing_stats(INS *ins) {
+	ins->timing.intervals       = 0;
+	ins->timing.min_interval    = 0;
+	ins->timing.max_interval    = 0;
+	ins->timing.sum_interval    = 0;
+	ins->timing.sum_sq_interval = 0;
+	ins->timing.fifo_overflows  = 0;
+}
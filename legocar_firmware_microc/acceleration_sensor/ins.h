@@ -10,20 +10,53 @@
 
 #include <alt_types.h>
 
+#include "ins_calibrator.h"
+#include "ins_storage.h"
+
 //! number of dimensions, the accelerometer is designed measure
 #define GSENSOR_DIM 3
 
 
 //! conversion factor from one step in the output to m/s²
-const double ms2_per_digi = 0.04;
+static const double ms2_per_digi = 0.04;
 
 //! number of tries to read a value from the acceleration sensor before we give up
-const int sensor_read_tries = 1000;
+static const int sensor_read_tries = 1000;
 
 //! time in ms to wait until we try to get the next XYZ-data from the g-sensor
-const int data_wait  = 1;
+static const int data_wait  = 1;
+
+
+
+/**
+ * Raw statistics of the time between two reads from the sensor
+ * (in ticks of the clock of the INS, see INS.clock_freq)
+ */
+typedef struct INSTiming {
+	int     has_previous;    // 1: last_read holds the time of a previous read
+	alt_u32 last_read;       // time of the latest read
+	alt_u32 last_interval;   // time between the two latest reads (0: not measured)
+	alt_u32 intervals;       // number of measured intervals
+	alt_u32 min_interval;
+	alt_u32 max_interval;
+	alt_u64 sum_interval;
+	alt_u64 sum_sq_interval;
+	alt_u32 fifo_overflows;  // number of reads that found the FIFO completely full
+} INSTiming;
 
 
+/**
+ * Statistics of the time between two reads from the sensor (see 'get_ins_timing_stats')
+ */
+typedef struct INSTimingStats {
+	alt_u32 intervals;      // number of measured intervals
+	double  mean_interval;  // in seconds
+	double  jitter;         // standard deviation of the interval (in seconds)
+	double  min_interval;   // in seconds
+	double  max_interval;   // in seconds
+	alt_u32 fifo_overflows; // number of reads that found the FIFO completely full (samples may have been lost)
+} INSTimingStats;
+
 
 /**
  * Inertial Navigation System
@@ -32,16 +65,37 @@ const int data_wait  = 1;
  */
 typedef struct INS {
 	alt_u32 sensor_spi_base_addr;
+	double  sample_period; // time between two samples in the FIFO of the sensor (in seconds)
 	double  sensor_calibration[GSENSOR_DIM]; // needs VERY precise quantification
 	double  acceleration[GSENSOR_DIM];
 	double  speed[GSENSOR_DIM];
 	double  distance[GSENSOR_DIM];
+
+	alt_16  sample[GSENSOR_DIM]; // latest raw output of the sensor (see 'wait_for_data')
+	alt_u32 sample_time;         // time of the moment the sample was read (in ticks of the clock)
+
+	alt_u32 samples;             // number of samples integrated since the last reset of the speed
+	// the reads are timed with the timestamp timer, or with the system timer (alt_nticks)
+	// if the SOPC has no timestamp timer
+	int     use_timestamp;       // 1: timestamp timer, 0: system timer
+	alt_u32 clock_freq;          // ticks per second of the clock
+	INSTiming timing;
+
+	// online calibration while sampling (see 'set_ins_online_calibration')
+	int online_calibration;
+	INSCalibrator calibrator;
+
+	// calibration in the flash (see 'save_ins_calibration')
+	alt_u8  sensor_id;           // device ID of the sensor
+	alt_u32 calibration_sequence; // sequence number of the last record in the flash
+	int     calibration_stored;  // 1: the flash holds the calibration that has been used since booting
 } INS;
 
 
 
 /**
  * Create a new INS
+ * If the flash holds a valid calibration for the sensor, it is used right away.
  *
  * @param ins pointer to reserved memory
  * @param sensor_spi_base_address spi-base-address of the sensor
@@ -53,6 +107,7 @@ INS *init_ins(INS *ins, alt_u32 sensor_spi_base_addr);
 
 /**
  * Calibrate the INS manually.
+ * The online calibration (if enabled) starts with these values and refines them.
  *
  * @param x average value for x-axis (1st axis)
  * @param y average value for y-axis (2nd axis)
@@ -64,6 +119,8 @@ void calibrate_ins(INS *ins, double x, double y, double z);
 /**
  * Calculate the calibration of the INS using the output of the sensor.
  * We will calculate the average of the first #values data packages from the sensor.
+ * This blocks the calling task until all values have been read. Usually the online
+ * calibration is sufficient (see 'set_ins_online_calibration').
  *
  * @param ins the INS
  * @param values number of data packages from the sensor to use for the calibration
@@ -73,9 +130,67 @@ void calibrate_ins(INS *ins, double x, double y, double z);
 int  auto_calibrate_ins(INS *ins, int values);
 
 
+/**
+ * Enable or disable the online calibration. If it is enabled (default), the calibration is
+ * computed from the samples while the car is standing still and refined whenever the car
+ * stands still again. Until the first calibration, samples are not integrated.
+ *
+ * @param ins the INS
+ * @param enabled 1: enable, 0: disable (the current calibration is kept)
+ */
+void set_ins_online_calibration(INS *ins, int enabled);
+
+
+/**
+ * Check whether the INS has been calibrated (manually, automatically or online).
+ *
+ * @param ins the INS
+ *
+ * @return 1 if the INS is calibrated, 0 else
+ */
+int  ins_is_calibrated(const INS *ins);
+
+
+/**
+ * Store the current calibration in the flash, so that it is available after the next boot.
+ * Erasing the flash block blocks the calling task for about 1 s, so tasks with a high priority
+ * use 'prepare_ins_calibration' and let a background task call 'store_ins_calibration'.
+ *
+ * @param ins the INS (must be calibrated, not by the fallback of the online calibration)
+ *
+ * @return 1 if the calibration has been stored, 0 else
+ */
+int  save_ins_calibration(INS *ins);
+
+
+/**
+ * Fill a record with the current calibration, to be written by 'store_ins_calibration'.
+ * Does not access the flash.
+ *
+ * @param ins the INS (must be calibrated, not by the fallback of the online calibration)
+ * @param record the record
+ *
+ * @return 1 if the record has been filled, 0 else
+ */
+int  prepare_ins_calibration(INS *ins, INSCalibrationRecord *record);
+
+
+/**
+ * Write a record filled by 'prepare_ins_calibration' to the flash (takes about 1 s).
+ *
+ * @param ins the INS
+ * @param record the record
+ *
+ * @return 1 if the calibration has been stored, 0 else
+ */
+int  store_ins_calibration(INS *ins, const INSCalibrationRecord *record);
+
+
 /**
  * Wait until the next data item from the sensor is available, or the maximum number
  * of tries is exceeded.
+ * The status and the data are read from the sensor at once. If new data was available,
+ * it is stored in ins->sample.
  *
  * @param ins the INS
  *
@@ -86,13 +201,72 @@ int  wait_for_data(INS *ins);
 
 /**
  * Update the INS with the next data package from the sensor.
+ * The sample is integrated over the time that has really passed since the previous sample,
+ * using the trapezoidal rule. The time is only measured if the clock of the INS resolves the
+ * time step well enough: the system timer (1 ms) does not at the sample rates of the sensor.
  *
  * @param ins the INS
- * @param timestep time difference since the last update (to calculate updates in speed and distance)
+ * @param timestep expected time difference since the last update, used if the time cannot
+ *        be measured or for the first sample
  *
  * @result 1: success, 0: no data available or sensor read error
  */
 int  update_ins(INS *ins, double timestep);
 
 
+/**
+ * Update the INS with a sample of the sensor that has been read elsewhere.
+ * Acceleration and speed are integrated using the trapezoidal rule.
+ * The sample is passed to the online calibration as well.
+ *
+ * @param ins the INS
+ * @param acc raw output of the sensor
+ * @param timestep time difference since the last sample
+ */
+void update_ins_sample(INS *ins, const alt_16 acc[GSENSOR_DIM], double timestep);
+
+
+/**
+ * Switch the sensor to FIFO stream mode: the sensor queues its samples, which can be read
+ * in one pass with 'update_ins_batch'.
+ *
+ * @param ins the INS
+ * @param rate output data rate of the sensor (XL345_RATE_*, at most XL345_RATE_3200)
+ * @param watermark number of queued samples that trigger the watermark interrupt (at most 31)
+ *
+ * @result 1: success, 0: sensor write error
+ */
+int  enable_ins_fifo(INS *ins, alt_u8 rate, alt_u8 watermark);
+
+
+/**
+ * Update the INS with all the samples that are queued in the FIFO of the sensor.
+ * The samples are integrated with the sample period of the sensor.
+ * The FIFO has to be enabled with 'enable_ins_fifo'.
+ *
+ * @param ins the INS
+ *
+ * @result number of samples that have been processed (0 if no data was available), -1 on sensor read error
+ */
+int  update_ins_batch(INS *ins);
+
+
+/**
+ * Get the statistics of the time between two reads from the sensor.
+ * In FIFO mode (see 'update_ins_batch') this is the time between two batches.
+ *
+ * @param ins the INS
+ * @param stats the statistics are written to this structure
+ */
+void get_ins_timing_stats(const INS *ins, INSTimingStats *stats);
+
+
+/**
+ * Reset the statistics of the time between two reads from the sensor.
+ *
+ * @param ins the INS
+ */
+void reset_ins_timing_stats(INS *ins);
+
+
 #endif /* INS_H_ */
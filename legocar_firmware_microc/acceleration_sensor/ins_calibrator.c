@@ -0,0 +1,168 @@
+/*
+ * ins_calibrator.c
+ *
+ *  Created on: 17.10.2026
+ */
+
+#include "ins_calibrator.h"
+
+
+/**
+ * Start a new window.
+ */
+static void reset_window(INSCalibrator *cal) {
+	int j;
+
+	cal->window_count = 0;
+	for(j=0; j<CALIBRATOR_DIM; j++) {
+		cal->window_sum[j]    = 0;
+		cal->window_sum_sq[j] = 0;
+	}
+}
+
+void init_ins_calibrator(INSCalibrator *cal) {
+	int j;
+
+	reset_window(cal);
+
+	set_ins_calibrator_rate(cal, CALIBRATION_DEFAULT_RATE);
+	cal->best_variance = 0.0;
+
+	cal->count = 0.0;
+	for(j=0; j<CALIBRATOR_DIM; j++) {
+		cal->mean[j] = 0.0;
+		cal->m2[j]   = 0.0;
+	}
+
+	cal->converged      = 0;
+	cal->fallback       = 0;
+	cal->still_windows  = 0;
+	cal->moving_windows = 0;
+}
+
+void set_ins_calibrator_rate(INSCalibrator *cal, double rate) {
+	cal->still_variance = calibration_still_factor * calibration_noise_variance_100hz * rate / 100.0;
+
+	if(cal->still_variance < calibration_min_still_variance)
+		cal->still_variance = calibration_min_still_variance;
+}
+
+/**
+ * Merge a window into the overall estimate.
+ */
+static void merge_window(INSCalibrator *cal, const double window_mean[CALIBRATOR_DIM], const double window_m2[CALIBRATOR_DIM]) {
+	double count;
+	int j;
+
+	// follow slow drifts: older windows lose weight once the maximum is reached
+	if(cal->count + CALIBRATION_WINDOW > calibration_max_samples) {
+		double scale = (calibration_max_samples - CALIBRATION_WINDOW) / cal->count;
+
+		cal->count *= scale;
+		for(j=0; j<CALIBRATOR_DIM; j++)
+			cal->m2[j] *= scale;
+	}
+
+	// Welford / Chan et al.
+	count = cal->count + CALIBRATION_WINDOW;
+	for(j=0; j<CALIBRATOR_DIM; j++) {
+		double delta = window_mean[j] - cal->mean[j];
+
+		cal->mean[j] += delta * CALIBRATION_WINDOW / count;
+		cal->m2[j]   += window_m2[j] + delta * delta * cal->count * CALIBRATION_WINDOW / count;
+	}
+	cal->count = count;
+}
+
+void seed_ins_calibrator(INSCalibrator *cal, const double bias[CALIBRATOR_DIM], const double variance[CALIBRATOR_DIM], double count) {
+	double still_variance = cal->still_variance;
+	int j;
+
+	// the threshold stays adapted to the rate of the sensor
+	init_ins_calibrator(cal);
+	cal->still_variance = still_variance;
+
+	if(count > calibration_max_samples)
+		count = calibration_max_samples;
+
+	cal->count = count;
+	for(j=0; j<CALIBRATOR_DIM; j++) {
+		cal->mean[j] = bias[j];
+		cal->m2[j]   = variance[j] * count;
+	}
+
+	cal->converged = 1;
+}
+
+int update_ins_calibrator(INSCalibrator *cal, const alt_16 acc[CALIBRATOR_DIM]) {
+	double window_mean[CALIBRATOR_DIM];
+	double window_m2[CALIBRATOR_DIM];
+	double variance = 0.0;
+	int j;
+
+	for(j=0; j<CALIBRATOR_DIM; j++) {
+		cal->window_sum[j]    += acc[j];
+		cal->window_sum_sq[j] += (alt_32) acc[j] * acc[j];
+	}
+
+	if(++cal->window_count < CALIBRATION_WINDOW)
+		return 0;
+
+	// end of the window: mean and variance of every axis
+	for(j=0; j<CALIBRATOR_DIM; j++) {
+		window_mean[j] = (double) cal->window_sum[j] / CALIBRATION_WINDOW;
+		window_m2[j]   = (double) cal->window_sum_sq[j] - window_mean[j] * cal->window_sum[j];
+
+		if(window_m2[j] / CALIBRATION_WINDOW > variance)
+			variance = window_m2[j] / CALIBRATION_WINDOW;
+	}
+	reset_window(cal);
+
+	// the car has been moving => the mean is no bias
+	if(variance > cal->still_variance) {
+		cal->moving_windows++;
+
+		if(cal->converged)
+			return 0;
+
+		// remember the quietest window, until there has been a still one
+		if(cal->best_variance == 0.0 || variance < cal->best_variance) {
+			cal->best_variance = variance;
+			for(j=0; j<CALIBRATOR_DIM; j++) {
+				cal->best_mean[j] = window_mean[j];
+				cal->best_m2[j]   = window_m2[j];
+			}
+		}
+
+		// the car does not stand still long enough (or the threshold is too low for the sensor)
+		if(cal->moving_windows < CALIBRATION_FALLBACK_WINDOWS)
+			return 0;
+
+		merge_window(cal, cal->best_mean, cal->best_m2);
+		cal->converged = 1;
+		cal->fallback  = 1;
+		return 1;
+	}
+
+	// a still window replaces an estimate from the fallback
+	if(cal->fallback) {
+		cal->count = 0.0;
+		for(j=0; j<CALIBRATOR_DIM; j++)
+			cal->m2[j] = 0.0;
+		cal->fallback = 0;
+	}
+
+	merge_window(cal, window_mean, window_m2);
+
+	cal->converged = 1;
+	cal->still_windows++;
+
+	return 1;
+}
+
+double ins_calibrator_variance(const INSCalibrator *cal, int axis) {
+	if(cal->count == 0.0)
+		return 0.0;
+
+	return cal->m2[axis] / cal->count;
+}
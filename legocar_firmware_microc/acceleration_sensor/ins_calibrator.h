@@ -0,0 +1,130 @@
+/*
+ * ins_calibrator.h
+ *
+ * Online calibration of the acceleration sensor: the average output of the sensor
+ * (bias) is estimated during normal sampling, whenever the car is standing still.
+ *
+ * The samples are collected in windows of CALIBRATION_WINDOW samples. At the end of a
+ * window the mean and the variance of every axis are computed; if the variance shows that
+ * the car has been standing still, the window is merged into the overall estimate
+ * (Welford's online algorithm, applied to whole windows). Windows with movement are dropped.
+ * If the car never stands still long enough (e.g. vibrations of the engines), the quietest of
+ * the first CALIBRATION_FALLBACK_WINDOWS windows is taken as a first estimate.
+ *
+ *  Created on: 17.10.2026
+ */
+
+#ifndef INS_CALIBRATOR_H_
+#define INS_CALIBRATOR_H_
+
+#include <alt_types.h>
+
+//! number of dimensions of the sensor (see ins.h)
+#define CALIBRATOR_DIM 3
+
+//! number of samples in one window
+#define CALIBRATION_WINDOW 256
+
+//! noise of the sensor at an output data rate of 100 Hz (variance in sensor steps², worst axis):
+//! the data sheet of the ADXL345 gives 1.1 LSB rms for the Z-axis (X and Y: 0.75 LSB rms).
+//! The noise density is flat, so the variance grows linearly with the output data rate.
+static const double calibration_noise_variance_100hz = 1.21;
+
+//! a window is still if the variance of every axis is at most this multiple of the noise:
+//! covers the spread of the variance over one window (about 10 % for 256 samples)
+//! and the vibrations of the idle engines
+static const double calibration_still_factor = 4.0;
+
+//! lower bound of the still threshold (in sensor steps²): at low rates the noise is below one step
+static const double calibration_min_still_variance = 1.0;
+
+//! output data rate of the sensor (in Hz) until 'set_ins_calibrator_rate' is called (see ADXL345_SPI_Init)
+#define CALIBRATION_DEFAULT_RATE 400.0
+
+//! without a still window, the quietest window is taken after this number of windows
+#define CALIBRATION_FALLBACK_WINDOWS 16
+
+//! the overall estimate never counts more samples than this, so that it follows slow drifts of the sensor
+static const double calibration_max_samples = 64.0 * CALIBRATION_WINDOW;
+
+
+typedef struct INSCalibrator {
+	// sums of the current window (exact integer arithmetic)
+	int     window_count;
+	alt_32  window_sum[CALIBRATOR_DIM];
+	alt_64  window_sum_sq[CALIBRATOR_DIM];
+
+	// overall estimate from all windows in which the car was standing still
+	double  count;                // number of samples in the estimate
+	double  mean[CALIBRATOR_DIM]; // bias in sensor steps
+	double  m2[CALIBRATOR_DIM];   // sum of squared deviations from the mean
+
+	double  still_variance;       // maximum variance (in sensor steps²) of a still window
+
+	// quietest window so far, used if there is no still window (see CALIBRATION_FALLBACK_WINDOWS)
+	double  best_variance;        // largest variance of the axes, 0: no window yet
+	double  best_mean[CALIBRATOR_DIM];
+	double  best_m2[CALIBRATOR_DIM];
+
+	int     converged;            // 1: at least one still window => the mean is a valid bias
+	int     fallback;             // 1: the bias is the quietest window, not a still one
+	alt_u32 still_windows;        // number of windows that have been merged
+	alt_u32 moving_windows;       // number of windows that have been dropped
+} INSCalibrator;
+
+
+/**
+ * Reset the calibrator: all previous estimates are dropped.
+ * The threshold for still windows is set for CALIBRATION_DEFAULT_RATE.
+ *
+ * @param cal the calibrator
+ */
+void init_ins_calibrator(INSCalibrator *cal);
+
+
+/**
+ * Adapt the threshold for still windows to the output data rate of the sensor, as the
+ * noise of the sensor grows with the rate.
+ *
+ * @param cal the calibrator
+ * @param rate output data rate of the sensor (in Hz)
+ */
+void set_ins_calibrator_rate(INSCalibrator *cal, double rate);
+
+
+/**
+ * Start the calibrator with a known bias (e.g. from a manual calibration).
+ * The threshold for still windows is kept.
+ *
+ * @param cal the calibrator
+ * @param bias average output of the sensor (in sensor steps)
+ * @param variance variance of the output of the sensor (in sensor steps²)
+ * @param count number of samples that the bias is based on
+ */
+void seed_ins_calibrator(INSCalibrator *cal, const double bias[CALIBRATOR_DIM], const double variance[CALIBRATOR_DIM], double count);
+
+
+/**
+ * Add a sample of the sensor to the calibrator.
+ * Costs only integer additions, except for the last sample of a window.
+ * If there is no still window within the first CALIBRATION_FALLBACK_WINDOWS windows,
+ * the quietest of them is taken as the bias (and 'fallback' is set).
+ *
+ * @param cal the calibrator
+ * @param acc raw output of the sensor
+ *
+ * @result 1: the bias has been updated (the car has been standing still), 0 else
+ */
+int  update_ins_calibrator(INSCalibrator *cal, const alt_16 acc[CALIBRATOR_DIM]);
+
+
+/**
+ * Get the variance of the output of the sensor on one axis while the car was standing still.
+ *
+ * @param cal the calibrator
+ * @param axis index of the axis
+ */
+double ins_calibrator_variance(const INSCalibrator *cal, int axis);
+
+
+#endif /* INS_CALIBRATOR_H_ */
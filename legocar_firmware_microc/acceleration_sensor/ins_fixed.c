@@ -0,0 +1,81 @@
+/*
+ * ins_fixed.c
+ *
+ *  Created on: 17.10.2026
+ */
+
+#include "ins_fixed.h"
+
+
+INSFixed *init_ins_fixed(INSFixed *ins, double sample_period) {
+	int j;
+
+	for(j=0; j<GSENSOR_DIM; j++) {
+		ins->sensor_calibration[j] = 0;
+		ins->acceleration[j]       = 0;
+		ins->speed[j]              = 0;
+		ins->distance[j]           = 0;
+	}
+
+	ins->samples = 0;
+
+	// the sample period, ms2_per_digi and the halving of the trapezoidal rule
+	// are folded into these constants
+	ins->acceleration_scale = ms2_per_digi / (1 << INS_FIXED_FRAC_BITS);
+	ins->speed_scale        = ins->acceleration_scale * sample_period * 0.5;
+	ins->distance_scale     = ins->speed_scale        * sample_period * 0.5;
+
+	return ins;
+}
+
+void calibrate_ins_fixed(INSFixed *ins, const double calibration[GSENSOR_DIM]) {
+	int j;
+
+	for(j=0; j<GSENSOR_DIM; j++) {
+		double steps = calibration[j] / ms2_per_digi * (1 << INS_FIXED_FRAC_BITS);
+		ins->sensor_calibration[j] = (alt_32) (steps < 0 ? steps - 0.5 : steps + 0.5);
+	}
+}
+
+void update_ins_fixed(INSFixed *ins, const alt_16 acc[GSENSOR_DIM]) {
+	int j;
+
+	for(j=0; j<GSENSOR_DIM; j++) {
+		alt_32 acceleration = ((alt_32) acc[j] << INS_FIXED_FRAC_BITS) - ins->sensor_calibration[j];
+		alt_64 speed;
+
+		// there is no previous value for the first sample
+		if(ins->samples == 0)
+			ins->acceleration[j] = acceleration;
+
+		// trapezoidal rule (the factor 0.5 is part of the conversion factors)
+		speed = ins->speed[j] + ins->acceleration[j] + acceleration;
+		ins->distance[j] += ins->speed[j] + speed;
+
+		ins->acceleration[j] = acceleration;
+		ins->speed[j]        = speed;
+	}
+
+	ins->samples++;
+}
+
+void reset_ins_fixed_speed(INSFixed *ins) {
+	int j;
+
+	for(j=0; j<GSENSOR_DIM; j++)
+		ins->speed[j] = 0;
+
+	ins->samples = 0;
+}
+
+double ins_fixed_acceleration(const INSFixed *ins, int axis) {
+	return ins->acceleration[axis] * ins->acceleration_scale;
+}
+
+double ins_fixed_speed(const INSFixed *ins, int axis) {
+	return ins->speed[axis] * ins->speed_scale;
+}
+
+double ins_fixed_distance(const INSFixed *ins, int axis) {
+	return ins->distance[axis] * ins->distance_scale;
+}
@@ -0,0 +1,98 @@
+/*
+ * ins_fixed.h
+ *
+ * Integer variant of the Inertial Navigation System for CPUs without FPU.
+ *
+ * The raw output of the sensor is integrated without any conversion: acceleration is
+ * stored in sensor steps with 16 fractional bits (Q16.16), speed and distance are plain
+ * sums over the samples in 64 bits (using the trapezoidal rule like the double version,
+ * the halving is folded into the conversion factors).
+ * With a constant sample period the integration is
+ * exact, so the only difference to the double version (see ins.h) is the quantization
+ * of the calibration to 1/65536 of a sensor step (< 1e-6 m/s²).
+ * Conversion to SI units (and the sample period and ms2_per_digi) only happens when the
+ * values are read.
+ *
+ * Range: the 64 bit sums are sufficient for several hours at 3200 Hz at the speeds and
+ * distances of the car (the distance sum reaches 2^59 at 10 km).
+ *
+ *  Created on: 17.10.2026
+ */
+
+#ifndef INS_FIXED_H_
+#define INS_FIXED_H_
+
+#include <alt_types.h>
+
+#include "ins.h"
+
+//! number of fractional bits of the acceleration values
+#define INS_FIXED_FRAC_BITS 16
+
+
+/**
+ * Inertial Navigation System in fixed-point format
+ */
+typedef struct INSFixed {
+	alt_32 sensor_calibration[GSENSOR_DIM]; // sensor steps, Q16.16
+	alt_32 acceleration[GSENSOR_DIM];       // sensor steps, Q16.16
+	alt_64 speed[GSENSOR_DIM];              // sum of (previous + current acceleration) over all samples
+	alt_64 distance[GSENSOR_DIM];           // sum of (previous + current speed) over all samples
+	alt_u32 samples;                        // number of integrated samples
+
+	// factors for the conversion to SI units (only used when the values are read)
+	double acceleration_scale;
+	double speed_scale;
+	double distance_scale;
+} INSFixed;
+
+
+/**
+ * Create a new fixed-point INS.
+ *
+ * @param ins pointer to reserved memory
+ * @param sample_period time between two samples of the sensor (in seconds)
+ *
+ * @return pointer to the initialized structure (identical to ins parameter)
+ */
+INSFixed *init_ins_fixed(INSFixed *ins, double sample_period);
+
+
+/**
+ * Calibrate the INS with the calibration of a double INS.
+ *
+ * @param ins the fixed-point INS
+ * @param calibration the average output of the sensor in m/s² (see INS.sensor_calibration)
+ */
+void calibrate_ins_fixed(INSFixed *ins, const double calibration[GSENSOR_DIM]);
+
+
+/**
+ * Update the INS with one sample of the sensor. Only integer additions are needed.
+ *
+ * @param ins the fixed-point INS
+ * @param acc raw output of the sensor
+ */
+void update_ins_fixed(INSFixed *ins, const alt_16 acc[GSENSOR_DIM]);
+
+
+/**
+ * Reset the speed to 0 (e.g. because the car is standing still).
+ *
+ * @param ins the fixed-point INS
+ */
+void reset_ins_fixed_speed(INSFixed *ins);
+
+
+/**
+ * Get the current acceleration, speed and distance in SI units.
+ *
+ * @param ins the fixed-point INS
+ * @param axis index of the axis (0 .. GSENSOR_DIM-1)
+ */
+double ins_fixed_acceleration(const INSFixed *ins, int axis);
+double ins_fixed_speed(const INSFixed *ins, int axis);
+double ins_fixed_distance(const INSFixed *ins, int axis);
+
+
+#endif /* INS_FIXED_H_ */
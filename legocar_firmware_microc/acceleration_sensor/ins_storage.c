@@ -0,0 +1,128 @@
+/*
+ * ins_storage.c
+ *
+ *  Created on: 17.10.2026
+ */
+
+#include "ins_storage.h"
+
+#include <stddef.h>
+#include <math.h>
+
+#include "../common/crc32.h"
+#include "../terasic_lib/terasic_includes.h"
+#include "../terasic_lib/flash.h"
+
+
+//! the bias of the sensor cannot be larger than its range (±16 g at 4 mg per step)
+static const float calibration_max_bias = 4096.0;
+
+//! the variance of a still window at the highest output data rate of the sensor (3200 Hz)
+static const double calibration_max_variance = 32.0 * calibration_still_factor * calibration_noise_variance_100hz;
+
+
+/**
+ * The CRC covers all the members of the record in front of the CRC.
+ */
+static alt_u32 record_crc(const INSCalibrationRecord *record) {
+	return crc32(record, offsetof(INSCalibrationRecord, crc));
+}
+
+/**
+ * Get the position of the record in the flash.
+ */
+static int locate_record(FLASH_HANDLE flash, alt_u16 *block, alt_32 *offset) {
+	alt_u16 blocks = Flash_GetBlockCount(flash);
+	alt_32 size;
+
+	if(blocks < INS_CALIBRATION_BLOCK)
+		return 0;
+
+	*block = blocks - INS_CALIBRATION_BLOCK;
+
+	if(!Flash_GetBlockInfo(flash, *block, offset, &size))
+		return 0;
+
+	return size >= (alt_32) sizeof(INSCalibrationRecord);
+}
+
+void pack_ins_calibration(INSCalibrationRecord *record, const INSCalibrator *cal,
+                          alt_u8 sensor_id, alt_u32 sequence, alt_u32 timestamp) {
+	int j;
+
+	record->magic     = INS_CALIBRATION_MAGIC;
+	record->version   = INS_CALIBRATION_VERSION;
+	record->sensor_id = sensor_id;
+	record->sequence  = sequence;
+	record->timestamp = timestamp;
+	record->samples   = (alt_u32) cal->count;
+
+	for(j=0; j<CALIBRATOR_DIM; j++) {
+		record->bias[j]     = cal->mean[j];
+		record->variance[j] = ins_calibrator_variance(cal, j);
+	}
+
+	record->crc = record_crc(record);
+}
+
+int check_ins_calibration(const INSCalibrationRecord *record, alt_u8 sensor_id) {
+	int j;
+
+	// erased flash or another record
+	if(record->magic != INS_CALIBRATION_MAGIC || record->version != INS_CALIBRATION_VERSION)
+		return 0;
+
+	if(record->crc != record_crc(record))
+		return 0;
+
+	// the calibration has been made with another sensor
+	if(record->sensor_id != sensor_id)
+		return 0;
+
+	if(record->samples == 0)
+		return 0;
+
+	// the comparisons are false for NaN as well
+	for(j=0; j<CALIBRATOR_DIM; j++) {
+		if(!(fabsf(record->bias[j]) <= calibration_max_bias))
+			return 0;
+		if(!(record->variance[j] >= 0.0 && record->variance[j] <= calibration_max_variance))
+			return 0;
+	}
+
+	return 1;
+}
+
+int read_ins_calibration(char *flash_name, INSCalibrationRecord *record) {
+	FLASH_HANDLE flash;
+	alt_u16 block;
+	alt_32 offset;
+	int success = 0;
+
+	flash = Flash_Open(flash_name);
+	if(!flash)
+		return 0;
+
+	if(locate_record(flash, &block, &offset))
+		success = Flash_Read(flash, offset, (alt_u8 *) record, sizeof(INSCalibrationRecord));
+
+	Flash_Close(flash);
+	return success;
+}
+
+int write_ins_calibration(char *flash_name, const INSCalibrationRecord *record) {
+	FLASH_HANDLE flash;
+	alt_u16 block;
+	alt_32 offset;
+	int success = 0;
+
+	flash = Flash_Open(flash_name);
+	if(!flash)
+		return 0;
+
+	if(locate_record(flash, &block, &offset) && Flash_Erase(flash, block))
+		success = Flash_Write(flash, offset, (alt_u8 *) record, sizeof(INSCalibrationRecord));
+
+	Flash_Close(flash);
+	return success;
+}
@@ -0,0 +1,90 @@
+/*
+ * ins_storage.h
+ *
+ * Storage of the calibration of the acceleration sensor in the EPCS flash, so that the INS
+ * is calibrated right after booting. The record is kept at the start of the last block of
+ * the flash (INS_CALIBRATION_BLOCK), which is not used by the FPGA configuration or the program.
+ *
+ *  Created on: 17.10.2026
+ */
+
+#ifndef INS_STORAGE_H_
+#define INS_STORAGE_H_
+
+#include <alt_types.h>
+
+#include "ins_calibrator.h"
+
+//! "INSC"
+#define INS_CALIBRATION_MAGIC   0x494E5343
+//! increment whenever the layout of the record changes
+#define INS_CALIBRATION_VERSION 1
+
+//! index of the flash block holding the record, counted from the end of the flash
+#define INS_CALIBRATION_BLOCK   1
+
+
+// the layout of the record in the flash (only 32 bit members => no padding)
+typedef struct INSCalibrationRecord {
+	alt_u32 magic;
+	alt_u32 version;
+	alt_u32 sensor_id;                  // device ID of the sensor (ADXL345_SPI_IdRead)
+	alt_u32 sequence;                   // incremented with every record that is written
+	alt_u32 timestamp;                  // system time at the calibration (ms since boot)
+	alt_u32 samples;                    // number of samples that the calibration is based on
+	float   bias[CALIBRATOR_DIM];       // average output of the sensor (in sensor steps)
+	float   variance[CALIBRATOR_DIM];   // variance of the output of the sensor (in sensor steps²)
+	alt_u32 crc;                        // CRC-32 of all the members above
+} INSCalibrationRecord;
+
+
+/**
+ * Fill a record with the current estimate of a calibrator.
+ *
+ * @param record the record
+ * @param cal the calibrator (must have converged)
+ * @param sensor_id device ID of the sensor
+ * @param sequence sequence number of the record
+ * @param timestamp system time of the calibration (ms)
+ */
+void pack_ins_calibration(INSCalibrationRecord *record, const INSCalibrator *cal,
+                          alt_u8 sensor_id, alt_u32 sequence, alt_u32 timestamp);
+
+
+/**
+ * Check whether a record holds a valid calibration for a sensor:
+ * magic number, version, CRC, sensor ID and plausible values.
+ *
+ * @param record the record
+ * @param sensor_id device ID of the sensor
+ *
+ * @result 1: valid, 0: invalid
+ */
+int  check_ins_calibration(const INSCalibrationRecord *record, alt_u8 sensor_id);
+
+
+/**
+ * Read the record from the flash.
+ * The content is not checked, use 'check_ins_calibration'.
+ *
+ * @param flash_name name of the flash device (e.g. EPCS_NAME)
+ * @param record buffer for the record
+ *
+ * @result 1: success, 0: the flash could not be read
+ */
+int  read_ins_calibration(char *flash_name, INSCalibrationRecord *record);
+
+
+/**
+ * Write a record to the flash.
+ * This erases a whole block of the flash, which takes a long time (about 1 s for the EPCS).
+ *
+ * @param flash_name name of the flash device (e.g. EPCS_NAME)
+ * @param record the record
+ *
+ * @result 1: success, 0: the record could not be written
+ */
+int  write_ins_calibration(char *flash_name, const INSCalibrationRecord *record);
+
+
+#endif /* INS_STORAGE_H_ */
@@ -0,0 +1,999 @@
+/*
+ * benchmark.c
+ *
+ *  Created on: 17.10.2026
+ */
+
+#include "benchmark.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <system.h>
+#include <sys/alt_timestamp.h>
+
+#include "../motor_control/pwm_motor.h"
+#include "../motor_control/legocar.h"
+#include "../motor_control/wheel_direction.h"
+#include "../acceleration_sensor/ins.h"
+#include "../acceleration_sensor/ins_fixed.h"
+#include "../terasic_lib/terasic_includes.h"
+#include "../terasic_lib/terasic_spi.h"
+#include "../terasic_lib/accelerometer_adxl345_spi.h"
+#include "../terasic_lib/flash.h"
+#include "../terasic_lib/adc_spi_read.h"
+#include "../telemetry/flash_log.h"
+#include "../telemetry/uart_telemetry.h"
+#include "../telemetry/deferred_log.h"
+#include "../common/crc32.h"
+
+// OSTimeDly
+#include "includes.h"
+
+
+// number of different power values used in the benchmarks
+#define POWER_STEPS 64
+
+// period of the PWM used in the benchmarks (same as in main.c)
+#define BENCHMARK_PWM_PERIOD 100000
+
+// the registers of the PWM used for benchmarking are mapped to this memory
+static unsigned int dummy_registers[PWM_REG_COUNT];
+
+// the SPI benchmarks read the data registers of the acceleration sensor
+#define BENCHMARK_SPI_SIZE 6
+
+// trace of sensor samples for the INS benchmark
+static alt_16 trace[BENCHMARK_TRACE_LENGTH][GSENSOR_DIM];
+
+// the flash cache benchmark reads records of this size from the starts of the last blocks
+#define BENCHMARK_FLASH_READ_SIZE 64
+#define BENCHMARK_FLASH_RECORDS   8
+
+// results of benchmarked functions are stored here, so that the calls are not optimized away
+static volatile alt_u32 benchmark_sink;
+
+// ns per blocking SPI transfer (0: not measured)
+static alt_u32 spi_blocking_ns = 0;
+
+// a repeated measurement runs for at least this time, so that the system timer (1 ms) resolves it
+#define BENCHMARK_MIN_MS 20
+
+// a repeated measurement gives up after this number of runs (the clock does not run)
+#define BENCHMARK_MAX_RUNS 100000
+
+// clock of the benchmarks: the timestamp timer or, if the system has none, the system timer
+static int     use_timestamp = 0;
+static alt_u32 clock_freq    = 0;
+
+// a run of a measurement, the context holds its parameters and results
+typedef void (*BenchmarkRun)(void *context);
+
+
+/**
+ * Select the clock of the benchmarks, once.
+ */
+static void init_benchmark_clock(void) {
+	if(clock_freq != 0)
+		return;
+
+	use_timestamp = alt_timestamp_start() >= 0;
+	clock_freq    = use_timestamp ? alt_timestamp_freq() : alt_ticks_per_second();
+}
+
+static alt_u32 benchmark_clock(void) {
+	return use_timestamp ? alt_timestamp() : alt_nticks();
+}
+
+/**
+ * Convert ticks of the clock into ns per operation.
+ */
+static alt_u32 ticks_to_ns(alt_u32 ticks, alt_u64 operations) {
+	if(operations == 0)
+		return 0;
+
+	return (alt_u32) ((alt_u64) ticks * 1000000000 / (clock_freq * operations));
+}
+
+/**
+ * Measure the run time of an operation: 'run' executes 'operations' operations and is repeated
+ * until at least BENCHMARK_MIN_MS have passed, so that the system timer resolves short operations as well.
+ *
+ * @param run runs the operations
+ * @param context parameters and results of 'run'
+ * @param operations number of operations per run
+ *
+ * @result ns per operation, 0: the clock does not run
+ */
+static alt_u32 time_runs(BenchmarkRun run, void *context, int operations) {
+	alt_u32 start, ticks, min_ticks;
+	int runs = 0;
+
+	init_benchmark_clock();
+	min_ticks = (alt_u32) ((alt_u64) clock_freq * BENCHMARK_MIN_MS / 1000);
+
+	start = benchmark_clock();
+	do {
+		run(context);
+		runs++;
+		ticks = benchmark_clock() - start;
+	} while(ticks < min_ticks && runs < BENCHMARK_MAX_RUNS);
+
+	if(ticks < min_ticks)
+		return 0;
+
+	return ticks_to_ns(ticks, (alt_u64) runs * operations);
+}
+
+/**
+ * Format the run time of operations that have been timed one at a time between other work
+ * (e.g. sleeping). Only the timestamp timer resolves them, the system timer is too coarse.
+ *
+ * @param text buffer for the text
+ * @param ticks accumulated ticks of the clock
+ * @param operations number of operations
+ *
+ * @result text
+ */
+static const char *format_single_ns(char *text, alt_u32 ticks, int operations) {
+	if(use_timestamp)
+		sprintf(text, "%lu ns", (unsigned long) ticks_to_ns(ticks, operations));
+	else
+		strcpy(text, "n/a (no timestamp timer)");
+
+	return text;
+}
+
+
+typedef struct PowerRun {
+	PWM_Motor *motor;
+	float *power_float;
+	int   *power_q15;
+	int iterations;
+} PowerRun;
+
+static void run_set_power_float(void *context) {
+	PowerRun *r = context;
+	int i;
+
+	for(i=0; i<r->iterations; i++)
+		set_power_float(r->motor, r->power_float[i % POWER_STEPS]);
+}
+
+static void run_set_power_q15(void *context) {
+	PowerRun *r = context;
+	int i;
+
+	for(i=0; i<r->iterations; i++)
+		set_power_q15(r->motor, r->power_q15[i % POWER_STEPS]);
+}
+
+int benchmark_power_paths(int iterations) {
+	PWM_Motor motor;
+	float power_float[POWER_STEPS];
+	int   power_q15[POWER_STEPS];
+	PowerRun run = { &motor, power_float, power_q15, iterations };
+	alt_u32 ns_float, ns_q15;
+	int p, difference, max_difference = 0, mismatches = 0;
+
+	init_pwm_motor(&motor, (alt_u32) dummy_registers, BENCHMARK_PWM_PERIOD);
+
+	// powers from -1 to 1 that can be represented exactly in both formats
+	for(p=0; p<POWER_STEPS; p++) {
+		power_q15[p]   = -Q15_ONE + p * (2 * Q15_ONE / (POWER_STEPS - 1));
+		power_float[p] = Q15_TO_FLOAT(power_q15[p]);
+	}
+
+	// both paths have to produce the same duty values, up to the rounding of the float
+	// multiplication, which may end just above an integer
+	for(p=0; p<POWER_STEPS; p++) {
+		unsigned int duty_float;
+
+		set_power_float(&motor, power_float[p]);
+		duty_float = motor.shadow[PWM_REG_DUTY1];
+
+		set_power_q15(&motor, power_q15[p]);
+		difference = abs((int) motor.shadow[PWM_REG_DUTY1] - (int) duty_float);
+		if(difference > max_difference)
+			max_difference = difference;
+		if(difference > 1)
+			mismatches++;
+	}
+
+	ns_float = time_runs(run_set_power_float, &run, iterations);
+	ns_q15   = time_runs(run_set_power_q15,   &run, iterations);
+
+	printf("benchmark: set_power (float): %lu ns per call\n", (unsigned long) ns_float);
+	printf("benchmark: set_power_q15:     %lu ns per call\n", (unsigned long) ns_q15);
+	printf("benchmark: %d of %d duty values differ by more than 1 count between the paths (max. %d)\n",
+	       mismatches, POWER_STEPS, max_difference);
+
+	return mismatches == 0;
+}
+
+
+/**
+ * Record the trace from the sensor through its FIFO at 3200 Hz.
+ * Samples that are lost while the FIFO is full are missing in the trace.
+ *
+ * @result 1: success, 0: the sensor cannot be read
+ */
+static int record_trace(alt_u32 sensor_spi_base, int samples) {
+	alt_u16 fifo[XL345_FIFO_MAX_ENTRIES][GSENSOR_DIM];
+	alt_u8 entries;
+	alt_u32 deadline;
+	int i = 0, j, k, overflows = 0;
+
+	if(!ADXL345_SPI_FifoInit(sensor_spi_base, XL345_RATE_3200, 16))
+		return 0;
+
+	// twice the time of the trace + 1 s
+	deadline = alt_nticks() + alt_ticks_per_second() * (2 * samples / 3200 + 1);
+
+	while(i < samples) {
+		if((alt_32) (alt_nticks() - deadline) > 0
+		   || !ADXL345_SPI_FifoRead(sensor_spi_base, fifo, XL345_FIFO_MAX_ENTRIES, &entries))
+			return 0;
+
+		if(entries == XL345_FIFO_MAX_ENTRIES)
+			overflows++;
+
+		for(k=0; k<entries && i<samples; k++, i++)
+			for(j=0; j<GSENSOR_DIM; j++)
+				trace[i][j] = (alt_16) fifo[k][j];
+	}
+
+	printf("benchmark: recorded %d samples from the sensor (%d times the FIFO was full)\n", samples, overflows);
+
+	return 1;
+}
+
+/**
+ * Fill the trace with samples: noise of a few steps around a constant offset
+ * (gravity on the Z-axis) and slow movements on the X- and Y-axis.
+ */
+static void generate_trace(int samples) {
+	const alt_16 offset[GSENSOR_DIM] = { 3, -8, 245 };
+	alt_u32 random = 12345;
+	int i, j;
+
+	for(i=0; i<samples; i++)
+		for(j=0; j<GSENSOR_DIM; j++) {
+			// linear congruential generator
+			random = random * 1103515245 + 12345;
+
+			trace[i][j] = offset[j] + (int) ((random >> 16) % 7) - 3;
+
+			// accelerate and brake on X and Y
+			if(j < 2 && (i / 400) % 4 == 1) trace[i][j] += 10;
+			if(j < 2 && (i / 400) % 4 == 3) trace[i][j] -= 10;
+		}
+}
+
+/**
+ * Initialize a double INS without touching the sensor.
+ */
+static void init_benchmark_ins(INS *ins, const double calibration[GSENSOR_DIM]) {
+	int j;
+
+	for(j=0; j<GSENSOR_DIM; j++) {
+		ins->sensor_calibration[j] = calibration[j];
+		ins->acceleration[j]       = 0.0;
+		ins->speed[j]              = 0.0;
+		ins->distance[j]           = 0.0;
+	}
+
+	ins->samples = 0;
+
+	// the calibration must not change during the benchmark
+	ins->online_calibration = 0;
+	init_ins_calibrator(&ins->calibrator);
+}
+
+static double max_abs(double a, double b) {
+	if(a < 0) a = -a;
+	return a > b ? a : b;
+}
+
+typedef struct INSRun {
+	INS *ins;
+	INSFixed *ins_fixed;
+	const double *calibration;
+	double sample_period;
+	int samples;
+} INSRun;
+
+// a run starts with an initialized INS, so that every run processes the same trace
+static void run_ins_double(void *context) {
+	INSRun *r = context;
+	int i;
+
+	init_benchmark_ins(r->ins, r->calibration);
+	for(i=0; i<r->samples; i++)
+		update_ins_sample(r->ins, trace[i], r->sample_period);
+}
+
+static void run_ins_fixed(void *context) {
+	INSRun *r = context;
+	int i;
+
+	init_ins_fixed(r->ins_fixed, r->sample_period);
+	calibrate_ins_fixed(r->ins_fixed, r->calibration);
+	for(i=0; i<r->samples; i++)
+		update_ins_fixed(r->ins_fixed, trace[i]);
+}
+
+int benchmark_ins_paths(alt_u32 sensor_spi_base, int samples) {
+	const double calibration[GSENSOR_DIM] = { 0.12, -0.32, 9.81 };
+	const double sample_period = 1.0 / 3200;
+	INS ins;
+	INSFixed ins_fixed;
+	INSRun run = { &ins, &ins_fixed, calibration, sample_period, 0 };
+	alt_u32 ns_double, ns_fixed;
+	double error_acceleration = 0, error_speed = 0, error_distance = 0;
+	int i, j;
+
+	if(samples > BENCHMARK_TRACE_LENGTH)
+		samples = BENCHMARK_TRACE_LENGTH;
+	run.samples = samples;
+
+	if(!record_trace(sensor_spi_base, samples)) {
+		printf("benchmark: cannot record from the sensor, using a generated trace\n");
+		generate_trace(samples);
+	}
+
+	ns_double = time_runs(run_ins_double, &run, samples);
+	ns_fixed  = time_runs(run_ins_fixed,  &run, samples);
+
+	// maximum difference between both versions over the whole trace
+	init_benchmark_ins(&ins, calibration);
+	init_ins_fixed(&ins_fixed, sample_period);
+	calibrate_ins_fixed(&ins_fixed, calibration);
+
+	for(i=0; i<samples; i++) {
+		update_ins_sample(&ins, trace[i], sample_period);
+		update_ins_fixed(&ins_fixed, trace[i]);
+
+		for(j=0; j<GSENSOR_DIM; j++) {
+			error_acceleration = max_abs(ins_fixed_acceleration(&ins_fixed, j) - ins.acceleration[j], error_acceleration);
+			error_speed        = max_abs(ins_fixed_speed(&ins_fixed, j)        - ins.speed[j],        error_speed);
+			error_distance     = max_abs(ins_fixed_distance(&ins_fixed, j)     - ins.distance[j],     error_distance);
+		}
+	}
+
+	printf("benchmark: INS (double): %lu ns per sample\n", (unsigned long) ns_double);
+	printf("benchmark: INS (fixed):  %lu ns per sample\n", (unsigned long) ns_fixed);
+	printf("benchmark: INS max. error: acceleration %g m/s^2, speed %g m/s, distance %g m\n",
+	       error_acceleration, error_speed, error_distance);
+
+	return 1;
+}
+
+
+typedef struct SPIRun {
+	alt_u32 spi_base;
+	int transfers;
+	int total;
+	int failures;
+	alt_u32 ticks_busy;
+} SPIRun;
+
+static void run_spi_blocking(void *context) {
+	SPIRun *r = context;
+	alt_u8 data[BENCHMARK_SPI_SIZE];
+	int i;
+
+	for(i=0; i<r->transfers; i++)
+		if(!SPI_MultipleRead(r->spi_base, ADXL345_REG_DATAX0, data, BENCHMARK_SPI_SIZE))
+			r->failures++;
+	r->total += r->transfers;
+}
+
+// queue as many transfers as possible, then sleep until they are done
+static void run_spi_async(void *context) {
+	SPIRun *r = context;
+	alt_u8 data[SPI_QUEUE_SIZE][BENCHMARK_SPI_SIZE];
+	int tickets[SPI_QUEUE_SIZE];
+	alt_u32 submitted;
+	int i, j, batch;
+
+	for(i=0; i<r->transfers; i+=batch) {
+		batch = r->transfers - i;
+		if(batch > SPI_QUEUE_SIZE)
+			batch = SPI_QUEUE_SIZE;
+
+		submitted = benchmark_clock();
+		for(j=0; j<batch; j++)
+			tickets[j] = SPI_Submit(r->spi_base, ADXL345_REG_DATAX0, TRUE, data[j], BENCHMARK_SPI_SIZE);
+		r->ticks_busy += benchmark_clock() - submitted;
+
+		for(j=0; j<batch; j++)
+			if(!SPI_Wait(tickets[j], 0))
+				r->failures++;
+	}
+	r->total += r->transfers;
+}
+
+int benchmark_spi_blocking(alt_u32 spi_base, int transfers) {
+	SPIRun run = { spi_base, transfers, 0, 0, 0 };
+
+	spi_blocking_ns = time_runs(run_spi_blocking, &run, transfers);
+
+	// the calling task polls the SPI core for the whole transfer
+	printf("benchmark: SPI (blocking): %lu ns per transfer, caller busy for all of it, %d of %d failed\n",
+	       (unsigned long) spi_blocking_ns, run.failures, run.total);
+
+	return run.failures == 0;
+}
+
+int benchmark_spi_async(alt_u32 spi_base, int transfers) {
+	SPIRun run = { spi_base, transfers, 0, 0, 0 };
+	char busy[32];
+	alt_u32 ns;
+
+	ns = time_runs(run_spi_async, &run, transfers);
+
+	// while waiting, the calling task sleeps and other tasks may run
+	printf("benchmark: SPI (queued):   %lu ns per transfer, caller busy for %s of it, %d of %d failed\n",
+	       (unsigned long) ns, format_single_ns(busy, run.ticks_busy, run.total), run.failures, run.total);
+	if(spi_blocking_ns != 0)
+		printf("benchmark: SPI (blocking): %lu ns per transfer\n", (unsigned long) spi_blocking_ns);
+
+	return run.failures == 0;
+}
+
+/**
+ * Find a block by scanning all regions (the lookup of the flash driver before the index).
+ */
+static int scan_block(flash_region *regions, int number_of_regions, int block_index, alt_u32 *offset, alt_u32 *size) {
+	int r, i, block_count = 0;
+
+	*offset = 0;
+	for(r=0; r<number_of_regions; r++)
+		for(i=0; i<regions[r].number_of_blocks; i++) {
+			if(block_count == block_index) {
+				*size = regions[r].block_size;
+				return 1;
+			}
+			*offset += regions[r].block_size;
+			block_count++;
+		}
+
+	return 0;
+}
+
+typedef struct FlashLookupRun {
+	FLASH_HANDLE flash;
+	flash_region *regions;
+	int number_of_regions;
+	alt_u16 blocks;
+	int iterations;
+} FlashLookupRun;
+
+// the last blocks are the worst case for the scan
+static void run_scan_block(void *context) {
+	FlashLookupRun *r = context;
+	alt_u32 offset, size;
+	int i;
+
+	for(i=0; i<r->iterations; i++) {
+		scan_block(r->regions, r->number_of_regions, r->blocks - 1 - (i & 1), &offset, &size);
+		benchmark_sink = offset;
+	}
+}
+
+static void run_block_index(void *context) {
+	FlashLookupRun *r = context;
+	alt_32 offset, size;
+	int i;
+
+	for(i=0; i<r->iterations; i++) {
+		Flash_GetBlockInfo(r->flash, r->blocks - 1 - (i & 1), &offset, &size);
+		benchmark_sink = offset;
+	}
+}
+
+int benchmark_flash_lookup(char *flash_name, int iterations) {
+	FlashLookupRun run;
+	alt_flash_fd *fd;
+	alt_u32 ns_scan, ns_index, scan_offset, scan_size;
+	alt_32 offset, size;
+	alt_u16 block, b;
+	int mismatches = 0;
+
+	run.flash = Flash_Open(flash_name);
+	run.iterations = iterations;
+	fd = alt_flash_open_dev(flash_name);
+	if(!run.flash || !fd || alt_get_flash_info(fd, &run.regions, &run.number_of_regions) != 0) {
+		printf("benchmark: cannot open the flash!\n");
+		if(run.flash) Flash_Close(run.flash);
+		if(fd)        alt_flash_close_dev(fd);
+		return 0;
+	}
+
+	// both lookups have to agree on every block, in both directions
+	run.blocks = Flash_GetBlockCount(run.flash);
+	for(b=0; b<run.blocks; b++) {
+		if(!scan_block(run.regions, run.number_of_regions, b, &scan_offset, &scan_size)
+		   || !Flash_GetBlockInfo(run.flash, b, &offset, &size)
+		   || (alt_u32) offset != scan_offset || (alt_u32) size != scan_size
+		   || !Flash_GetBlockIndex(run.flash, offset + size - 1, &block) || block != b)
+			mismatches++;
+	}
+
+	ns_scan  = time_runs(run_scan_block,  &run, iterations);
+	ns_index = time_runs(run_block_index, &run, iterations);
+
+	printf("benchmark: flash lookup (%d regions, %d blocks): scan %lu ns, index %lu ns, %d mismatches\n",
+	       run.number_of_regions, run.blocks, (unsigned long) ns_scan, (unsigned long) ns_index, mismatches);
+
+	alt_flash_close_dev(fd);
+	Flash_Close(run.flash);
+
+	return mismatches == 0;
+}
+
+typedef struct FlashCacheRun {
+	FLASH_HANDLE flash;
+	alt_flash_fd *fd;
+	alt_u32 offsets[BENCHMARK_FLASH_RECORDS];
+	alt_u8 data[BENCHMARK_FLASH_READ_SIZE];
+	int iterations;
+} FlashCacheRun;
+
+static void run_read_direct(void *context) {
+	FlashCacheRun *r = context;
+	int i;
+
+	for(i=0; i<r->iterations; i++)
+		alt_read_flash(r->fd, r->offsets[i % BENCHMARK_FLASH_RECORDS], r->data, BENCHMARK_FLASH_READ_SIZE);
+}
+
+static void run_read_cached(void *context) {
+	FlashCacheRun *r = context;
+	int i;
+
+	for(i=0; i<r->iterations; i++)
+		Flash_Read(r->flash, r->offsets[i % BENCHMARK_FLASH_RECORDS], r->data, BENCHMARK_FLASH_READ_SIZE);
+}
+
+int benchmark_flash_cache(char *flash_name, int iterations) {
+	static FlashCacheRun run;
+	FLASH_CACHE_STATS stats;
+	alt_u8 cached[BENCHMARK_FLASH_READ_SIZE], direct[BENCHMARK_FLASH_READ_SIZE];
+	alt_u32 ns_direct, ns_cached;
+	alt_32 offset, size;
+	alt_u16 blocks;
+	int i, mismatches = 0;
+
+	run.flash = Flash_Open(flash_name);
+	run.fd = alt_flash_open_dev(flash_name);
+	run.iterations = iterations;
+	blocks = run.flash ? Flash_GetBlockCount(run.flash) : 0;
+	if(!run.flash || !run.fd || blocks < BENCHMARK_FLASH_RECORDS) {
+		printf("benchmark: cannot open the flash!\n");
+		if(run.flash) Flash_Close(run.flash);
+		if(run.fd)    alt_flash_close_dev(run.fd);
+		return 0;
+	}
+
+	// records like the calibration, at the start of the last blocks
+	for(i=0; i<BENCHMARK_FLASH_RECORDS; i++) {
+		Flash_GetBlockInfo(run.flash, blocks - 1 - i, &offset, &size);
+		run.offsets[i] = offset;
+	}
+
+	ns_direct = time_runs(run_read_direct, &run, iterations);
+
+	Flash_InvalidateCache();
+	Flash_ResetCacheStats();
+
+	ns_cached = time_runs(run_read_cached, &run, iterations);
+
+	Flash_GetCacheStats(&stats);
+
+	// the cache has to deliver the content of the flash
+	for(i=0; i<BENCHMARK_FLASH_RECORDS; i++) {
+		alt_read_flash(run.fd, run.offsets[i], direct, BENCHMARK_FLASH_READ_SIZE);
+		Flash_Read(run.flash, run.offsets[i], cached, BENCHMARK_FLASH_READ_SIZE);
+		if(memcmp(direct, cached, BENCHMARK_FLASH_READ_SIZE) != 0)
+			mismatches++;
+	}
+
+	printf("benchmark: flash read (%d bytes): direct %lu ns, cached %lu ns, %lu hits, %lu misses, %d mismatches\n",
+	       BENCHMARK_FLASH_READ_SIZE, (unsigned long) ns_direct, (unsigned long) ns_cached,
+	       (unsigned long) stats.nHit, (unsigned long) stats.nMiss, mismatches);
+
+	alt_flash_close_dev(run.fd);
+	Flash_Close(run.flash);
+
+	return mismatches == 0;
+}
+
+typedef struct FlashVerifyRun {
+	FLASH_HANDLE flash;
+	int blocks;
+	int errors;
+} FlashVerifyRun;
+
+// the blocks of the FPGA configuration, as the check in the background does
+static void run_block_crc(void *context) {
+	static alt_u8 buffer[4096];
+	FlashVerifyRun *r = context;
+	alt_u32 crc;
+	int b;
+
+	for(b=0; b<r->blocks; b++) {
+		if(!Flash_BlockCrc(r->flash, b, &crc, buffer, sizeof(buffer)))
+			r->errors++;
+		benchmark_sink = crc;
+	}
+}
+
+int benchmark_flash_verify(char *flash_name, int blocks) {
+	FlashVerifyRun run = { NULL, blocks, 0 };
+	alt_u32 us;
+	alt_32 offset, size;
+
+	run.flash = Flash_Open(flash_name);
+	if(!run.flash || !Flash_GetBlockInfo(run.flash, 0, &offset, &size)) {
+		printf("benchmark: cannot open the flash!\n");
+		if(run.flash) Flash_Close(run.flash);
+		return 0;
+	}
+
+	if(run.blocks > Flash_GetBlockCount(run.flash))
+		run.blocks = Flash_GetBlockCount(run.flash);
+
+	// a block takes milliseconds, us are precise enough
+	us = time_runs(run_block_crc, &run, run.blocks) / 1000;
+
+	printf("benchmark: flash verify (CRC of %ld bytes): %lu us per block, %d errors\n",
+	       (long) size, (unsigned long) us, run.errors);
+
+	Flash_Close(run.flash);
+
+	return run.errors == 0;
+}
+
+typedef struct ADCRun {
+	alt_u8 channel;
+	int reads;
+	int total;
+	int timeouts;
+} ADCRun;
+
+static void run_adc_read(void *context) {
+	ADCRun *r = context;
+	alt_u16 value;
+	int i;
+
+	for(i=0; i<r->reads; i++) {
+		value = ADC_Read(r->channel);
+		// the value is 0 only after a timeout (or at 0 V)
+		if(value == 0)
+			r->timeouts++;
+		benchmark_sink = value;
+	}
+	r->total += r->reads;
+}
+
+int benchmark_adc_read(alt_u8 channel, int reads) {
+	ADCRun run = { channel, reads, 0, 0 };
+	alt_u32 ns;
+
+	ns = time_runs(run_adc_read, &run, reads);
+
+	printf("benchmark: ADC (single conversion): %lu ns per conversion, %d of %d zero values\n",
+	       (unsigned long) ns, run.timeouts, run.total);
+
+	return run.timeouts < run.total;
+}
+
+/**
+ * Largest difference between the powers (Q15) of two cars on any engine.
+ */
+static int max_power_difference(LegoCar *a, LegoCar *b) {
+	int w, difference, max_difference = 0;
+
+	for(w=0; w<4; w++) {
+		difference = abs(get_power_q15(&a->speed[w]) - get_power_q15(&b->speed[w]));
+		if(difference > max_difference)
+			max_difference = difference;
+
+		difference = abs(get_power_q15(&a->direction[w]) - get_power_q15(&b->direction[w]));
+		if(difference > max_difference)
+			max_difference = difference;
+	}
+
+	return max_difference;
+}
+
+/**
+ * The driving patterns as 'align_wheels_q15' set them before they were driven by 'drive_pattern_q15'
+ * (the reference for the comparison).
+ */
+static void align_wheels_switch(LegoCar *car, int type, int direction) {
+	int w;
+
+	for(w=0; w<4; w++)
+		switch(type) {
+		case MOVE_DIAGONAL:
+			set_direction_q15(&car->direction[w], direction);
+			break;
+
+		case MOVE_ROTATE:
+			set_direction_q15(&car->direction[w], (w == 0 || w == 3) ? -Q15_ONE : Q15_ONE);
+			break;
+
+		case MOVE_CURVE:
+			set_direction_q15(&car->direction[w], (w < 2) ? direction : -direction);
+			break;
+		}
+}
+
+/**
+ * The driving patterns as 'set_driving_power_q15' set them before (the reference for the comparison).
+ */
+static void set_driving_power_switch(LegoCar *car, int type, int power) {
+	int w;
+
+	for(w=0; w<4; w++)
+		set_power_q15(&car->speed[w], (type == MOVE_ROTATE && w % 2 == 0) ? -power : power);
+}
+
+typedef struct DriveRun {
+	LegoCar *car;
+	int *value_q15;
+	int iterations;
+} DriveRun;
+
+static void run_switched(void *context) {
+	DriveRun *r = context;
+	int i;
+
+	for(i=0; i<r->iterations; i++) {
+		align_wheels_switch(r->car, i % 3, r->value_q15[i % POWER_STEPS]);
+		set_driving_power_switch(r->car, i % 3, r->value_q15[(i / 3) % POWER_STEPS]);
+	}
+}
+
+static void run_drive_pattern(void *context) {
+	DriveRun *r = context;
+	int i;
+
+	for(i=0; i<r->iterations; i++)
+		drive_pattern_q15(r->car, i % 3, r->value_q15[i % POWER_STEPS], r->value_q15[(i / 3) % POWER_STEPS]);
+}
+
+static void run_drive(void *context) {
+	DriveRun *r = context;
+	int i;
+
+	for(i=0; i<r->iterations; i++)
+		drive_q15(r->car, r->value_q15[i % POWER_STEPS], r->value_q15[(i / 3) % POWER_STEPS], r->value_q15[(i / 7) % POWER_STEPS]);
+}
+
+int benchmark_drive(int iterations) {
+	LegoCar switched, swerve;
+	alt_u32 addresses[8];
+	int value_q15[POWER_STEPS];
+	DriveRun run_a = { &switched, value_q15, iterations }, run_b = { &swerve, value_q15, iterations };
+	alt_u32 ns_switch, ns_pattern, ns_drive;
+	int i, p, type, difference, max_difference[2] = { 0, 0 };
+
+	// all engines write to the same dummy registers, only their state in the structure matters
+	for(i=0; i<8; i++)
+		addresses[i] = (alt_u32) dummy_registers;
+	init_legocar(&switched, addresses, BENCHMARK_PWM_PERIOD);
+	init_legocar(&swerve,   addresses, BENCHMARK_PWM_PERIOD);
+
+	// directions and powers from -1 to 1 (without 0, a wheel that does not move keeps its direction)
+	for(p=0; p<POWER_STEPS; p++)
+		value_q15[p] = -Q15_ONE + p * (2 * Q15_ONE / (POWER_STEPS - 1));
+
+	// MOVE_DIAGONAL and MOVE_ROTATE have to be reproduced by 'drive_pattern_q15' (up to rounding),
+	// MOVE_CURVE differs on purpose (Ackermann steering)
+	for(type=MOVE_DIAGONAL; type<=MOVE_ROTATE; type++)
+		for(i=0; i<POWER_STEPS*POWER_STEPS; i++) {
+			align_wheels_switch(&switched, type, value_q15[i % POWER_STEPS]);
+			set_driving_power_switch(&switched, type, value_q15[i / POWER_STEPS]);
+
+			drive_pattern_q15(&swerve, type, value_q15[i % POWER_STEPS], value_q15[i / POWER_STEPS]);
+
+			difference = max_power_difference(&switched, &swerve);
+			if(difference > max_difference[type])
+				max_difference[type] = difference;
+		}
+
+	ns_switch  = time_runs(run_switched,      &run_a, iterations);
+	ns_pattern = time_runs(run_drive_pattern, &run_b, iterations);
+	ns_drive   = time_runs(run_drive,         &run_b, iterations);
+
+	printf("benchmark: driving patterns (switch): %lu ns per call\n", (unsigned long) ns_switch);
+	printf("benchmark: drive_pattern_q15:         %lu ns per call\n", (unsigned long) ns_pattern);
+	printf("benchmark: drive_q15:                 %lu ns per call\n", (unsigned long) ns_drive);
+	printf("benchmark: largest difference to the driving patterns: diagonal %d, rotate %d (of %d)\n",
+	       max_difference[MOVE_DIAGONAL], max_difference[MOVE_ROTATE], Q15_ONE);
+
+	// the patterns are reproduced within 1 percent
+	return max_difference[MOVE_DIAGONAL] <= Q15_ONE / 100 && max_difference[MOVE_ROTATE] <= Q15_ONE / 100;
+}
+
+void run_benchmarks(void) {
+	init_benchmark_clock();
+
+	if(use_timestamp)
+		printf("benchmark: clock: timestamp timer, %lu Hz\n", (unsigned long) clock_freq);
+	else
+		printf("benchmark: clock: system timer, %lu Hz (no timestamp timer), measurements repeated for %d ms\n",
+		       (unsigned long) clock_freq, BENCHMARK_MIN_MS);
+
+	benchmark_power_paths(1000);
+	benchmark_ins_paths(GSENSOR_SPI_BASE, BENCHMARK_TRACE_LENGTH);
+	benchmark_spi_blocking(GSENSOR_SPI_BASE, 1000);
+	benchmark_flash_lookup(EPCS_NAME, 1000);
+	benchmark_flash_cache(EPCS_NAME, 1000);
+	benchmark_flash_verify(EPCS_NAME, 4);
+	benchmark_adc_read(0, 1000);
+	benchmark_drive(1000);
+}
+
+typedef struct CRCRun {
+	FlashLogRecordHeader *header;
+	FlashLogINS *state;
+} CRCRun;
+
+static void run_record_crc(void *context) {
+	CRCRun *r = context;
+
+	benchmark_sink = crc32_final(crc32_update(crc32_update(CRC32_INIT, r->header, sizeof(*r->header)),
+	                                          r->state, sizeof(*r->state)));
+}
+
+int benchmark_flash_log(int records) {
+	FlashLogINS state = { { 0.01, -0.02, 0.98 }, { 0, 0, 0 } };
+	FlashLogRecordHeader header = { FLASH_LOG_RECORD_MAGIC, FLASH_LOG_BENCHMARK, sizeof(state), 0, 0 };
+	CRCRun run = { &header, &state };
+	FlashLogStats before, after;
+	char append[32];
+	alt_u32 start, ticks_append = 0, ns_crc;
+	int i;
+
+	init_benchmark_clock();
+	get_flash_log_stats(&before);
+
+	// one record per tick of the system timer, the writer task runs in between
+	for(i=0; i<records; i++) {
+		state.speed[0] = i;
+
+		start = benchmark_clock();
+		log_record(FLASH_LOG_BENCHMARK, &state, sizeof(state));
+		ticks_append += benchmark_clock() - start;
+
+		OSTimeDly(1);
+	}
+
+	// the writer task flushes the last page
+	OSTimeDly(2 * FLASH_LOG_FLUSH_TICKS);
+	get_flash_log_stats(&after);
+
+	// what adding a record would cost if the caller calculated the CRC
+	ns_crc = time_runs(run_record_crc, &run, 1);
+
+	printf("benchmark: flash log: %s per record (the CRC would add %lu ns), %lu of %d written, %lu dropped, %lu erases\n",
+	       format_single_ns(append, ticks_append, records), (unsigned long) ns_crc,
+	       (unsigned long) (after.written - before.written), records,
+	       (unsigned long) (after.dropped - before.dropped), (unsigned long) (after.erases - before.erases));
+
+	return after.dropped == before.dropped && after.errors == before.errors;
+}
+
+static void run_adc_latest(void *context) {
+	ADC_SAMPLE latest;
+
+	ADC_GetLatest(*(alt_u8 *) context, &latest);
+	benchmark_sink = latest.Value;
+}
+
+int benchmark_adc_scan(alt_u8 channel) {
+	ADC_SAMPLE samples[ADC_RING_SIZE];
+	alt_u32 ns, position = 0, lost, total_lost = 0;
+	int i, count = 0;
+
+	ns = time_runs(run_adc_latest, &channel, 1);
+
+	// collect the samples of one second, the ring holds the samples of more than 10 ticks
+	ADC_GetSamples(channel, &position, samples, ADC_RING_SIZE, NULL);
+	for(i=0; i<OS_TICKS_PER_SEC / 10; i++) {
+		OSTimeDly(10);
+		count += ADC_GetSamples(channel, &position, samples, ADC_RING_SIZE, &lost);
+		total_lost += lost;
+	}
+
+	printf("benchmark: ADC (scan): %lu ns per latest sample, %d samples/s of channel %u, %lu lost\n",
+	       (unsigned long) ns, count, channel, (unsigned long) total_lost);
+
+	return count > 0;
+}
+
+// what the acceleration sensor task used to print
+static void run_format_ins(void *context) {
+	TelemetryINS *state = context;
+	char line[128];
+
+	snprintf(line, sizeof(line), "acc-sensor: acceleration (%d): X: %6.2f,\tY: %6.2f,\tZ: %6.2f\n", (int) benchmark_sink,
+	         state->acceleration[0], state->acceleration[1], state->acceleration[2]);
+	benchmark_sink = line[0];
+}
+
+int benchmark_telemetry(int records) {
+	TelemetryINS state = { { 12, -3, 250 }, 16, { 0.01, -0.02, 0.98 }, { 0, 0, 0 } };
+	TelemetryStats before, after;
+	char send[32];
+	alt_u32 start, ticks_send = 0, ns_format;
+	int i;
+
+	init_benchmark_clock();
+	get_telemetry_stats(&before);
+
+	// the transmitter needs about 3 ms per record, so the records are sent at a lower rate
+	for(i=0; i<records; i++) {
+		state.speed[0] = i;
+
+		start = benchmark_clock();
+		send_telemetry(TELEMETRY_INS, &state, sizeof(state));
+		ticks_send += benchmark_clock() - start;
+
+		OSTimeDly(5);
+	}
+
+	get_telemetry_stats(&after);
+
+	ns_format = time_runs(run_format_ins, &state, 1);
+
+	printf("benchmark: telemetry: %s per record, formatting as text: %lu ns per line, %lu dropped\n",
+	       format_single_ns(send, ticks_send, records), (unsigned long) ns_format,
+	       (unsigned long) (after.dropped - before.dropped));
+
+	return after.dropped == before.dropped;
+}
+
+static void run_format_message(void *context) {
+	char line[DEFERRED_LOG_LINE];
+	int messages = *(int *) context;
+
+	snprintf(line, sizeof(line), "benchmark: deferred message %d of %d, power %d\n",
+	         (int) benchmark_sink, messages, (int) benchmark_sink << 10);
+	benchmark_sink = line[0];
+}
+
+int benchmark_deferred_log(int messages) {
+	char log[32];
+	alt_u32 start, ticks_log, ns_format;
+	int i, dropped = 0;
+
+	init_benchmark_clock();
+
+	// the log holds only DEFERRED_LOG_SIZE messages until the output task runs, so the messages are not repeated
+	start = benchmark_clock();
+	for(i=0; i<messages; i++)
+		if(!deferred_log("benchmark: deferred message %d of %d, power %q\n", i, messages, i << 10))
+			dropped++;
+	ticks_log = benchmark_clock() - start;
+
+	ns_format = time_runs(run_format_message, &messages, 1);
+
+	printf("benchmark: deferred log: %s per message, formatting right away: %lu ns, %d dropped\n",
+	       format_single_ns(log, ticks_log, messages), (unsigned long) ns_format, dropped);
+
+	return dropped == 0;
+}
+
+void run_task_benchmarks(void) {
+	benchmark_spi_async(GSENSOR_SPI_BASE, 1000);
+	benchmark_flash_log(5000);
+	benchmark_adc_scan(0);
+	benchmark_telemetry(200);
+	benchmark_deferred_log(16);
+}
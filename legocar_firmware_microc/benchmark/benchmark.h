@@ -0,0 +1,205 @@
+/*
+ * benchmark.h
+ *
+ * Measurements of the run time of performance critical parts of the firmware.
+ * All times are measured with the timestamp timer of the HAL (alt_timestamp) or, if the system
+ * has none, with the system timer (alt_nticks). The operations are repeated for at least 20 ms,
+ * so that the system timer resolves them as well. Single operations between other work
+ * (e.g. sleeping) can only be timed with the timestamp timer and are reported as not available otherwise.
+ *
+ *  Created on: 17.10.2026
+ */
+
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+
+#include <alt_types.h>
+
+// maximum number of samples in the traces of the INS benchmark
+#define BENCHMARK_TRACE_LENGTH 3200
+
+
+/**
+ * Compare the floating point ('set_power_float', the duty computation before the fixed-point
+ * path) and the fixed-point (Q15) path for setting the power of a motor.
+ * The benchmark runs on a PWM_Motor whose registers are mapped to memory, so no real motor is moved.
+ * Additionally, both paths are checked to produce the same duty values (within 1 count).
+ *
+ * @param iterations number of calls of every function to measure
+ *
+ * @result 1: success, 0: the paths produced different duty values
+ */
+int benchmark_power_paths(int iterations);
+
+
+/**
+ * Compare the double and the fixed-point INS (ins_fixed.h) on a trace of sensor samples:
+ * run time per sample and the maximum difference of the acceleration, speed and distance.
+ * The trace is recorded from the sensor at 3200 Hz right before the comparison, so the car
+ * should be moved while the benchmark runs. If the sensor cannot be read, a generated trace
+ * (noise and slow movements around a constant offset) is used instead.
+ *
+ * @param sensor_spi_base spi-base-address of the sensor
+ * @param samples number of samples in the trace (at most BENCHMARK_TRACE_LENGTH)
+ *
+ * @result 1: success
+ */
+int benchmark_ins_paths(alt_u32 sensor_spi_base, int samples);
+
+
+/**
+ * Measure blocking SPI transfers (reads of the data registers of the acceleration sensor):
+ * every transfer busy-polls the SPI core in the calling task.
+ * Has to be called before the operating system is started; the result is printed again
+ * by 'benchmark_spi_async' for comparison.
+ *
+ * @param spi_base base address of the SPI core of the acceleration sensor
+ * @param transfers number of transfers to measure
+ *
+ * @result 1: success, 0: a transfer failed
+ */
+int benchmark_spi_blocking(alt_u32 spi_base, int transfers);
+
+
+/**
+ * Measure the same transfers as 'benchmark_spi_blocking' through the queue of the SPI
+ * driver task (SPI_Submit / SPI_Wait): throughput and the time that the calling task is busy.
+ * Has to be called from a task after SPI_AsyncInit.
+ *
+ * @param spi_base base address of the SPI core of the acceleration sensor
+ * @param transfers number of transfers to measure
+ *
+ * @result 1: success, 0: a transfer failed
+ */
+int benchmark_spi_async(alt_u32 spi_base, int transfers);
+
+
+/**
+ * Compare the block lookup of the flash driver (index built by Flash_Open) with a linear scan
+ * of the regions, as the driver did before: run time of the lookup of the last block and
+ * whether both agree on the offset and size of every block.
+ *
+ * @param flash_name name of the flash device (e.g. EPCS_NAME)
+ * @param iterations number of lookups to measure
+ *
+ * @result 1: success, 0: no flash available, or the lookups disagree
+ */
+int benchmark_flash_lookup(char *flash_name, int iterations);
+
+
+/**
+ * Compare reads of small records from the flash through the read cache of the flash driver
+ * (Flash_Read) with reads from the device (alt_read_flash): run time per read, hits and misses
+ * of the cache and whether both deliver the same data.
+ *
+ * @param flash_name name of the flash device (e.g. EPCS_NAME)
+ * @param iterations number of reads to measure
+ *
+ * @result 1: success, 0: no flash available, or the data differs
+ */
+int benchmark_flash_cache(char *flash_name, int iterations);
+
+
+/**
+ * Measure the non-destructive check of the flash (Flash_BlockCrc): run time of the CRC of a
+ * block, which is what the check in the background costs per block.
+ *
+ * @param flash_name name of the flash device (e.g. EPCS_NAME)
+ * @param blocks number of blocks to check, starting with the first one
+ *
+ * @result 1: success, 0: no flash available, or a block cannot be read
+ */
+int benchmark_flash_verify(char *flash_name, int blocks);
+
+
+/**
+ * Measure a single conversion of the ADC (ADC_Read), which polls the done flag of the
+ * conversion in the calling task.
+ * Has to be called before the scan of the ADC is started.
+ *
+ * @param channel channel of the ADC
+ * @param reads number of conversions
+ *
+ * @result 1: success, 0: a conversion timed out
+ */
+int benchmark_adc_read(alt_u8 channel, int reads);
+
+
+/**
+ * Compare the swerve drive ('drive_pattern_q15' and 'drive_q15') with the driving patterns
+ * as 'align_wheels_q15' and 'set_driving_power_q15' set them with a switch before they were
+ * routed through 'drive_pattern_q15', on a car without hardware.
+ * Measures the run time per call and checks that MOVE_DIAGONAL and MOVE_ROTATE are reproduced.
+ *
+ * @param iterations number of calls per variant
+ *
+ * @result 1: success, 0: a driving pattern is not reproduced
+ */
+int benchmark_drive(int iterations);
+
+
+/**
+ * Measure the scan of the ADC in the background: run time of reading the latest sample
+ * (ADC_GetLatest) and the rate of the samples of a channel within one second.
+ * Has to be called from a task after 'ADC_ScanStart'.
+ *
+ * @param channel a channel of the scan
+ *
+ * @result 1: success, 0: no samples
+ */
+int benchmark_adc_scan(alt_u8 channel);
+
+
+/**
+ * Add records to the telemetry log at 1 kHz (one per tick of the system timer) for a while:
+ * run time of 'log_record' in the calling task and whether the writer task keeps up, including
+ * the erase of the next block in advance. The records have the type FLASH_LOG_BENCHMARK.
+ * Has to be called from a task after 'start_flash_log_writer'.
+ * The records stay in the log: they take the place of the oldest records of the drive sessions,
+ * and every block they fill costs an erase of the EPCS (5000 records fill about 3 blocks).
+ *
+ * @param records number of records to add
+ *
+ * @result 1: success, 0: records have been dropped or the flash failed
+ */
+int benchmark_flash_log(int records);
+
+
+/**
+ * Compare sending the state of the INS as a telemetry record (send_telemetry) with
+ * formatting it as text with printf-style float conversions (snprintf, without the output).
+ * Has to be called after 'init_uart_telemetry'.
+ *
+ * @param records number of records
+ *
+ * @result 1: success, 0: records have been dropped
+ */
+int benchmark_telemetry(int records);
+
+
+/**
+ * Compare adding a message to the deferred log with formatting it right away (snprintf,
+ * without the output). The messages are printed later by the output task.
+ *
+ * @param messages number of messages (at most DEFERRED_LOG_SIZE)
+ *
+ * @result 1: success, 0: messages have been dropped
+ */
+int benchmark_deferred_log(int messages);
+
+
+/**
+ * Run all benchmarks and print the results.
+ * Has to be called before the operating system is started.
+ */
+void run_benchmarks(void);
+
+
+/**
+ * Run the benchmarks that need the operating system and print the results.
+ * Has to be called from a task.
+ */
+void run_task_benchmarks(void);
+
+
+#endif /* BENCHMARK_H_ */
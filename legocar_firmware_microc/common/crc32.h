@@ -0,0 +1,52 @@
+/*
+ * crc32.h
+ *
+ * CRC-32 (IEEE 802.3, as used by zlib) for checking data that is stored in the flash.
+ *
+ *  Created on: 17.10.2026
+ */
+
+#ifndef CRC32_H_
+#define CRC32_H_
+
+#include <alt_types.h>
+
+//! start value for 'crc32_update'
+#define CRC32_INIT 0xFFFFFFFF
+
+
+/**
+ * Continue the calculation of a CRC over another piece of data.
+ * Start with CRC32_INIT and finish with 'crc32_final'.
+ *
+ * @param crc the CRC so far
+ * @param data the data
+ * @param size number of bytes
+ *
+ * @result the CRC including the new data
+ */
+alt_u32 crc32_update(alt_u32 crc, const void *data, alt_u32 size);
+
+
+/**
+ * Finish the calculation of a CRC.
+ *
+ * @param crc the result of the last 'crc32_update'
+ *
+ * @result the CRC
+ */
+alt_u32 crc32_final(alt_u32 crc);
+
+
+/**
+ * Calculate the CRC over a block of data.
+ *
+ * @param data the data
+ * @param size number of bytes
+ *
+ * @result the CRC
+ */
+alt_u32 crc32(const void *data, alt_u32 size);
+
+
+#endif /* CRC32_H_ */
@@ -0,0 +1,121 @@
+/*
+ * fixed_trig.c
+ *
+ *  Created on: 17.10.2026
+ */
+
+#include "fixed_trig.h"
+
+// resolution of the tables: 256 steps per quarter turn / from 0 to 1 for the arc tangent
+#define TABLE_BITS  8
+#define TABLE_SIZE  (1 << TABLE_BITS)
+// bits of the angle (of the ratio for the arc tangent) below the resolution of the tables
+#define FRACTION_BITS 6
+
+//! sin(i * 90 / 256 degrees) in Q15 format
+static const alt_u16 sin_table[TABLE_SIZE + 1] = {
+	    0,   201,   402,   603,   804,  1005,  1206,  1407,  1608,  1809,  2009,  2210,
+	 2411,  2611,  2811,  3012,  3212,  3412,  3612,  3812,  4011,  4211,  4410,  4609,
+	 4808,  5007,  5205,  5404,  5602,  5800,  5998,  6195,  6393,  6590,  6787,  6983,
+	 7180,  7376,  7571,  7767,  7962,  8157,  8351,  8546,  8740,  8933,  9127,  9319,
+	 9512,  9704,  9896, 10088, 10279, 10469, 10660, 10850, 11039, 11228, 11417, 11605,
+	11793, 11980, 12167, 12354, 12540, 12725, 12910, 13095, 13279, 13463, 13646, 13828,
+	14010, 14192, 14373, 14553, 14733, 14912, 15091, 15269, 15447, 15624, 15800, 15976,
+	16151, 16326, 16500, 16673, 16846, 17018, 17190, 17361, 17531, 17700, 17869, 18037,
+	18205, 18372, 18538, 18703, 18868, 19032, 19195, 19358, 19520, 19681, 19841, 20001,
+	20160, 20318, 20475, 20632, 20788, 20943, 21097, 21251, 21403, 21555, 21706, 21856,
+	22006, 22154, 22302, 22449, 22595, 22740, 22884, 23028, 23170, 23312, 23453, 23593,
+	23732, 23870, 24008, 24144, 24279, 24414, 24548, 24680, 24812, 24943, 25073, 25202,
+	25330, 25457, 25583, 25708, 25833, 25956, 26078, 26199, 26320, 26439, 26557, 26674,
+	26791, 26906, 27020, 27133, 27246, 27357, 27467, 27576, 27684, 27791, 27897, 28002,
+	28106, 28209, 28311, 28411, 28511, 28610, 28707, 28803, 28899, 28993, 29086, 29178,
+	29269, 29359, 29448, 29535, 29622, 29707, 29792, 29875, 29957, 30038, 30118, 30196,
+	30274, 30350, 30425, 30499, 30572, 30644, 30715, 30784, 30853, 30920, 30986, 31050,
+	31114, 31177, 31238, 31298, 31357, 31415, 31471, 31527, 31581, 31634, 31686, 31737,
+	31786, 31834, 31881, 31927, 31972, 32015, 32058, 32099, 32138, 32177, 32214, 32251,
+	32286, 32319, 32352, 32383, 32413, 32442, 32470, 32496, 32522, 32546, 32568, 32590,
+	32610, 32629, 32647, 32664, 32679, 32693, 32706, 32718, 32729, 32738, 32746, 32753,
+	32758, 32762, 32766, 32767, 32768
+};
+
+//! atan(i / 256) as binary angle
+static const alt_u16 atan_table[TABLE_SIZE + 1] = {
+	    0,    41,    81,   122,   163,   204,   244,   285,   326,   367,   407,   448,
+	  489,   529,   570,   610,   651,   692,   732,   773,   813,   854,   894,   935,
+	  975,  1015,  1056,  1096,  1136,  1177,  1217,  1257,  1297,  1337,  1377,  1417,
+	 1457,  1497,  1537,  1577,  1617,  1656,  1696,  1736,  1775,  1815,  1854,  1894,
+	 1933,  1973,  2012,  2051,  2090,  2129,  2168,  2207,  2246,  2285,  2324,  2363,
+	 2401,  2440,  2478,  2517,  2555,  2594,  2632,  2670,  2708,  2746,  2784,  2822,
+	 2860,  2897,  2935,  2973,  3010,  3047,  3085,  3122,  3159,  3196,  3233,  3270,
+	 3307,  3344,  3380,  3417,  3453,  3490,  3526,  3562,  3599,  3635,  3670,  3706,
+	 3742,  3778,  3813,  3849,  3884,  3920,  3955,  3990,  4025,  4060,  4095,  4129,
+	 4164,  4199,  4233,  4267,  4302,  4336,  4370,  4404,  4438,  4471,  4505,  4539,
+	 4572,  4605,  4639,  4672,  4705,  4738,  4771,  4803,  4836,  4869,  4901,  4933,
+	 4966,  4998,  5030,  5062,  5094,  5125,  5157,  5188,  5220,  5251,  5282,  5313,
+	 5344,  5375,  5406,  5437,  5467,  5498,  5528,  5559,  5589,  5619,  5649,  5679,
+	 5708,  5738,  5768,  5797,  5826,  5856,  5885,  5914,  5943,  5972,  6000,  6029,
+	 6058,  6086,  6114,  6142,  6171,  6199,  6227,  6254,  6282,  6310,  6337,  6365,
+	 6392,  6419,  6446,  6473,  6500,  6527,  6554,  6580,  6607,  6633,  6660,  6686,
+	 6712,  6738,  6764,  6790,  6815,  6841,  6867,  6892,  6917,  6943,  6968,  6993,
+	 7018,  7043,  7068,  7092,  7117,  7141,  7166,  7190,  7214,  7238,  7262,  7286,
+	 7310,  7334,  7358,  7381,  7405,  7428,  7451,  7475,  7498,  7521,  7544,  7566,
+	 7589,  7612,  7635,  7657,  7679,  7702,  7724,  7746,  7768,  7790,  7812,  7834,
+	 7856,  7877,  7899,  7920,  7942,  7963,  7984,  8005,  8026,  8047,  8068,  8089,
+	 8110,  8131,  8151,  8172,  8192
+};
+
+
+/**
+ * Linear interpolation in one of the tables.
+ *
+ * @param table the table with TABLE_SIZE + 1 entries
+ * @param index position in the table with FRACTION_BITS fractional bits
+ *        (between 0 and TABLE_SIZE << FRACTION_BITS)
+ */
+static int interpolate(const alt_u16 *table, unsigned int index) {
+	unsigned int i = index >> FRACTION_BITS;
+	int fraction = index & ((1 << FRACTION_BITS) - 1);
+
+	if(i >= TABLE_SIZE)
+		return table[TABLE_SIZE];
+
+	return table[i] + ((((int) table[i+1] - (int) table[i]) * fraction) >> FRACTION_BITS);
+}
+
+int sin_q15(int angle) {
+	unsigned int a = angle & (ANGLE_FULL - 1);
+	unsigned int r = a & (ANGLE_QUARTER - 1);
+	int value;
+
+	// the second and the fourth quarter are mirrored
+	if(a & ANGLE_QUARTER)
+		r = ANGLE_QUARTER - r;
+
+	value = interpolate(sin_table, r);
+
+	return (a & ANGLE_HALF) ? -value : value;
+}
+
+int cos_q15(int angle) {
+	return sin_q15(angle + ANGLE_QUARTER);
+}
+
+int atan2_angle(int y, int x) {
+	unsigned int ax = (x < 0) ? -x : x;
+	unsigned int ay = (y < 0) ? -y : y;
+	int angle;
+
+	if(ax == 0 && ay == 0)
+		return 0;
+
+	// reduce to the first octant: the ratio is between 0 and 1
+	if(ay <= ax)
+		angle = interpolate(atan_table, (ay << (TABLE_BITS + FRACTION_BITS)) / ax);
+	else
+		angle = ANGLE_QUARTER - interpolate(atan_table, (ax << (TABLE_BITS + FRACTION_BITS)) / ay);
+
+	if(x < 0)
+		angle = ANGLE_HALF - angle;
+
+	return (y < 0) ? -angle : angle;
+}
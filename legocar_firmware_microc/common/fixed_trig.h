@@ -0,0 +1,57 @@
+/*
+ * fixed_trig.h
+ *
+ * Sine, cosine and arc tangent in fixed-point format with lookup tables, for the CPU without
+ * a floating-point unit. Angles are binary angles: ANGLE_FULL is one full turn, an alt_16
+ * holds every angle from -180 degrees up to (excluding) +180 degrees and wraps around.
+ *
+ *  Created on: 17.10.2026
+ */
+
+#ifndef FIXED_TRIG_H_
+#define FIXED_TRIG_H_
+
+#include <alt_types.h>
+
+// binary angles: 90, 180 and 360 degrees
+#define ANGLE_QUARTER 16384
+#define ANGLE_HALF    32768
+#define ANGLE_FULL    65536
+
+#define DEGREES_TO_ANGLE(x) ((int) ((x) * ANGLE_FULL / 360))
+
+
+/**
+ * Sine of a binary angle, interpolated linearly between the entries of the table
+ * (maximum error about 2 / Q15_ONE).
+ *
+ * @param angle the angle, only the lower 16 bits are used
+ *
+ * @result the sine in Q15 format (between -32768 and 32768)
+ */
+int sin_q15(int angle);
+
+
+/**
+ * Cosine of a binary angle (see 'sin_q15').
+ *
+ * @param angle the angle, only the lower 16 bits are used
+ *
+ * @result the cosine in Q15 format (between -32768 and 32768)
+ */
+int cos_q15(int angle);
+
+
+/**
+ * Angle of the vector (x, y), like atan2(y, x) of the C library.
+ * Needs one integer division.
+ *
+ * @param y the y coordinate (absolute value below 2^17)
+ * @param x the x coordinate (absolute value below 2^17)
+ *
+ * @result binary angle between -ANGLE_HALF and ANGLE_HALF, 0 for the vector (0, 0)
+ */
+int atan2_angle(int y, int x);
+
+
+#endif /* FIXED_TRIG_H_ */
@@ -20,12 +20,45 @@
 #include "motor_control/legocar.h"
 // reading and working with the output of an acceleration sensor
 #include "acceleration_sensor/ins.h"
+#include "acceleration_sensor/ins_storage.h"
+#include "terasic_lib/terasic_includes.h"
+#include "terasic_lib/accelerometer_adxl345_spi.h"
+#include "terasic_lib/terasic_spi.h"
+#include "terasic_lib/flash.h"
+#include "terasic_lib/adc_spi_read.h"
+// run time measurements (enable with -DRUN_BENCHMARKS)
+#include "benchmark/benchmark.h"
+// releases the tasks at fixed rates
+#include "scheduler/rate_groups.h"
+// telemetry records in the flash
+#include "telemetry/flash_log.h"
+#include "telemetry/uart_telemetry.h"
+#include "telemetry/deferred_log.h"
+#include "telemetry/remote_control.h"
 
 
 // priorities of the different tasks
 #define STABILIZER_PRIORITY 1
 #define    CONTROL_PRIORITY 2
 #define ACC_SENSOR_PRIORITY 3
+// executes the SPI transfers of the other tasks
+#define SPI_DRIVER_PRIORITY 4
+// a task holding the lock of the flash runs at this priority (above all the users of the lock)
+#define FLASH_LOCK_PRIORITY 9
+// writes the telemetry records to the flash in the background
+#define  FLASH_LOG_PRIORITY 10
+// checks the content of the flash in the background
+#define FLASH_CHECK_PRIORITY 11
+// prints the messages of the other tasks (lowest priority of all)
+#define        LOG_PRIORITY 12
+
+
+// channels of the ADC: voltage of the battery and potentiometer of the steering
+#define ADC_BATTERY_CHANNEL  0
+#define ADC_STEERING_CHANNEL 1
+// conversions per tick (1 kHz per channel) and conversions averaged per sample (250 Hz)
+#define ADC_CONVERSIONS_PER_TICK 2
+#define ADC_DECIMATION           4
 
 
 // size of the stacks for the different tasks
@@ -35,6 +68,7 @@
 OS_STK  acc_sensor_task_stk[TASK_STACKSIZE];
 OS_STK  stabilizer_task_stk[TASK_STACKSIZE];
 OS_STK     control_task_stk[TASK_STACKSIZE];
+OS_STK flash_check_task_stk[TASK_STACKSIZE];
 
 
 // our LEGO-car
@@ -44,41 +78,128 @@ LegoCar car;
 INS ins;
 
 
-// task for parsing the output of the acceleration sensor
-void acc_sensor_task(void *pdata) {
+// add the state of the INS to the telemetry log
+void log_ins_state(void) {
+	FlashLogINS state;
+	int j;
 
-	// auto calibration:
-	printf("acc-sensor: calibrating acceleration sensor...\n");
+	for(j=0; j<3; j++) {
+		state.acceleration[j] = ins.acceleration[j];
+		state.speed[j]        = ins.speed[j];
+	}
 
-	if(!auto_calibrate_ins(&ins, 1000)) {
-		printf("acc-sensor: automatic calibration failed!\nShutting down sensor task...\n");
-		return;
+	log_record(FLASH_LOG_INS, &state, sizeof(state));
+}
+
+
+// send the state of the INS over the telemetry stream
+void send_ins_telemetry(int samples) {
+	TelemetryINS state;
+	int j;
+
+	for(j=0; j<3; j++) {
+		state.sample[j]       = ins.sample[j];
+		state.acceleration[j] = ins.acceleration[j];
+		state.speed[j]        = ins.speed[j];
 	}
+	state.samples = samples;
+
+	send_telemetry(TELEMETRY_INS, &state, sizeof(state));
+}
+
+
+// the calibration that the writer of the flash log stores for the next boot
+INSCalibrationRecord calibration_record;
+
+// job of the writer of the flash log, which has a low priority: erasing the block takes about 1 s
+void store_calibration_job(void *context) {
+	if(!store_ins_calibration(&ins, &calibration_record)) {
+		FlashLogFault fault = { FLASH_LOG_FAULT_CALIBRATION, 0 };
+		log_record(FLASH_LOG_FAULT, &fault, sizeof(fault));
+
+		deferred_log("acc-sensor: cannot store the calibration in the flash!\n");
+	}
+}
+
+
+// task for parsing the output of the acceleration sensor
+void acc_sensor_task(void *pdata) {
+
+	// the calibration is computed online while the car is standing still
 
 	// manual calibration:
 	// calibrate_ins(ins, 0.0, 0.46, -0.4);
 
-	printf( "acc-sensor: calibration successful: %7.4f, %7.4f, %7.4f\n", ins.sensor_calibration[0],
-																		 ins.sensor_calibration[1],
-																		 ins.sensor_calibration[2] );
-
-	// time to wait between two values from the sensor (in seconds)
-	double timestep = 0.001;
+	// from now on the sensor queues its samples and we read all of them at once
+	if(!enable_ins_fifo(&ins, XL345_RATE_1600, 16)) {
+		printf("acc-sensor: cannot enable the FIFO of the sensor!\nShutting down sensor task...\n");
+		return;
+	}
 
 	int i = 0;
+	int calibrated = 0;
 	while(1) {
 
-		// update the INS with new values from the sensor
-		if(!update_ins(&ins, timestep)) {
-			printf("acc-sensor: reading failed! Skipping...\n");
+		// 16 samples are queued per period
+		wait_for_release(RATE_GROUP_100HZ);
+
+		// update the INS with all new values from the sensor
+		int samples = update_ins_batch(&ins);
+		if(samples < 0) {
+			FlashLogFault fault = { FLASH_LOG_FAULT_SENSOR_READ, (alt_u32) i };
+			log_record(FLASH_LOG_FAULT, &fault, sizeof(fault));
+
+			deferred_log("acc-sensor: reading failed! Skipping...\n");
 			continue;
 		}
 
-		if(i++ % 100 == 0) printf("acc-sensor: acceleration (%d): X: %6.2f,\tY: %6.2f,\tZ: %6.2f\n", i, ins.acceleration[0], ins.acceleration[1], ins.acceleration[2]);
-		// printf("acc-sensor: speed (%d): X: %6.2f,\tY: %6.2f,\tZ: %6.2f\n", i, ins.speed[0], ins.speed[1], ins.speed[2]);
+		log_ins_state();
+		send_ins_telemetry(samples);
+
+		if(!calibrated && ins_is_calibrated(&ins)) {
+			calibrated = 1;
+			// in Q15, the deferred log formats them with four decimals
+			deferred_log(ins.calibration_stored ? "acc-sensor: calibration loaded from flash: %q, %q, %q\n"
+			                                    : "acc-sensor: calibration successful: %q, %q, %q\n",
+			             FLOAT_TO_Q15(ins.sensor_calibration[0]),
+			             FLOAT_TO_Q15(ins.sensor_calibration[1]),
+			             FLOAT_TO_Q15(ins.sensor_calibration[2]));
+
+			// the next boot does not need to calibrate again (the writer of the log erases the flash)
+			if(!ins.calibration_stored && prepare_ins_calibration(&ins, &calibration_record)
+			   && !queue_flash_job(store_calibration_job, NULL)) {
+				deferred_log("acc-sensor: cannot store the calibration, the flash log is not running!\n");
+			}
+		}
 
-		// wait for one millisecond
-		OSTimeDlyHMSM(0, 0, 0, timestep * 1000);
+		// the acceleration is sent in the telemetry stream, printing it here would stall the task
+		i++;
+
+		// check whether the sampling pipeline is keeping up with the sensor
+		if(i % 1000 == 0) {
+			INSTimingStats timing;
+			get_ins_timing_stats(&ins, &timing);
+			deferred_log("acc-sensor: read interval: %d us (jitter %d us), FIFO overflows: %u\n",
+			             (alt_32) (timing.mean_interval * 1e6), (alt_32) (timing.jitter * 1e6), timing.fifo_overflows);
+			deferred_log("acc-sensor: read interval: min %d us, max %d us\n",
+			             (alt_32) (timing.min_interval * 1e6), (alt_32) (timing.max_interval * 1e6));
+			reset_ins_timing_stats(&ins);
+
+			// what the bus delivers
+			SPI_STATS spi;
+			SPI_GetTotalStats(&spi);
+			if(spi.nTransfers > 0) {
+				deferred_log("acc-sensor: SPI: %u transfers, %u bytes, %u timeouts\n",
+				             spi.nTransfers, spi.nBytes, spi.nTimeouts);
+				deferred_log("acc-sensor: SPI: %u polls (max %u)\n", spi.nPollSum / spi.nTransfers, spi.nPollMax);
+				// only measured with a timestamp timer
+				if(spi.LatencyFreq > 0)
+					deferred_log("acc-sensor: SPI: %u us latency (max %u us)\n",
+					             (alt_u32) ((alt_u64) spi.LatencySum / spi.nTransfers * 1000000 / spi.LatencyFreq),
+					             (alt_u32) ((alt_u64) spi.LatencyMax * 1000000 / spi.LatencyFreq));
+			}
+			SPI_ResetStats();
+		}
 	}
 
 }
@@ -86,46 +207,338 @@ void acc_sensor_task(void *pdata) {
 
 // task for stabilizing the direction of the wheels
 void stabilizer_task(void *data) {
-	control_loop(&car);
 
-	return;
+	while(1) {
+		wait_for_release(RATE_GROUP_1KHZ);
+
+		stabilizer_step(&car);
+	}
+
 }
 
 
-// task for steering the car
-void control_task(void *data) {
+// print the deadline statistics of all rate groups (through the deferred log, the control task must not block)
+void print_rate_group_stats(void) {
+	RateGroupStats stats;
+	int g;
 
-	align_wheels(&car, MOVE_DIAGONAL, 1);
-	set_driving_power(&car, MOVE_DIAGONAL, 0.5);
+	for(g=0; g<RATE_GROUP_COUNT; g++) {
+		get_rate_group_stats(g, &stats);
+		deferred_log("rate group %d: %u releases, %u deadline misses, %u overruns\n", g,
+		             stats.releases, stats.deadline_misses, stats.overruns);
+	}
+}
 
-	enable_wheel_stabilizer(&car);
+
+// print the statistics of the telemetry log (a message takes at most four arguments)
+void print_flash_log_stats(void) {
+	FlashLogStats stats;
+
+	get_flash_log_stats(&stats);
+	deferred_log("flash log: %u records (%u dropped), %u written (%u bytes)\n",
+	             stats.records, stats.dropped, stats.written, stats.bytes);
+	deferred_log("flash log: block %u, %u erases (wear %u..%u)\n",
+	             stats.sequence, stats.erases, stats.min_erase_count, stats.max_erase_count);
+	deferred_log("flash log: %u errors, max. %u bytes buffered\n", stats.errors, stats.max_buffered);
+}
+
+
+// print the statistics of the flash driver: handles in use (they are never taken from the heap) and read cache
+void print_flash_stats(void) {
+	FLASH_ALLOC_STATS alloc;
+	FLASH_CACHE_STATS cache;
+
+	Flash_GetAllocStats(&alloc);
+	Flash_GetCacheStats(&cache);
+	deferred_log("flash: %u of %d handles open (max. %u, %u failed)\n",
+	             alloc.nHandleUsed, FLASH_HANDLE_NUM, alloc.nHandleMax, alloc.nHandleFail);
+	deferred_log("flash: read cache: %u hits, %u misses, %u bypassed\n", cache.nHit, cache.nMiss, cache.nBypass);
+}
+
+
+// print the latest samples of the ADC and the statistics of the scan
+void print_adc_stats(void) {
+	ADC_SAMPLE battery, steering;
+	ADC_SCAN_STATS stats;
+
+	if(!ADC_GetLatest(ADC_BATTERY_CHANNEL, &battery) || !ADC_GetLatest(ADC_STEERING_CHANNEL, &steering)) {
+		deferred_log("adc: no samples\n");
+		return;
+	}
+	ADC_GetScanStats(&stats);
+	deferred_log("adc: battery %u (tick %u), steering %u (tick %u)\n",
+	             battery.Value, battery.Timestamp, steering.Value, steering.Timestamp);
+	deferred_log("adc: %u conversions, %u busy (max. %u polls)\n", stats.nConversion, stats.nBusy, stats.nPollMax);
+}
+
+
+// send the deadline statistics of the rate groups over the telemetry stream
+void send_task_telemetry(void) {
+	TelemetryTasks tasks;
+	TelemetryStats telemetry;
+	RateGroupStats stats;
+	int g;
+
+	for(g=0; g<RATE_GROUP_COUNT; g++) {
+		get_rate_group_stats(g, &stats);
+		tasks.releases[g]        = stats.releases;
+		tasks.deadline_misses[g] = stats.deadline_misses;
+		tasks.overruns[g]        = stats.overruns;
+	}
+	get_telemetry_stats(&telemetry);
+	tasks.dropped = telemetry.dropped;
+
+	send_telemetry(TELEMETRY_TASKS, &tasks, sizeof(tasks));
+}
+
+
+// add a command of the control task to the telemetry log, and send the resulting powers
+// of the engines over the telemetry stream
+void log_motor_command(int mode, float direction, float power) {
+	FlashLogMotor command = { mode, direction, power };
+	TelemetryMotor motor;
+	int w;
+
+	log_record(FLASH_LOG_MOTOR, &command, sizeof(command));
+
+	motor.mode = mode;
+	for(w=0; w<4; w++) {
+		motor.speed[w]     = get_power_q15(&car.speed[w]);
+		motor.direction[w] = get_power_q15(&car.direction[w]);
+	}
+	send_telemetry(TELEMETRY_MOTOR, &motor, sizeof(motor));
+}
+
+
+// limits for decoding the commands of the host in one period of the control task
+#define COMMANDS_PER_PERIOD      4
+#define COMMAND_BYTES_PER_PERIOD 64
+// the car stops, if the host has not sent a command for this number of ticks
+#define COMMAND_TIMEOUT          1000
+
+// state of the car while it is driven by the host
+typedef struct RemoteDriving {
+	int     active;         // 1: the host has taken over from the demonstration
+	int     mode;           // driving pattern (MOVE_*)
+	int     direction;      // Q15
+	int     power;          // Q15
+	alt_u8  sequence;       // of the last command
+} RemoteDriving;
+
+RemoteDriving remote;
+
+
+// answer a COMMAND_QUERY of the host
+void send_remote_state(void) {
+	RemoteControlState state;
+	RemoteControlStats stats;
+
+	get_remote_control_stats(&stats);
+
+	state.sequence     = remote.sequence;
+	state.mode         = remote.mode;
+	state.direction    = (remote.direction >= Q15_ONE) ? Q15_ONE - 1 : remote.direction;
+	state.power        = (remote.power >= Q15_ONE) ? Q15_ONE - 1 : remote.power;
+	state.reserved     = 0;
+	state.commands     = stats.commands;
+	state.errors       = stats.errors;
+	state.latency_last = stats.latency_last;
+	state.latency_max  = stats.latency_max;
+
+	send_telemetry(TELEMETRY_STATE, &state, sizeof(state));
+}
+
+
+// set the engines as the host commands
+void apply_remote_command(const RemoteCommand *command) {
+
+	switch(command->type) {
+
+	case COMMAND_VELOCITY:
+		drive_pattern_q15(&car, MOVE_DIAGONAL, command->direction, command->power);
+		remote.mode      = MOVE_DIAGONAL;
+		remote.direction = command->direction;
+		remote.power     = command->power;
+		break;
+
+	case COMMAND_ROTATE:
+		drive_pattern_q15(&car, MOVE_ROTATE, Q15_ONE, command->power);
+		remote.mode      = MOVE_ROTATE;
+		remote.direction = Q15_ONE;
+		remote.power     = command->power;
+		break;
+
+	case COMMAND_STOP:
+		stop(&car);
+		remote.power = 0;
+		break;
+	}
+
+	// the engines have been set (or the query is answered right away)
+	command_applied(command);
+
+	remote.active   = 1;
+	remote.sequence = command->sequence;
+
+	if(command->type == COMMAND_QUERY)
+		send_remote_state();
+	else
+		log_motor_command(remote.mode, Q15_TO_FLOAT(remote.direction), Q15_TO_FLOAT(remote.power));
+}
+
+
+// apply the commands the host has sent since the last period
+// returns 1 as soon as the host has taken over from the demonstration
+int handle_remote_commands(void) {
+
+	apply_commands(apply_remote_command, COMMANDS_PER_PERIOD, COMMAND_BYTES_PER_PERIOD);
+
+	// the connection to the host may be lost
+	if(command_timeout(COMMAND_TIMEOUT)) {
+		stop(&car);
+		remote.power = 0;
+		log_motor_command(remote.mode, Q15_TO_FLOAT(remote.direction), 0);
+		deferred_log("remote: no command for %d ticks, stopping\n", COMMAND_TIMEOUT);
+	}
+
+	return remote.active;
+}
+
+
+// number of flash blocks checked at once, and the pause in between (in ticks)
+#define FLASH_CHECK_BLOCKS 1
+#define FLASH_CHECK_PAUSE  100
+
+// buffer for reading the flash blocks
+static alt_u8 flash_check_buffer[4096];
+
+// task for checking the content of the flash (FPGA configuration) against the manifest
+void flash_check_task(void *data) {
+	static FLASH_MANIFEST manifest;
+	FLASH_VERIFY_STATE state;
+	FLASH_HANDLE flash;
+	alt_u16 manifest_block;
+	int valid, done, pass = 0;
+
+	flash = Flash_Open(EPCS_NAME);
+	if(!flash) {
+		deferred_log("flash check: cannot open the flash!\n");
+		OSTaskDel(OS_PRIO_SELF);
+	}
+
+	// the manifest is kept in the block in front of the telemetry log and covers all the blocks before it
+	manifest_block = Flash_GetBlockCount(flash) - INS_CALIBRATION_BLOCK - FLASH_LOG_BLOCKS - 1;
+
+	lock_flash_log();
+	valid = Flash_ManifestLoad(flash, manifest_block, &manifest)
+	        && manifest.FirstBlock == 0 && manifest.BlockNum == manifest_block;
+	if(!valid) {
+		// the flash has been erased: record its current content
+		valid = Flash_ManifestBuild(flash, 0, manifest_block, &manifest, flash_check_buffer, sizeof(flash_check_buffer))
+		        && Flash_ManifestStore(flash, manifest_block, &manifest);
+		deferred_log(valid ? "flash check: created the manifest of %d blocks\n"
+		                   : "flash check: cannot create the manifest of %d blocks\n", manifest_block);
+	}
+	unlock_flash_log();
+
+	if(!valid) {
+		Flash_Close(flash);
+		OSTaskDel(OS_PRIO_SELF);
+	}
 
 	while(1) {
 
-		printf("straight\n");
-		align_wheels(&car, MOVE_DIAGONAL, 0);
+		// only a few blocks at once, so the telemetry log does not wait for long
+		Flash_VerifyStart(&state);
+		do {
+			lock_flash_log();
+			done = Flash_VerifyStep(flash, &manifest, &state, FLASH_CHECK_BLOCKS,
+			                        flash_check_buffer, sizeof(flash_check_buffer));
+			unlock_flash_log();
 
-		set_driving_power(&car, MOVE_DIAGONAL, 0.5);
+			OSTimeDly(FLASH_CHECK_PAUSE);
+		} while(!done);
 
-		OSTimeDlyHMSM(0,0,5,0);
+		if(state.nMismatch > 0 || state.nError > 0) {
+			FlashLogFault fault = { FLASH_LOG_FAULT_FLASH_CHECK, (alt_u32) state.nFirstMismatch };
+			log_record(FLASH_LOG_FAULT, &fault, sizeof(fault));
 
-		printf("parallel\n");
-		align_wheels(&car, MOVE_DIAGONAL, 0.8);
+			// after programming a new FPGA configuration, erase the block of the manifest
+			deferred_log("flash check: %d blocks differ from the manifest (first: %d), %d cannot be read!\n",
+			             state.nMismatch, state.nFirstMismatch, state.nError);
+		}
+		else if(pass == 0) {
+			deferred_log("flash check: %d blocks OK\n", manifest.BlockNum);
+		}
 
-		OSTimeDlyHMSM(0,0,5,0);
+		pass++;
+		OSTimeDlyHMSM(0, 1, 0, 0);
+	}
+
+}
 
-		printf("circle\n");
-		align_wheels(&car, MOVE_ROTATE, 1);
-		// two wheels have to rotate inverted
-		set_driving_power(&car, MOVE_ROTATE, 0.5);
 
-		OSTimeDlyHMSM(0,0,5,0);
+// task for steering the car
+void control_task(void *data) {
 
-		printf("curve\n");
-		align_wheels(&car, MOVE_CURVE, 0.8);
-		set_driving_power(&car, MOVE_CURVE, 0.5);
+	// duration of each driving mode in periods of the task
+	const int mode_periods = (int) (5 / rate_group_period(RATE_GROUP_10HZ) + 0.5);
 
-		OSTimeDlyHMSM(0,0,5,0);
+#ifdef RUN_BENCHMARKS
+	run_task_benchmarks();
+#endif
+
+	drive_pattern_q15(&car, MOVE_DIAGONAL, Q15_ONE, FLOAT_TO_Q15(0.5));
+
+	enable_wheel_stabilizer(&car);
+
+	int step = 0;
+	while(1) {
+
+		wait_for_release(RATE_GROUP_10HZ);
+
+		send_task_telemetry();
+
+		// the commands of the host are applied within one period
+		if(handle_remote_commands())
+			continue;
+
+		// only act when the next driving mode starts
+		if(step++ % mode_periods != 0)
+			continue;
+
+		switch( (step / mode_periods) % 4 ) {
+
+		case 0:
+			deferred_log("straight\n");
+			drive_pattern_q15(&car, MOVE_DIAGONAL, 0, FLOAT_TO_Q15(0.5));
+			log_motor_command(MOVE_DIAGONAL, 0, 0.5);
+			break;
+
+		case 1:
+			deferred_log("parallel\n");
+			drive_pattern_q15(&car, MOVE_DIAGONAL, FLOAT_TO_Q15(0.8), FLOAT_TO_Q15(0.5));
+			log_motor_command(MOVE_DIAGONAL, 0.8, 0.5);
+			break;
+
+		case 2:
+			deferred_log("circle\n");
+			// two wheels have to rotate inverted
+			drive_pattern_q15(&car, MOVE_ROTATE, Q15_ONE, FLOAT_TO_Q15(0.5));
+			log_motor_command(MOVE_ROTATE, 1, 0.5);
+			break;
+
+		case 3:
+			deferred_log("curve\n");
+			drive_pattern_q15(&car, MOVE_CURVE, FLOAT_TO_Q15(0.8), FLOAT_TO_Q15(0.5));
+			log_motor_command(MOVE_CURVE, 0.8, 0.5);
+
+			print_rate_group_stats();
+			print_flash_log_stats();
+			print_flash_stats();
+			print_adc_stats();
+			break;
+		}
 
 	}
 
@@ -173,11 +586,49 @@ int main (void)
 	// --> the structure is used to exchange data between threads, so it has to be volatile
 	init_ins(&ins, GSENSOR_SPI_BASE);
 
+	// continue the telemetry log of the previous sessions
+	if(!init_flash_log(EPCS_NAME))
+		printf("ERROR: cannot open the telemetry log in the flash!\n");
+
+
+#ifdef RUN_BENCHMARKS
+	run_benchmarks();
+#endif
 
 	printf("Starting system!\n");
 
 	OSInit();
 
+	// the tasks are released by the system timer
+	if(!init_rate_groups())
+		printf("ERROR: cannot start the rate groups!\n");
+
+	// from now on the tasks sleep during SPI transfers
+	if(!SPI_AsyncInit(SPI_DRIVER_PRIORITY))
+		printf("ERROR: cannot start the SPI driver!\n");
+
+	// from now on the messages of the tasks are printed in the background
+	if(!start_deferred_log(LOG_PRIORITY))
+		printf("ERROR: cannot start printing the log!\n");
+
+	// from now on the telemetry is sent over uart_0
+	if(!init_uart_telemetry())
+		printf("ERROR: cannot start the telemetry on the UART!\n");
+
+	// sample the battery and the steering in the background
+	{
+		const alt_u8 adc_channels[] = { ADC_BATTERY_CHANNEL, ADC_STEERING_CHANNEL };
+
+		ADC_SetDecimation(ADC_BATTERY_CHANNEL, ADC_DECIMATION);
+		ADC_SetDecimation(ADC_STEERING_CHANNEL, ADC_DECIMATION);
+		if(!ADC_ScanStart(adc_channels, sizeof(adc_channels), ADC_CONVERSIONS_PER_TICK))
+			printf("ERROR: cannot start scanning the ADC!\n");
+	}
+
+	// from now on the telemetry records are written to the flash
+	if(!start_flash_log_writer(FLASH_LOG_PRIORITY, FLASH_LOCK_PRIORITY))
+		printf("ERROR: cannot start writing the telemetry log!\n");
+
 	// create the task for the wheel stabilization procedure
 	OSTaskCreateExt(stabilizer_task,
 		            NULL,
@@ -201,6 +652,17 @@ int main (void)
 					NULL,
 					0);
 
+	// create the task for checking the flash
+	OSTaskCreateExt(flash_check_task,
+					NULL,
+					(void *) &flash_check_task_stk[TASK_STACKSIZE-1],
+					FLASH_CHECK_PRIORITY,
+					FLASH_CHECK_PRIORITY,
+					flash_check_task_stk,
+					TASK_STACKSIZE,
+					NULL,
+					0);
+
 /* Third task messes up the system :-(
  * When this thread is activated additionally to the other two threads,
  * the main-function will be started over and over again.
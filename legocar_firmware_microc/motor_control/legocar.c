@@ -12,11 +12,22 @@
 #include "includes.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include "../telemetry/deferred_log.h"
 #include <unistd.h>
 
 
+// the motors set by 'drive_wheels' and 'drive_pattern'
+#define DRIVE_STEERING 1
+#define DRIVE_POWER    2
+#define DRIVE_ALL      (DRIVE_STEERING | DRIVE_POWER)
+
+
+static void drive_pattern(LegoCar *car, int type, int direction, int power, int parts);
+
+
 void init_legocar(LegoCar *car, alt_u32 motor_base_addresses[8], int pwm_period) {
-	int w;
+	int w, corner;
 
 	for(w=0; w<8; w++) {
 		if( w < 4 )
@@ -25,65 +36,191 @@ void init_legocar(LegoCar *car, alt_u32 motor_base_addresses[8], int pwm_period)
 			init_pwm_motor(&(car->direction[w-4]), motor_base_addresses[w], pwm_period);
 	}
 
+	car->stabilizer_state = STABILIZER_IDLE;
+	car->stabilizer_ticks = 0;
+
+	car->pattern_type      = MOVE_DIAGONAL;
+	car->pattern_direction = 0;
+	car->pattern_power     = 0;
+
+	// the wheels are at the corners of the rectangle CAR_HALF_LENGTH x CAR_HALF_WIDTH
+	corner = atan2_angle(CAR_HALF_WIDTH, CAR_HALF_LENGTH);
+	for(w=0; w<4; w++) {
+		car->wheel_x[w] = (w == FRONT_LEFT || w == FRONT_RIGHT) ? cos_q15(corner) : -cos_q15(corner);
+		car->wheel_y[w] = (w == FRONT_LEFT || w == BACK_LEFT)   ? sin_q15(corner) : -sin_q15(corner);
+	}
 }
 
 void align_wheels(LegoCar *car, int type, float direction) {
+	align_wheels_q15(car, type, FLOAT_TO_Q15(direction));
+}
 
-	int w;
+void align_wheels_q15(LegoCar *car, int type, int direction) {
+	// the angles of the wheels for any power forwards, so the wheels are aligned even if the car stands still
+	drive_pattern(car, type, direction, Q15_ONE, DRIVE_STEERING);
+}
 
-	for(w=0; w<4; w++) {
-		switch(type) {
-		case MOVE_DIAGONAL:
-			set_direction(&car->direction[w], direction);
-			break;
+void set_driving_power(LegoCar *car, int type, float power) {
+	set_driving_power_q15(car, type, FLOAT_TO_Q15(power));
+}
 
-		case MOVE_ROTATE:
-			if(w == 0 || w == 3)
-				set_direction(&car->direction[w], -1);
-			else
-				set_direction(&car->direction[w], +1);
-			break;
+void set_driving_power_q15(LegoCar *car, int type, int power) {
+	drive_pattern(car, type, car->pattern_direction, power, DRIVE_POWER);
+}
 
-		case MOVE_CURVE:
-			if(w < 2)
-				set_direction(&car->direction[w], direction);
-			else
-				set_direction(&car->direction[w], -direction);
-			break;
+/**
+ * Choose the steering angle for a wheel that should move into the given direction.
+ * The wheel can also point into the opposite direction and run backwards, the one of both
+ * that is within the steering range (or nearer to it) is taken. If both are equally far away,
+ * the one nearer to the current steering angle is taken.
+ *
+ * @param target direction of the velocity of the wheel (binary angle)
+ * @param current current steering angle of the wheel (binary angle)
+ *
+ * @result the steering angle (between -STEERING_ANGLE_MAX and STEERING_ANGLE_MAX)
+ */
+static int steering_angle(int target, int current) {
+	int angle[2], error[2], i;
 
-		default:
-			printf("!!!Invalid wheel alignment type!!!\n");
-			break;
-		}
+	// both candidates between -ANGLE_HALF and ANGLE_HALF
+	angle[0] = target;
+	angle[1] = (target < 0) ? target + ANGLE_HALF : target - ANGLE_HALF;
 
-		printf("wheel %d: direction %f\n", w+1, get_direction(&car->direction[w]));
+	for(i=0; i<2; i++) {
+		error[i] = 0;
+		if(angle[i] > STEERING_ANGLE_MAX) {
+			error[i] = angle[i] - STEERING_ANGLE_MAX;
+			angle[i] = STEERING_ANGLE_MAX;
+		}
+		else if(angle[i] < -STEERING_ANGLE_MAX) {
+			error[i] = -STEERING_ANGLE_MAX - angle[i];
+			angle[i] = -STEERING_ANGLE_MAX;
+		}
 	}
 
-	return;
+	if(error[0] != error[1])
+		return (error[0] < error[1]) ? angle[0] : angle[1];
+
+	return (abs(angle[0] - current) <= abs(angle[1] - current)) ? angle[0] : angle[1];
 }
 
-void set_driving_power(LegoCar *car, int type, float power) {
+static int clamp_q15(int value) {
+	if(value > Q15_ONE)
+		return Q15_ONE;
+	if(value < -Q15_ONE)
+		return -Q15_ONE;
+	return value;
+}
 
-	int w;
+void drive(LegoCar *car, float vx, float vy, float omega) {
+	drive_q15(car, FLOAT_TO_Q15(vx), FLOAT_TO_Q15(vy), FLOAT_TO_Q15(omega));
+}
 
-	// set the correct speed on every wheel
-	for(w=0; w<4; w++)
-		switch(type) {
+/**
+ * The swerve drive of 'drive_q15', setting only a part of the motors.
+ * With DRIVE_POWER only, the speeds of the wheels are calculated for the steering angles that
+ * DRIVE_STEERING would set, but the direction motors are not touched.
+ *
+ * @param parts the motors to set (DRIVE_STEERING, DRIVE_POWER or DRIVE_ALL)
+ */
+static void drive_wheels(LegoCar *car, int vx, int vy, int omega, int parts) {
 
-		case MOVE_DIAGONAL:
-		case MOVE_CURVE:
-			set_power(&(car->speed[w]), power);
-			break;
+	int angle[4], speed[4];
+	int w, wx, wy, current, scale, max_speed = 0;
 
-		case MOVE_ROTATE:
-			set_power(&(car->speed[w]), (w % 2 == 0) ? -power : power);
-			break;
+	vx    = clamp_q15(vx);
+	vy    = clamp_q15(vy);
+	omega = clamp_q15(omega);
+
+	for(w=0; w<4; w++) {
+		// velocity of the wheel: velocity of the car + rotation around the center
+		wx = vx - ((omega * car->wheel_y[w]) >> 15);
+		wy = vy + ((omega * car->wheel_x[w]) >> 15);
+
+		current = get_direction_q15(&car->direction[w]) * STEERING_ANGLE_MAX / Q15_ONE;
+
+		// a wheel that does not move keeps its direction
+		if(wx == 0 && wy == 0) {
+			angle[w] = current;
+			speed[w] = 0;
+			continue;
 		}
 
+		angle[w] = steering_angle(atan2_angle(wy, wx), current);
+
+		// part of the velocity along the wheel, negative if the wheel points backwards
+		// (the velocity can be up to 2 * Q15_ONE, halve the sine and cosine to avoid an overflow)
+		speed[w] = ((wx * (cos_q15(angle[w]) >> 1)) >> 14) + ((wy * (sin_q15(angle[w]) >> 1)) >> 14);
+
+		if(abs(speed[w]) > max_speed)
+			max_speed = abs(speed[w]);
+	}
+
+	// slow down all wheels by the same factor, if one is faster than full power
+	if(max_speed > Q15_ONE) {
+		scale = (Q15_ONE << 15) / max_speed;
+		for(w=0; w<4; w++)
+			speed[w] = ((speed[w] >> 2) * scale) >> 13;
+	}
+
+	for(w=0; w<4; w++) {
+		if(parts & DRIVE_STEERING)
+			set_direction_q15(&car->direction[w], angle[w] * Q15_ONE / STEERING_ANGLE_MAX);
+		if(parts & DRIVE_POWER)
+			set_power_q15(&car->speed[w], clamp_q15(speed[w]));
+	}
+}
+
+void drive_q15(LegoCar *car, int vx, int vy, int omega) {
+	drive_wheels(car, vx, vy, omega, DRIVE_ALL);
+}
+
+void drive_pattern_q15(LegoCar *car, int type, int direction, int power) {
+	drive_pattern(car, type, direction, power, DRIVE_ALL);
+}
+
+/**
+ * The driving patterns of 'drive_pattern_q15', setting only a part of the motors (see 'drive_wheels').
+ * The pattern is kept in the car, 'direction' only with DRIVE_STEERING and 'power' only with DRIVE_POWER.
+ */
+static void drive_pattern(LegoCar *car, int type, int direction, int power, int parts) {
+
+	int angle = direction * STEERING_ANGLE_MAX / Q15_ONE;
+	int s = sin_q15(angle), c = cos_q15(angle);
+	int divisor;
+
+	switch(type) {
+	case MOVE_DIAGONAL:
+		drive_wheels(car, (power * c) >> 15, (power * s) >> 15, 0, parts);
+		break;
+
+	case MOVE_ROTATE:
+		drive_wheels(car, 0, 0, power, parts);
+		break;
+
+	case MOVE_CURVE:
+		// the center of rotation is on the lateral axis at the distance
+		// r = wheel_y + wheel_x / tan(angle) from the center, on the side of the inner wheels
+		// => omega = power / r = power * sin(angle) / (wheel_y * sin(angle) + wheel_x * cos(angle))
+		divisor = ((car->wheel_y[FRONT_LEFT] * abs(s)) >> 15) + ((car->wheel_x[FRONT_LEFT] * c) >> 15);
+		drive_wheels(car, power, 0, ((power * s) >> 15) * Q15_ONE / divisor, parts);
+		break;
+
+	default:
+		deferred_log("!!!Invalid driving pattern %d!!!\n", type);
+		return;
+	}
+
+	// 'align_wheels_q15' and 'set_driving_power_q15' change one half of it
+	car->pattern_type = type;
+	if(parts & DRIVE_STEERING)
+		car->pattern_direction = direction;
+	if(parts & DRIVE_POWER)
+		car->pattern_power = power;
 }
 
 void stop(LegoCar *car) {
-	set_driving_power(car, MOVE_CURVE, 0);
+	set_driving_power_q15(car, car->pattern_type, 0);
 }
 
 void enable_wheel_stabilizer(LegoCar *car) {
@@ -94,21 +231,55 @@ void disable_wheel_stabilizer(LegoCar *car) {
 	car->hold_direction_mode = 0;
 }
 
-void control_loop(LegoCar *car) {
+void stabilizer_step(LegoCar *car) {
+	int w;
 
-	while(1) {
+#if OS_CRITICAL_METHOD == 3
+	OS_CPU_SR cpu_sr = 0;
+#endif
 
-		// if car.hold_direction_mode is set then realign the wheels
-		if( car->hold_direction_mode ) {
+	switch(car->stabilizer_state) {
 
-			int w = 0;
-			for(w=0; w<4; w++)
-				realign_wheel(&car->direction[w]);
+	case STABILIZER_IDLE:
+		// if car.hold_direction_mode is set then start a new pass
+		if( !car->hold_direction_mode || car->stabilizer_ticks++ % STABILIZER_PERIOD != 0 )
+			break;
+
+		// kick all the wheels at the same time
+		OS_ENTER_CRITICAL();
+		for(w=0; w<4; w++) {
+			car->stabilizer_hold[w] = kick_wheel(&car->direction[w]);
+			car->stabilizer_kick[w] = get_power_q15(&car->direction[w]);
 		}
+		OS_EXIT_CRITICAL();
 
-		// wait for 10 milliseconds
-		OSTimeDlyHMSM(0, 0, 0, 10);
-	}
+		car->stabilizer_state = STABILIZER_KICKED;
+		break;
+
+	case STABILIZER_KICKED:
+		// restore the wheels, even if the stabilizer has been disabled in the meantime
+		OS_ENTER_CRITICAL();
+		for(w=0; w<4; w++) {
+			// the wheel has been aligned to a new direction since the kick => keep it
+			if( get_power_q15(&car->direction[w]) == car->stabilizer_kick[w] )
+				restore_wheel(&car->direction[w], car->stabilizer_hold[w]);
+		}
+		OS_EXIT_CRITICAL();
 
+		car->stabilizer_ticks++;
+		car->stabilizer_state = STABILIZER_IDLE;
+		break;
+	}
 }
 
+void control_loop(LegoCar *car) {
+
+	while(1) {
+
+		stabilizer_step(car);
+
+		// wait for the next tick
+		OSTimeDly(1);
+	}
+
+}
@@ -9,6 +9,7 @@
 #define LEGOCAR_H_
 
 #include "pwm_motor.h"
+#include "../common/fixed_trig.h"
 
 // indices of the engines responsible for rotating/aligning the wheels
 // compare labels on the car:  label_value - 1 = index
@@ -34,6 +35,26 @@
 #define MOVE_CURVE    2
 
 
+// geometry of the car for 'drive': distance of the axles and of the wheels on one axle from
+// the center of the car (only the ratio matters)
+#define CAR_HALF_LENGTH 1
+#define CAR_HALF_WIDTH  1
+
+// steering angle of the wheels at direction 1 (binary angle, see common/fixed_trig.h)
+// with MOVE_ROTATE the wheels are tangential to the circle around the center of the car,
+// which is 45 degrees for a square wheelbase
+#define STEERING_ANGLE_MAX (ANGLE_QUARTER / 2)
+
+
+// states of the wheel stabilizer
+#define STABILIZER_IDLE   0
+#define STABILIZER_KICKED 1
+
+// number of ticks of the operating system from one stabilization pass to the next
+// the wheels are kicked in the first tick and restored in the second one
+#define STABILIZER_PERIOD 5
+
+
 typedef struct LegoCar {
 	PWM_Motor speed[4];
 	PWM_Motor direction[4];
@@ -41,6 +62,23 @@ typedef struct LegoCar {
 	int hold_direction_mode;
 	float hold_direction;
 	float hold_speed;
+
+	// state of the wheel stabilizer (see 'stabilizer_step')
+	int stabilizer_state;
+	int stabilizer_ticks;
+	// powers (Q15) of the direction motors before and during the kick
+	int stabilizer_hold[4];
+	int stabilizer_kick[4];
+
+	// position of the wheels relative to the center of the car (Q15, normalized to the
+	// distance of the wheels from the center), x pointing forwards and y to the left
+	int wheel_x[4];
+	int wheel_y[4];
+
+	// last driving pattern of 'drive_pattern_q15', 'align_wheels_q15' and 'set_driving_power_q15' (Q15)
+	int pattern_type;
+	int pattern_direction;
+	int pattern_power;
 } LegoCar;
 
 
@@ -57,7 +95,7 @@ void init_legocar( LegoCar *car, alt_u32 motor_base_addresses[8], int pwm_period
 
 /**
  * Move all wheels of the car to the direction that is necessary for the given
- * driving pattern.
+ * driving pattern, also while the car stands still. The engines keep their power.
  *
  * @param car the legocar
  * @param type the driving pattern (MOVE_DIAGONAL, MOVE_ROTATE, MOVE_CURVE)
@@ -67,7 +105,18 @@ void align_wheels( LegoCar *car, int type, float direction );
 
 
 /**
- * Make the car running at the specified speed.
+ * Same as 'align_wheels', but with the direction given in fixed-point format.
+ *
+ * @param car the legocar
+ * @param type the driving pattern (MOVE_DIAGONAL, MOVE_ROTATE, MOVE_CURVE)
+ * @param direction how far the wheels should be turned (between -Q15_ONE and Q15_ONE)
+ */
+void align_wheels_q15( LegoCar *car, int type, int direction );
+
+
+/**
+ * Make the car running at the specified speed. The wheels keep their direction: the power of
+ * every engine is calculated for the direction of the last pattern (see 'align_wheels').
  *
  * @param car the legocar
  * @param type the driving pattern (MOVE_DIAGONAL, MOVE_ROTATE, MOVE_CURVE)
@@ -77,7 +126,59 @@ void set_driving_power(LegoCar *car, int movement_type, float power);
 
 
 /**
- * Stop all movements of the car immediately.
+ * Same as 'set_driving_power', but with the power given in fixed-point format.
+ *
+ * @param car the legocar
+ * @param type the driving pattern (MOVE_DIAGONAL, MOVE_ROTATE, MOVE_CURVE)
+ * @param power power to apply on the engines (between -Q15_ONE and Q15_ONE)
+ */
+void set_driving_power_q15(LegoCar *car, int movement_type, int power);
+
+
+/**
+ * Drive with the given velocity of the car and rotate at the same time (swerve drive).
+ * Every wheel is steered into the direction of its own velocity and runs at its speed.
+ * A wheel that would have to be turned beyond the steering range (TURNING_INTERVAL) runs
+ * backwards into the opposite direction instead. If a wheel would be faster than full power,
+ * all wheels are slowed down by the same factor.
+ *
+ * @param car the legocar
+ * @param vx velocity forwards (between -1 and 1, 1 = full power)
+ * @param vy velocity to the left (between -1 and 1)
+ * @param omega rotation anti-clockwise (between -1 and 1, 1 = full power on the wheels)
+ */
+void drive(LegoCar *car, float vx, float vy, float omega);
+
+
+/**
+ * Same as 'drive', but with the velocities given in fixed-point format.
+ * Calculated without floating-point operations.
+ *
+ * @param car the legocar
+ * @param vx velocity forwards (between -Q15_ONE and Q15_ONE)
+ * @param vy velocity to the left (between -Q15_ONE and Q15_ONE)
+ * @param omega rotation anti-clockwise (between -Q15_ONE and Q15_ONE)
+ */
+void drive_q15(LegoCar *car, int vx, int vy, int omega);
+
+
+/**
+ * Drive with one of the driving patterns by means of 'drive_q15', this is
+ * 'align_wheels_q15' and 'set_driving_power_q15' in one step. The pattern is kept in the car.
+ * With MOVE_CURVE the inner front wheel is turned by 'direction' and the other wheels are
+ * aligned to the same center of rotation on the lateral axis of the car (Ackermann steering),
+ * so the outer wheels turn less than the inner ones. 'power' is the speed of the center of the car.
+ *
+ * @param car the legocar
+ * @param type the driving pattern (MOVE_DIAGONAL, MOVE_ROTATE, MOVE_CURVE)
+ * @param direction how far the wheels should be turned (between -Q15_ONE and Q15_ONE)
+ * @param power power to apply on the engines (between -Q15_ONE and Q15_ONE)
+ */
+void drive_pattern_q15(LegoCar *car, int type, int direction, int power);
+
+
+/**
+ * Stop all movements of the car immediately, the wheels keep their direction.
  *
  * @param car the legocar
  */
@@ -102,11 +203,23 @@ void enable_wheel_stabilizer(LegoCar *car);
 void disable_stabilizer(LegoCar *car);
 
 
+/**
+ * Advance the wheel stabilization procedure by one tick of the operating system.
+ * In the first tick of every stabilization pass all four wheels are kicked at once,
+ * in the next tick they are restored (see 'kick_wheel' and 'restore_wheel').
+ * Wheels that have been aligned to a different direction in the meantime are not restored.
+ * This function never blocks.
+ *
+ * @param car the legocar
+ */
+void stabilizer_step(LegoCar *car);
+
+
 /**
  * This function is running infinitely, and applies the wheel stabilization procedure
- * by repeatedly calling realign_wheel for all the step engines that control the direction
- * of the wheels, if wheel stabilization has been activated with
- * 'enable_wheel_stabilizer'. Otherwise it will not do anything.
+ * by calling 'stabilizer_step' once per tick of the operating system, if wheel
+ * stabilization has been activated with 'enable_wheel_stabilizer'.
+ * Otherwise it will not do anything.
  * The wheel stabilizer can be switched on and off while the control loop is running.
  * The change will take effect immediately.
  *
@@ -16,22 +16,50 @@
 
 
 void init_pwm_motor(PWM_Motor *pwm_motor, alt_u32 pwm_base_address, unsigned int pwm_period) {
+	int r;
 
-	pwm_motor->enable = (volatile unsigned int *) pwm_base_address;
-	pwm_motor->period = (volatile unsigned int *) pwm_base_address + 1;
-	pwm_motor->duty1  = (volatile unsigned int *) pwm_base_address + 2;
-	pwm_motor->duty2  = (volatile unsigned int *) pwm_base_address + 3;
-	pwm_motor->phase1 = (volatile unsigned int *) pwm_base_address + 4;
-	pwm_motor->phase2 = (volatile unsigned int *) pwm_base_address + 5;
+	pwm_motor->registers = (volatile unsigned int *) pwm_base_address;
+
+	// we do not know the current content of the registers
+	// => all of them have to be written on the first update
+	for(r=0; r<PWM_REG_COUNT; r++)
+		pwm_motor->shadow[r] = 0;
+
+	pwm_motor->dirty = (1 << PWM_REG_COUNT) - 1;
+	pwm_motor->bus_writes = 0;
 
 	pwm_motor->pwm_period = pwm_period;
+	pwm_motor->period_hi  = pwm_period / Q15_ONE;
+	pwm_motor->period_lo  = pwm_period % Q15_ONE;
+
 	pwm_motor->current_power = 0;
 }
 
 
+/**
+ * Write a value to one register of the PWM, unless the register already contains this value.
+ *
+ * @param pwm_motor pointer to the motor structure for the PWM
+ * @param reg index of the register (PWM_REG_*)
+ * @param value the new value for the register
+ */
+static void pwm_write_register(PWM_Motor *pwm_motor, int reg, unsigned int value) {
+
+	if( !(pwm_motor->dirty & (1 << reg)) && pwm_motor->shadow[reg] == value )
+		return;
+
+	pwm_motor->registers[reg] = value;
+
+	pwm_motor->shadow[reg] = value;
+	pwm_motor->dirty &= ~(1 << reg);
+	pwm_motor->bus_writes++;
+}
+
+
 /**
  * Apply the given settings on the PWM for this motor.
  * Method should not be used from outside this file. Control the motor using the set_power method.
+ * Registers that already hold the requested value are not written again.
  *
  * For more details about the PWM ask Hardik ;-)
  *
@@ -43,33 +71,78 @@ void init_pwm_motor(PWM_Motor *pwm_motor, alt_u32 pwm_base_address, unsigned int
  * @param period number of steps in one PWM cycle (defines how precise the engine can be controlled)
  * @param enable the ID of the channel you want to use (use predefined constants BACKWARDS and FORWARDS)
  */
-void pwm_setting(const PWM_Motor *pwm_motor, unsigned long phase1, unsigned long duty1,
-											 unsigned long phase2, unsigned long duty2,
-											 unsigned long period, unsigned long enable) {
-
-	*pwm_motor->enable = enable;
-	*pwm_motor->period = period;
-	*pwm_motor->phase1 = phase1;
-	*pwm_motor->phase2 = phase2;
-	*pwm_motor->duty1  = duty1;
-	*pwm_motor->duty2  = duty2;
+void pwm_setting(PWM_Motor *pwm_motor, unsigned long phase1, unsigned long duty1,
+									   unsigned long phase2, unsigned long duty2,
+									   unsigned long period, unsigned long enable) {
+
+	// only the registers whose values have changed are actually written
+	pwm_write_register(pwm_motor, PWM_REG_ENABLE, enable);
+	pwm_write_register(pwm_motor, PWM_REG_PERIOD, period);
+	pwm_write_register(pwm_motor, PWM_REG_PHASE1, phase1);
+	pwm_write_register(pwm_motor, PWM_REG_PHASE2, phase2);
+	pwm_write_register(pwm_motor, PWM_REG_DUTY1,  duty1);
+	pwm_write_register(pwm_motor, PWM_REG_DUTY2,  duty2);
 }
 
 
 void set_power(PWM_Motor *pwm_motor, float power) {
 	assert(-1 <= power && power <= 1);
 
+	set_power_q15(pwm_motor, FLOAT_TO_Q15(power));
+}
+
+
+void set_power_float(PWM_Motor *pwm_motor, float power) {
+	assert(-1 <= power && power <= 1);
+
 	unsigned int period = pwm_motor->pwm_period;
 
+	// the duty as 'set_power' computed it before the fixed-point path (truncated)
 	if(power > 0)
 		pwm_setting(pwm_motor, PHASE, (int)      ( power*period ), PHASE, (int)      ( power*period ), period, CH_FORWARDS);
 	else
 		pwm_setting(pwm_motor, PHASE, (int) ( (-1)*power*period ), PHASE, (int) ( (-1)*power*period ), period, CH_BACKWARDS);
 
-	pwm_motor->current_power = power;
+	pwm_motor->current_power = FLOAT_TO_Q15(power);
 }
 
 
 float get_power(const PWM_Motor *pwm_motor) {
+	return Q15_TO_FLOAT(pwm_motor->current_power);
+}
+
+
+void set_power_q15(PWM_Motor *pwm_motor, int power) {
+	assert(-Q15_ONE <= power && power <= Q15_ONE);
+
+	unsigned int magnitude = (power > 0) ? power : -power;
+
+	// duty = magnitude * period / Q15_ONE, computed in two parts, so that the
+	// intermediate results stay within 32 bits
+	unsigned int duty = magnitude * pwm_motor->period_hi
+	                  + ( (magnitude * pwm_motor->period_lo) >> 15 );
+
+	unsigned int period = pwm_motor->pwm_period;
+
+	if(power > 0)
+		pwm_setting(pwm_motor, PHASE, duty, PHASE, duty, period, CH_FORWARDS);
+	else
+		pwm_setting(pwm_motor, PHASE, duty, PHASE, duty, period, CH_BACKWARDS);
+
+	pwm_motor->current_power = power;
+}
+
+
+int get_power_q15(const PWM_Motor *pwm_motor) {
 	return pwm_motor->current_power;
 }
+
+
+alt_u32 get_bus_writes(const PWM_Motor *pwm_motor) {
+	return pwm_motor->bus_writes;
+}
+
+
+void reset_bus_writes(PWM_Motor *pwm_motor) {
+	pwm_motor->bus_writes = 0;
+}
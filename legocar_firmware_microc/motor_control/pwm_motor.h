@@ -10,17 +10,48 @@
 
 #include <alt_types.h>
 
+// indices of the registers of the PWM (offsets from the base address in words)
+#define PWM_REG_ENABLE 0
+#define PWM_REG_PERIOD 1
+#define PWM_REG_DUTY1  2
+#define PWM_REG_DUTY2  3
+#define PWM_REG_PHASE1 4
+#define PWM_REG_PHASE2 5
+
+// number of registers of one PWM
+#define PWM_REG_COUNT  6
+
+// fixed-point format (Q15) for powers: Q15_ONE corresponds to 1.0
+// the integer functions (*_q15) do not need any floating point operations
+#define Q15_ONE 32768
+
+// conversion between float and Q15 (rounded to the nearest Q15 value)
+#define FLOAT_TO_Q15(x) ( (int) ((x) * Q15_ONE + ((x) < 0 ? -0.5f : 0.5f)) )
+#define Q15_TO_FLOAT(x) ( (float) (x) / Q15_ONE )
+
 typedef struct PWM_Motor {
-	// bitwise encoded direction: 0x2 => forwards, 0x1 => backwards
-	volatile unsigned int *enable;
-	volatile unsigned int *period;
-	volatile unsigned int *phase1;
-	volatile unsigned int *phase2;
-	volatile unsigned int *duty1;
-	volatile unsigned int *duty2;
+	// base address of the registers of the PWM (see PWM_REG_* for the layout)
+	// the enable register is bitwise encoded: 0x2 => forwards, 0x1 => backwards
+	volatile unsigned int *registers;
+
+	// copy of the values we have last written to the registers
+	// a register is only written to again, if its value changes or if its bit in
+	// 'dirty' is set (e.g. because the register has never been written before)
+	unsigned int shadow[PWM_REG_COUNT];
+	unsigned int dirty;
+
+	// number of writes to the registers of the PWM since the last reset
+	alt_u32 bus_writes;
 
 	unsigned int pwm_period;
-	float current_power;
+
+	// pwm_period split at bit 15: pwm_period = period_hi * Q15_ONE + period_lo
+	// this allows computing power * pwm_period / Q15_ONE without an overflow
+	unsigned int period_hi;
+	unsigned int period_lo;
+
+	// currently applied power in Q15 (between -Q15_ONE and Q15_ONE)
+	int current_power;
 } PWM_Motor;
 
 
@@ -40,6 +71,17 @@ void init_pwm_motor(PWM_Motor *pwm_motor, alt_u32 pwm_base_address, unsigned int
 void set_power(PWM_Motor *pwm_motor, float speed);
 
 
+/**
+ * Same as 'set_power', but the duty is computed with floating point operations, as 'set_power'
+ * did before the fixed-point path. Only a reference for the benchmark and the host tests:
+ * the duty is truncated, so it may differ from 'set_power' by up to period / Q15_ONE + 1 counts.
+ *
+ * @param pwm_motor PWM_Motor structure for the motor
+ * @param power value between -1 and 1 (see 'set_power')
+ */
+void set_power_float(PWM_Motor *pwm_motor, float power);
+
+
 /**
  * Get the power that is currently applied to this motor.
  *
@@ -47,4 +89,40 @@ void set_power(PWM_Motor *pwm_motor, float speed);
  */
 float get_power(const PWM_Motor *pwm_motor);
 
+
+/**
+ * Make the motor move at a specified speed, given in fixed-point format.
+ * Same as 'set_power', but without any floating point operations.
+ *
+ * @param pwm_motor PWM_Motor structure for the motor
+ * @param power value between -Q15_ONE (full power backwards) and Q15_ONE (full power forwards)
+ */
+void set_power_q15(PWM_Motor *pwm_motor, int power);
+
+
+/**
+ * Get the power that is currently applied to this motor in fixed-point format.
+ *
+ * @param pwm_motor the motor
+ * @result value between -Q15_ONE and Q15_ONE (see 'set_power_q15')
+ */
+int get_power_q15(const PWM_Motor *pwm_motor);
+
+
+/**
+ * Get the number of writes to the registers of this PWM since initialization or the last call
+ * of 'reset_bus_writes'.
+ *
+ * @param pwm_motor the motor
+ */
+alt_u32 get_bus_writes(const PWM_Motor *pwm_motor);
+
+
+/**
+ * Reset the counter of the register writes for this PWM.
+ *
+ * @param pwm_motor the motor
+ */
+void reset_bus_writes(PWM_Motor *pwm_motor);
+
 #endif /* PWM_MOTOR_H_ */
@@ -25,13 +25,23 @@ int init_direction(PWM_Motor *direction_motor) {
 
 
 void set_direction(PWM_Motor *direction_motor, float direction) {
-	// apply the necessary power to the step-motor
-	set_power(direction_motor, direction * TURNING_INTERVAL);
+	set_direction_q15(direction_motor, FLOAT_TO_Q15(direction));
 }
 
 
 float get_direction(PWM_Motor *direction_motor) {
-	return get_power(direction_motor) / TURNING_INTERVAL;
+	return Q15_TO_FLOAT(get_direction_q15(direction_motor));
+}
+
+
+void set_direction_q15(PWM_Motor *direction_motor, int direction) {
+	// apply the necessary power to the step-motor
+	set_power_q15(direction_motor, direction * TURNING_INTERVAL_Q15 / Q15_ONE);
+}
+
+
+int get_direction_q15(PWM_Motor *direction_motor) {
+	return get_power_q15(direction_motor) * Q15_ONE / TURNING_INTERVAL_Q15;
 }
 
 
@@ -40,19 +50,32 @@ void realign_wheel(PWM_Motor *direction_motor) {
 	// the wrong position and applies force to realign it.
 	// This way the wheel will stay stable in position.
 
-	// save the correct direction, as we will move the wheel to a different one
-	float hold_direction = get_direction(direction_motor);
+	int hold_power = kick_wheel(direction_motor);
+
+	// wait for one millisecond
+	OSTimeDlyHMSM(0, 0, 0, 1);
+
+	// now realign the wheel
+	restore_wheel(direction_motor, hold_power);
+}
+
+
+int kick_wheel(PWM_Motor *direction_motor) {
+	// save the correct power, as we will move the wheel to a different direction
+	int hold_power = get_power_q15(direction_motor);
 
 	// try to move the wheel to a completely different position for a very short
 	// period of time, that is actually much too small for moving there
-	if(hold_direction <= 0)
-		set_direction(direction_motor, hold_direction + 1);
+	// (the direction is changed by 1 => the power by TURNING_INTERVAL)
+	if(hold_power <= 0)
+		set_power_q15(direction_motor, hold_power + TURNING_INTERVAL_Q15);
 	else
-		set_direction(direction_motor, hold_direction - 1);
+		set_power_q15(direction_motor, hold_power - TURNING_INTERVAL_Q15);
 
-	// wait for one millisecond
-	OSTimeDlyHMSM(0, 0, 0, 1);
+	return hold_power;
+}
 
-	// now realign the wheel
-	set_direction(direction_motor, hold_direction);
+
+void restore_wheel(PWM_Motor *direction_motor, int hold_power) {
+	set_power_q15(direction_motor, hold_power);
 }
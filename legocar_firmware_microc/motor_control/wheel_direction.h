@@ -16,6 +16,9 @@
 // 0.25: on quarter of the range of the step motor
 #define TURNING_INTERVAL 0.4
 
+// TURNING_INTERVAL in fixed-point format (Q15)
+#define TURNING_INTERVAL_Q15 ( (int) (TURNING_INTERVAL * Q15_ONE) )
+
 
 /**
  * Align the wheel straight.
@@ -30,7 +33,7 @@ int init_direction(PWM_Motor *direction_motor);
  * @param direction_motor pointer to the PWM for the step motor that controls the direction
  * @param direction value between -1 and 1: 1 => maximum turn anti-clockwise; -1 => maximum turn clockwise
  */
-int set_direction(PWM_Motor *direction_motor, float direction);
+void set_direction(PWM_Motor *direction_motor, float direction);
 
 /**
  * Get the direction the wheel SHOULD currently have.
@@ -42,6 +45,23 @@ int set_direction(PWM_Motor *direction_motor, float direction);
  */
 float get_direction(PWM_Motor *direction_motor);
 
+/**
+ * Move the wheel to the specified direction, given in fixed-point format.
+ * Same as 'set_direction', but without any floating point operations.
+ *
+ * @param direction_motor pointer to the PWM for the step motor that controls the direction
+ * @param direction value between -Q15_ONE and Q15_ONE: Q15_ONE => maximum turn anti-clockwise; -Q15_ONE => maximum turn clockwise
+ */
+void set_direction_q15(PWM_Motor *direction_motor, int direction);
+
+/**
+ * Get the direction the wheel SHOULD currently have in fixed-point format (see 'get_direction').
+ *
+ * @param direction_motor the address of the PWM for this step motor
+ * @result value between -Q15_ONE and Q15_ONE
+ */
+int get_direction_q15(PWM_Motor *direction_motor);
+
 /**
  * Correct the direction of the wheel in case it has been moved out of the correct position.
  * This function is able to realign the wheel if the step-motor has been forced to a different position.
@@ -52,4 +72,21 @@ float get_direction(PWM_Motor *direction_motor);
  */
 void realign_wheel(PWM_Motor *direction_motor);
 
+/**
+ * First half of 'realign_wheel': move the wheel towards a completely different direction.
+ * The wheel has to be restored with 'restore_wheel' after a very short period of time.
+ *
+ * @param direction_motor the address of the PWM for this step motor
+ * @result the power (Q15) that has to be restored afterwards
+ */
+int kick_wheel(PWM_Motor *direction_motor);
+
+/**
+ * Second half of 'realign_wheel': move the wheel back to the direction it had before 'kick_wheel'.
+ *
+ * @param direction_motor the address of the PWM for this step motor
+ * @param hold_power the value returned by 'kick_wheel'
+ */
+void restore_wheel(PWM_Motor *direction_motor, int hold_power);
+
 #endif /* WHEEL_DIRECTION_H_ */
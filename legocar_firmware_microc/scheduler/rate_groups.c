@@ -0,0 +1,160 @@
+/*
+ * rate_groups.c
+ *
+ *  Created on: 17.10.2026
+ */
+
+#include "rate_groups.h"
+
+// semaphores and critical sections from MicroC-OS
+#include "includes.h"
+
+#include <stddef.h>
+#include <sys/alt_alarm.h>
+
+
+// rates of the groups in Hz
+static const alt_u32 rate_group_rates[RATE_GROUP_COUNT] = { 1000, 100, 10 };
+
+
+typedef struct RateGroup {
+	// the task of the group is waiting for this semaphore
+	OS_EVENT *release;
+	// number of timer ticks from one release to the next
+	alt_u32 ticks_per_period;
+	// total number of releases (including overruns)
+	alt_u32 release_count;
+
+	// 1: the group has been released, but the task did not pick up the release yet
+	int pending;
+	// 1: the task is working on its current period
+	int busy;
+
+	RateGroupStats stats;
+} RateGroup;
+
+
+static RateGroup rate_groups[RATE_GROUP_COUNT];
+
+// the alarm is called from the interrupt of the system timer at every tick
+static alt_alarm rate_group_alarm;
+static alt_u32   rate_group_ticks;
+
+
+/**
+ * Called from the interrupt of the system timer once per tick: releases all the rate groups
+ * whose period has passed.
+ */
+static alt_u32 rate_group_tick(void *context) {
+	int g;
+
+	rate_group_ticks++;
+
+	for(g=0; g<RATE_GROUP_COUNT; g++) {
+		RateGroup *group = &rate_groups[g];
+
+		if(rate_group_ticks % group->ticks_per_period != 0)
+			continue;
+
+		group->release_count++;
+		group->stats.releases++;
+
+		if(group->pending) {
+			// the task did not even start the previous period
+			group->stats.overruns++;
+			continue;
+		}
+
+		if(group->busy)
+			group->stats.deadline_misses++;
+
+		group->pending = 1;
+		OSSemPost(group->release);
+	}
+
+	// call again at the next tick
+	return 1;
+}
+
+
+int init_rate_groups(void) {
+	alt_u32 ticks_per_second = alt_ticks_per_second();
+	int g;
+
+	for(g=0; g<RATE_GROUP_COUNT; g++) {
+		RateGroup *group = &rate_groups[g];
+
+		group->release = OSSemCreate(0);
+		group->ticks_per_period = ticks_per_second / rate_group_rates[g];
+		group->release_count = 0;
+		group->pending = 0;
+		group->busy = 0;
+
+		reset_rate_group_stats(g);
+
+		// the system timer is too slow for this rate
+		if(group->release == NULL || group->ticks_per_period == 0)
+			return 0;
+	}
+
+	rate_group_ticks = 0;
+
+	return alt_alarm_start(&rate_group_alarm, 1, rate_group_tick, NULL) == 0;
+}
+
+
+void wait_for_release(int group) {
+	RateGroup *rg = &rate_groups[group];
+	INT8U err;
+
+#if OS_CRITICAL_METHOD == 3
+	OS_CPU_SR cpu_sr = 0;
+#endif
+
+	// the previous period is finished
+	OS_ENTER_CRITICAL();
+	rg->busy = 0;
+	OS_EXIT_CRITICAL();
+
+	OSSemPend(rg->release, 0, &err);
+
+	// the next period starts
+	OS_ENTER_CRITICAL();
+	rg->pending = 0;
+	rg->busy = 1;
+	OS_EXIT_CRITICAL();
+}
+
+
+double rate_group_period(int group) {
+	return (double) rate_groups[group].ticks_per_period / alt_ticks_per_second();
+}
+
+
+alt_u32 rate_group_releases(int group) {
+	return rate_groups[group].release_count;
+}
+
+
+void get_rate_group_stats(int group, RateGroupStats *stats) {
+#if OS_CRITICAL_METHOD == 3
+	OS_CPU_SR cpu_sr = 0;
+#endif
+
+	OS_ENTER_CRITICAL();
+	*stats = rate_groups[group].stats;
+	OS_EXIT_CRITICAL();
+}
+
+
+void reset_rate_group_stats(int group) {
+#if OS_CRITICAL_METHOD == 3
+	OS_CPU_SR cpu_sr = 0;
+#endif
+
+	OS_ENTER_CRITICAL();
+	rate_groups[group].stats.releases = 0;
+	rate_groups[group].stats.deadline_misses = 0;
+	rate_groups[group].stats.overruns = 0;
+	OS_EXIT_CRITICAL();
+}
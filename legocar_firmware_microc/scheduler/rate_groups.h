@@ -0,0 +1,94 @@
+/*
+ * rate_groups.h
+ *
+ * Fixed-rate executive: tasks are released at exact rates by the interrupt of the
+ * system timer instead of pacing themselves with relative delays.
+ *
+ *  Created on: 17.10.2026
+ */
+
+#ifndef RATE_GROUPS_H_
+#define RATE_GROUPS_H_
+
+#include <alt_types.h>
+
+// indices of the rate groups
+#define RATE_GROUP_1KHZ  0
+#define RATE_GROUP_100HZ 1
+#define RATE_GROUP_10HZ  2
+
+// number of rate groups
+#define RATE_GROUP_COUNT 3
+
+
+/**
+ * Statistics of one rate group
+ */
+typedef struct RateGroupStats {
+	// number of times the group has been released
+	alt_u32 releases;
+	// number of releases when the task of the group had not finished its previous period yet
+	alt_u32 deadline_misses;
+	// number of releases that have been dropped, because the previous one had not even been
+	// picked up by the task
+	alt_u32 overruns;
+} RateGroupStats;
+
+
+/**
+ * Create the semaphores for the rate groups and start releasing them from the interrupt
+ * of the system timer.
+ * Has to be called after OSInit.
+ *
+ * @result 1: success, 0: the system timer cannot be used for releasing the rate groups
+ */
+int init_rate_groups(void);
+
+
+/**
+ * Wait until the rate group is released the next time.
+ * A task of a rate group has to call this function at the beginning of every period.
+ * Calling this function also marks the end of the previous period of the task.
+ *
+ * @param group index of the rate group (RATE_GROUP_*)
+ */
+void wait_for_release(int group);
+
+
+/**
+ * Get the period of a rate group.
+ *
+ * @param group index of the rate group (RATE_GROUP_*)
+ * @result period in seconds
+ */
+double rate_group_period(int group);
+
+
+/**
+ * Get the number of releases of a rate group since the start of the system.
+ * Releases that have been dropped (overruns) are counted as well, so the difference of two
+ * values multiplied with the period of the group is the time that has passed in between.
+ *
+ * @param group index of the rate group (RATE_GROUP_*)
+ */
+alt_u32 rate_group_releases(int group);
+
+
+/**
+ * Get the statistics of a rate group.
+ *
+ * @param group index of the rate group (RATE_GROUP_*)
+ * @param stats the statistics are copied to this structure
+ */
+void get_rate_group_stats(int group, RateGroupStats *stats);
+
+
+/**
+ * Reset the statistics of a rate group.
+ *
+ * @param group index of the rate group (RATE_GROUP_*)
+ */
+void reset_rate_group_stats(int group);
+
+
+#endif /* RATE_GROUPS_H_ */
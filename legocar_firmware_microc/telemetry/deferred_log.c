@@ -0,0 +1,228 @@
+/*
+ * deferred_log.c
+ *
+ *  Created on: 17.10.2026
+ */
+
+#include "deferred_log.h"
+
+// tasks and critical sections from MicroC-OS
+#include "includes.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "../terasic_lib/terasic_includes.h"
+
+
+typedef struct DeferredLogEntry {
+	const char *format;
+	alt_u32 timestamp;          // system time when the message has been added (alt_nticks)
+	alt_32  args[DEFERRED_LOG_MAX_ARGS];
+	// set when the entry has been filled completely, cleared by the output task
+	alt_u8  ready;
+} DeferredLogEntry;
+
+typedef struct DeferredLog {
+	// the entries are filled outside of the critical section, so they are volatile
+	volatile DeferredLogEntry entries[DEFERRED_LOG_SIZE];
+	// number of entries taken by 'log_message' and printed by the output task (not wrapped)
+	volatile alt_u32 in;
+	volatile alt_u32 out;
+
+	DeferredLogStats stats;
+} DeferredLog;
+
+
+static DeferredLog deferred;
+
+static OS_STK deferred_log_stk[DEFERRED_LOG_STACKSIZE];
+
+
+/**
+ * Format a fixed-point value in Q15 with four decimals.
+ */
+static int format_q15(char *line, int size, alt_32 value) {
+	alt_u32 magnitude = (value < 0) ? -(alt_u32) value : (alt_u32) value;
+	alt_u32 integer = magnitude >> 15;
+	// rounded to four decimals, 0x7FFF * 10000 fits into 32 bits
+	alt_u32 fraction = ((magnitude & 0x7FFF) * 10000 + 0x4000) >> 15;
+
+	if(fraction >= 10000) {
+		integer++;
+		fraction -= 10000;
+	}
+
+	// no sign for values that are rounded to zero
+	return snprintf(line, size, "%s%lu.%04lu", (value < 0 && (integer || fraction)) ? "-" : "",
+	                (unsigned long) integer, (unsigned long) fraction);
+}
+
+int format_log_message(char *line, int size, const char *format, const alt_32 args[DEFERRED_LOG_MAX_ARGS]) {
+	char spec[12];
+	int length = 0, arg = 0, s, n;
+	alt_32 value;
+
+	if(size <= 0)
+		return 0;
+
+	while(*format && length < size - 1) {
+		if(*format != '%') {
+			line[length++] = *format++;
+			continue;
+		}
+
+		// flags and width of the conversion
+		s = 0;
+		spec[s++] = *format++;
+		while(*format && strchr("-+ #0123456789", *format) && s < (int) sizeof(spec) - 2)
+			spec[s++] = *format++;
+
+		if(*format == '\0')
+			break;
+
+		if(*format == '%') {
+			line[length++] = '%';
+			format++;
+			continue;
+		}
+
+		value = (arg < DEFERRED_LOG_MAX_ARGS) ? args[arg++] : 0;
+
+		if(*format == 'q') {
+			n = format_q15(line + length, size - length, value);
+		}
+		else if(strchr("diuxXc", *format)) {
+			spec[s++] = *format;
+			spec[s] = '\0';
+			n = snprintf(line + length, size - length, spec, value);
+		}
+		else {
+			// not supported (e.g. %s or %f): the argument is skipped
+			n = 0;
+		}
+		format++;
+
+		if(n > 0)
+			length += n;
+		if(length > size - 1)
+			length = size - 1;
+	}
+
+	line[length] = '\0';
+	return length;
+}
+
+int log_message(const char *format, alt_32 a, alt_32 b, alt_32 c, alt_32 d) {
+	volatile DeferredLogEntry *entry;
+	alt_u32 fill;
+#if OS_CRITICAL_METHOD == 3
+	OS_CPU_SR cpu_sr = 0;
+#endif
+
+	// take the next entry, it is filled outside of the critical section
+	OS_ENTER_CRITICAL();
+
+	fill = deferred.in - deferred.out;
+	if(fill >= DEFERRED_LOG_SIZE) {
+		deferred.stats.dropped++;
+		OS_EXIT_CRITICAL();
+		return 0;
+	}
+
+	entry = &deferred.entries[deferred.in % DEFERRED_LOG_SIZE];
+	deferred.in++;
+
+	deferred.stats.messages++;
+	if(fill + 1 > deferred.stats.max_buffered)
+		deferred.stats.max_buffered = fill + 1;
+
+	OS_EXIT_CRITICAL();
+
+	entry->format    = format;
+	entry->timestamp = alt_nticks();
+	entry->args[0]   = a;
+	entry->args[1]   = b;
+	entry->args[2]   = c;
+	entry->args[3]   = d;
+	// the output task may take the entry now
+	entry->ready     = 1;
+
+	return 1;
+}
+
+/**
+ * Take the oldest message from the buffer.
+ * A message whose task has been preempted while filling it holds back the newer ones.
+ *
+ * @result 1: success, 0: there is no complete message
+ */
+static int next_message(DeferredLogEntry *message) {
+	volatile DeferredLogEntry *entry = &deferred.entries[deferred.out % DEFERRED_LOG_SIZE];
+	int i;
+
+	if(deferred.out == deferred.in || !entry->ready)
+		return 0;
+
+	message->format    = entry->format;
+	message->timestamp = entry->timestamp;
+	for(i=0; i<DEFERRED_LOG_MAX_ARGS; i++)
+		message->args[i] = entry->args[i];
+
+	// only this task frees entries, so no critical section is needed
+	entry->ready = 0;
+	deferred.out++;
+
+	return 1;
+}
+
+/**
+ * Print the messages, and the number of messages that have been dropped.
+ */
+static void deferred_log_task(void *data) {
+	DeferredLogEntry message;
+	char line[DEFERRED_LOG_LINE];
+	alt_u32 reported = 0, dropped;
+
+	while(1) {
+		while(next_message(&message)) {
+			format_log_message(line, sizeof(line), message.format, message.args);
+			printf("[%lu] %s", (unsigned long) message.timestamp, line);
+			deferred.stats.printed++;
+		}
+
+		dropped = deferred.stats.dropped;
+		if(dropped != reported) {
+			printf("log: %lu messages dropped\n", (unsigned long) (dropped - reported));
+			reported = dropped;
+		}
+
+		OSTimeDly(1);
+	}
+}
+
+int start_deferred_log(int priority) {
+	INT8U err;
+
+	err = OSTaskCreateExt(deferred_log_task,
+	                      NULL,
+	                      (void *) &deferred_log_stk[DEFERRED_LOG_STACKSIZE-1],
+	                      priority,
+	                      priority,
+	                      deferred_log_stk,
+	                      DEFERRED_LOG_STACKSIZE,
+	                      NULL,
+	                      0);
+
+	return err == OS_NO_ERR;
+}
+
+void get_deferred_log_stats(DeferredLogStats *stats) {
+#if OS_CRITICAL_METHOD == 3
+	OS_CPU_SR cpu_sr = 0;
+#endif
+
+	OS_ENTER_CRITICAL();
+	*stats = deferred.stats;
+	OS_EXIT_CRITICAL();
+}
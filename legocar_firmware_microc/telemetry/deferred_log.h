@@ -0,0 +1,102 @@
+/*
+ * deferred_log.h
+ *
+ * Diagnostic messages of the real-time tasks, which are formatted and printed later by a
+ * task with the lowest priority instead of calling printf in the task that hit them.
+ *
+ * A message only consists of a pointer to its format string, the system time and up to
+ * four 32 bit arguments, which are copied to a ring buffer in constant time. The format
+ * string therefore has to be a string literal (or live forever). The output task formats the
+ * messages with the conversions %d, %i, %u, %x, %X, %c (with flags and width), and %q for
+ * fixed-point values in Q15 (e.g. the powers of the engines). If the buffer is full, the
+ * message is dropped and counted; the output task reports the number of dropped messages.
+ *
+ *  Created on: 17.10.2026
+ */
+
+#ifndef DEFERRED_LOG_H_
+#define DEFERRED_LOG_H_
+
+#include <alt_types.h>
+
+//! number of messages in the buffer (power of two)
+#define DEFERRED_LOG_SIZE       128
+//! maximum number of arguments of a message
+#define DEFERRED_LOG_MAX_ARGS   4
+//! maximum length of a formatted message (longer ones are cut)
+#define DEFERRED_LOG_LINE       160
+
+#define DEFERRED_LOG_STACKSIZE  1024
+
+
+/**
+ * Add a message with up to four integer arguments to the log, e.g.
+ *   deferred_log("wheel %d: power %q\n", w, power);
+ */
+#define deferred_log(...) deferred_log_args(__VA_ARGS__, 0, 0, 0, 0, 0)
+#define deferred_log_args(format, a, b, c, d, ...) \
+	log_message((format), (alt_32) (a), (alt_32) (b), (alt_32) (c), (alt_32) (d))
+
+
+/**
+ * Statistics of the log
+ */
+typedef struct DeferredLogStats {
+	alt_u32 messages;       // messages added to the buffer
+	alt_u32 dropped;        // messages dropped, because the buffer was full
+	alt_u32 printed;        // messages printed by the output task
+	alt_u32 max_buffered;   // maximum number of messages in the buffer
+} DeferredLogStats;
+
+
+/**
+ * Add a message to the log (use the macro 'deferred_log').
+ * Only the arguments are copied, so this function never blocks and can be called from any
+ * task and from interrupts.
+ *
+ * @param format the format string (has to stay valid until the message has been printed)
+ * @param a first argument
+ * @param b second argument
+ * @param c third argument
+ * @param d fourth argument
+ *
+ * @result 1: success, 0: the buffer is full, the message has been dropped
+ */
+int  log_message(const char *format, alt_32 a, alt_32 b, alt_32 c, alt_32 d);
+
+
+/**
+ * Create the output task, which formats the messages and prints them to stdout.
+ * Messages added before are printed as soon as the task runs.
+ * Has to be called after OSInit.
+ *
+ * @param priority priority of the output task (should be lower than the ones of all the
+ *                 other tasks)
+ *
+ * @result 1: success, 0: the task cannot be created
+ */
+int  start_deferred_log(int priority);
+
+
+/**
+ * Format a message like the output task does.
+ *
+ * @param line buffer for the formatted message
+ * @param size size of the buffer (bytes)
+ * @param format the format string
+ * @param args the arguments (DEFERRED_LOG_MAX_ARGS)
+ *
+ * @result length of the formatted message
+ */
+int  format_log_message(char *line, int size, const char *format, const alt_32 args[DEFERRED_LOG_MAX_ARGS]);
+
+
+/**
+ * Get the statistics of the log.
+ *
+ * @param stats the statistics are copied to this structure
+ */
+void get_deferred_log_stats(DeferredLogStats *stats);
+
+
+#endif /* DEFERRED_LOG_H_ */
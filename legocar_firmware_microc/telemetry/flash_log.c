@@ -0,0 +1,611 @@
+/*
+ * flash_log.c
+ *
+ *  Created on: 17.10.2026
+ */
+
+#include "flash_log.h"
+
+// semaphores and critical sections from MicroC-OS
+#include "includes.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "../common/crc32.h"
+#include "../terasic_lib/terasic_includes.h"
+#include "../terasic_lib/flash.h"
+// the log is placed in front of the block of the calibration
+#include "../acceleration_sensor/ins_storage.h"
+
+
+// erase count of a block without a valid header
+#define ERASE_COUNT_UNKNOWN 0xFFFFFFFF
+
+
+typedef struct FlashLog {
+	FLASH_HANDLE flash;
+	alt_u16 first_block;        // first block of the flash that belongs to the log
+
+	// the block that is written (or has been written last)
+	alt_u16 head;
+	int     head_open;          // 1: the header of the block has been written, records can be appended
+	alt_u32 head_end;           // end of the block in the flash
+	alt_u32 sequence;           // sequence number of the block
+	// 1: the block after the head block has been erased in advance
+	int     spare_erased;
+
+	alt_u32 erase_counts[FLASH_LOG_BLOCKS];
+
+	// records waiting for the writer task (the positions are not wrapped)
+	alt_u8  buffer[FLASH_LOG_BUFFER_SIZE];
+	volatile alt_u32 buffer_in;
+	volatile alt_u32 buffer_out;
+
+	// records taken from the buffer that have not been written yet
+	alt_u8  page[2*FLASH_LOG_PAGE_SIZE];
+	alt_u32 page_fill;
+	alt_u32 page_offset;        // offset of the first byte of the page buffer in the flash
+	alt_u32 page_since;         // system time when the page buffer has been filled first
+
+	// mutex held by the writer task during every access to the flash
+	OS_EVENT *lock;
+
+	// job queued by another task (see 'queue_flash_job')
+	FlashLogJob job;
+	void   *job_context;
+	volatile int job_pending;
+
+	FlashLogStats stats;
+} FlashLog;
+
+
+static FlashLog flash_log;
+
+static OS_STK flash_log_writer_stk[FLASH_LOG_WRITER_STACKSIZE];
+
+
+/**
+ * The CRC of a block header covers all the members in front of the CRC.
+ */
+static alt_u32 block_header_crc(const FlashLogBlockHeader *header) {
+	return crc32(header, offsetof(FlashLogBlockHeader, crc));
+}
+
+/**
+ * The CRC of a record covers the members of the header in front of the CRC and the payload.
+ */
+static alt_u32 record_crc(const FlashLogRecordHeader *record, const void *payload) {
+	alt_u32 crc = crc32_update(CRC32_INIT, record, offsetof(FlashLogRecordHeader, crc));
+	return crc32_final(crc32_update(crc, payload, record->length));
+}
+
+/**
+ * Copy data from the buffer, wrapping around at its end.
+ */
+static void buffer_read(alt_u32 position, void *data, alt_u32 size) {
+	alt_u32 start = position % FLASH_LOG_BUFFER_SIZE;
+	alt_u32 first = FLASH_LOG_BUFFER_SIZE - start;
+
+	if(first > size)
+		first = size;
+
+	memcpy(data, &flash_log.buffer[start], first);
+	memcpy((alt_u8 *) data + first, flash_log.buffer, size - first);
+}
+
+/**
+ * Copy data to the buffer, wrapping around at its end.
+ */
+static void buffer_write(alt_u32 position, const void *data, alt_u32 size) {
+	alt_u32 start = position % FLASH_LOG_BUFFER_SIZE;
+	alt_u32 first = FLASH_LOG_BUFFER_SIZE - start;
+
+	if(first > size)
+		first = size;
+
+	memcpy(&flash_log.buffer[start], data, first);
+	memcpy(flash_log.buffer, (const alt_u8 *) data + first, size - first);
+}
+
+/**
+ * Get the position of a block of the log in the flash.
+ */
+static int block_location(alt_u16 block, alt_u32 *offset, alt_u32 *end) {
+	alt_32 start, size;
+
+	if(!Flash_GetBlockInfo(flash_log.flash, flash_log.first_block + block, &start, &size))
+		return 0;
+
+	*offset = start;
+	*end    = start + size;
+	return 1;
+}
+
+/**
+ * Read the header of a block.
+ *
+ * @result 1: the header is valid, 0: the block is erased or has not been written completely
+ */
+static int read_block_header(alt_u16 block, FlashLogBlockHeader *header) {
+	alt_u32 offset, end;
+
+	if(!block_location(block, &offset, &end)
+	   || !Flash_Read(flash_log.flash, offset, (alt_u8 *) header, sizeof(FlashLogBlockHeader)))
+		return 0;
+
+	return header->magic == FLASH_LOG_BLOCK_MAGIC && header->version == FLASH_LOG_VERSION
+	       && header->crc == block_header_crc(header);
+}
+
+/**
+ * Read a record from the flash.
+ *
+ * @result 1: the record is valid, 0: the end of the records in the block has been reached
+ */
+static int read_record(alt_u32 offset, alt_u32 end, FlashLogRecordHeader *record, void *payload) {
+	if(offset + sizeof(FlashLogRecordHeader) > end
+	   || !Flash_Read(flash_log.flash, offset, (alt_u8 *) record, sizeof(FlashLogRecordHeader)))
+		return 0;
+
+	if(record->magic != FLASH_LOG_RECORD_MAGIC || record->length > FLASH_LOG_MAX_PAYLOAD)
+		return 0;
+
+	offset += sizeof(FlashLogRecordHeader);
+	if(offset + record->length > end)
+		return 0;
+
+	if(record->length > 0 && !Flash_Read(flash_log.flash, offset, payload, record->length))
+		return 0;
+
+	return record->crc == record_crc(record, payload);
+}
+
+/**
+ * Check whether a part of the flash is erased completely, so that it can be written.
+ */
+static int is_erased(alt_u32 offset, alt_u32 end) {
+	alt_u32 size, i;
+
+	while(offset < end) {
+		size = end - offset;
+		if(size > sizeof(flash_log.page))
+			size = sizeof(flash_log.page);
+
+		if(!Flash_Read(flash_log.flash, offset, flash_log.page, size))
+			return 0;
+
+		for(i=0; i<size; i++) {
+			if(flash_log.page[i] != 0xFF)
+				return 0;
+		}
+
+		offset += size;
+	}
+
+	return 1;
+}
+
+/**
+ * Find the newest and the oldest block of the log by their sequence numbers.
+ * The erase counts of all valid blocks are taken over.
+ *
+ * @result number of valid blocks
+ */
+static int scan_blocks(alt_u16 *newest, alt_u32 *newest_sequence, alt_u16 *oldest, alt_u32 *oldest_sequence) {
+	FlashLogBlockHeader header;
+	int valid = 0;
+	alt_u16 b;
+
+	for(b=0; b<FLASH_LOG_BLOCKS; b++) {
+		if(!read_block_header(b, &header))
+			continue;
+
+		flash_log.erase_counts[b] = header.erase_count;
+
+		if(valid == 0 || header.sequence > *newest_sequence) {
+			*newest = b;
+			*newest_sequence = header.sequence;
+		}
+		if(valid == 0 || header.sequence < *oldest_sequence) {
+			*oldest = b;
+			*oldest_sequence = header.sequence;
+		}
+
+		valid++;
+	}
+
+	return valid;
+}
+
+/**
+ * Erase a block of the log.
+ */
+static int erase_block(alt_u16 block) {
+	int success;
+
+	lock_flash_log();
+	success = Flash_Erase(flash_log.flash, flash_log.first_block + block);
+	unlock_flash_log();
+
+	flash_log.erase_counts[block]++;
+
+	if(success)
+		flash_log.stats.erases++;
+	else
+		flash_log.stats.errors++;
+
+	return success;
+}
+
+/**
+ * Start writing the block after the head block: erase it (if that has not been done in advance)
+ * and write its header. If this fails, the block is skipped.
+ */
+static int open_next_block(void) {
+	FlashLogBlockHeader header;
+	alt_u16 block = (flash_log.head + 1) % FLASH_LOG_BLOCKS;
+	alt_u32 offset, end;
+	int success;
+
+	flash_log.head      = block;
+	flash_log.head_open = 0;
+
+	if(!flash_log.spare_erased && !erase_block(block))
+		return 0;
+	flash_log.spare_erased = 0;
+
+	if(!block_location(block, &offset, &end))
+		return 0;
+
+	header.magic       = FLASH_LOG_BLOCK_MAGIC;
+	header.version     = FLASH_LOG_VERSION;
+	header.sequence    = flash_log.sequence + 1;
+	header.erase_count = flash_log.erase_counts[block];
+	header.crc         = block_header_crc(&header);
+
+	lock_flash_log();
+	success = Flash_Write(flash_log.flash, offset, (alt_u8 *) &header, sizeof(header));
+	unlock_flash_log();
+
+	if(!success) {
+		flash_log.stats.errors++;
+		return 0;
+	}
+
+	flash_log.sequence       = header.sequence;
+	flash_log.stats.sequence = header.sequence;
+	flash_log.head_end       = end;
+	flash_log.page_offset    = offset + sizeof(header);
+	flash_log.head_open      = 1;
+	return 1;
+}
+
+/**
+ * Write the page buffer to the flash, as far as it fills pages of the flash completely.
+ *
+ * @param all 1: write the last page as well, even if it is not full
+ *
+ * @result 1: success, 0: the flash could not be written (the content of the page buffer is lost)
+ */
+static int write_pages(int all) {
+	alt_u32 size;
+	int success;
+
+	while(flash_log.page_fill > 0) {
+		size = FLASH_LOG_PAGE_SIZE - flash_log.page_offset % FLASH_LOG_PAGE_SIZE;
+		if(size > flash_log.page_fill) {
+			if(!all)
+				break;
+			size = flash_log.page_fill;
+		}
+
+		lock_flash_log();
+		success = Flash_Write(flash_log.flash, flash_log.page_offset, flash_log.page, size);
+		unlock_flash_log();
+
+		if(!success) {
+			// continue in the next block
+			flash_log.stats.errors++;
+			flash_log.head_open = 0;
+			flash_log.page_fill = 0;
+			return 0;
+		}
+
+		flash_log.stats.bytes += size;
+		flash_log.page_offset += size;
+		flash_log.page_fill   -= size;
+		memmove(flash_log.page, flash_log.page + size, flash_log.page_fill);
+	}
+
+	return 1;
+}
+
+/**
+ * Move the records from the buffer to the page buffer and write all its full pages.
+ * A record is never split between two blocks.
+ */
+static void move_records(void) {
+	FlashLogRecordHeader record;
+	alt_u8 *copy;
+	alt_u32 size;
+
+	while(flash_log.buffer_out != flash_log.buffer_in) {
+		buffer_read(flash_log.buffer_out, &record, sizeof(record));
+		size = sizeof(record) + record.length;
+
+		// start the next block if the record does not fit into this one anymore
+		if(!flash_log.head_open || flash_log.page_offset + flash_log.page_fill + size > flash_log.head_end) {
+			write_pages(1);
+			if(!open_next_block())
+				return;
+		}
+
+		// the CRC is calculated here, so that adding a record is only a copy
+		copy = flash_log.page + flash_log.page_fill;
+		buffer_read(flash_log.buffer_out, copy, size);
+		record.crc = record_crc(&record, copy + sizeof(record));
+		memcpy(copy + offsetof(FlashLogRecordHeader, crc), &record.crc, sizeof(record.crc));
+
+		if(flash_log.page_fill == 0)
+			flash_log.page_since = alt_nticks();
+		flash_log.page_fill += size;
+
+		// only the writer task moves the end of the buffer
+		flash_log.buffer_out += size;
+		flash_log.stats.written++;
+
+		write_pages(0);
+	}
+
+	// records that do not fill a page are not kept in the RAM for long
+	if(flash_log.page_fill > 0 && alt_nticks() - flash_log.page_since >= FLASH_LOG_FLUSH_TICKS)
+		write_pages(1);
+}
+
+/**
+ * Task that moves the records to the flash and erases the blocks in advance.
+ */
+static void flash_log_writer_task(void *pdata) {
+
+	while(1) {
+		move_records();
+
+		if(flash_log.job_pending) {
+			lock_flash_log();
+			flash_log.job(flash_log.job_context);
+			unlock_flash_log();
+
+			flash_log.job_pending = 0;
+		}
+
+		// the records are collected in the buffer while the next block is erased
+		if(flash_log.head_open && !flash_log.spare_erased)
+			flash_log.spare_erased = erase_block((flash_log.head + 1) % FLASH_LOG_BLOCKS);
+
+		OSTimeDly(1);
+	}
+
+}
+
+int init_flash_log(char *flash_name) {
+	FlashLogRecordHeader record;
+	alt_u8 payload[FLASH_LOG_MAX_PAYLOAD];
+	alt_u16 blocks, oldest, b;
+	alt_u32 oldest_sequence, offset, end, max_erase_count;
+
+	memset(&flash_log, 0, sizeof(flash_log));
+	for(b=0; b<FLASH_LOG_BLOCKS; b++)
+		flash_log.erase_counts[b] = ERASE_COUNT_UNKNOWN;
+
+	flash_log.flash = Flash_Open(flash_name);
+	if(!flash_log.flash)
+		return 0;
+
+	blocks = Flash_GetBlockCount(flash_log.flash);
+	if(blocks < INS_CALIBRATION_BLOCK + FLASH_LOG_BLOCKS) {
+		Flash_Close(flash_log.flash);
+		flash_log.flash = NULL;
+		return 0;
+	}
+	flash_log.first_block = blocks - INS_CALIBRATION_BLOCK - FLASH_LOG_BLOCKS;
+
+	if(scan_blocks(&flash_log.head, &flash_log.sequence, &oldest, &oldest_sequence) == 0) {
+		// empty log: start with the first block
+		flash_log.head     = FLASH_LOG_BLOCKS - 1;
+		flash_log.sequence = 0;
+	}
+	else if(block_location(flash_log.head, &offset, &end)) {
+		// append behind the last valid record of the newest block
+		offset += sizeof(FlashLogBlockHeader);
+		while(read_record(offset, end, &record, payload))
+			offset += sizeof(record) + record.length;
+
+		flash_log.head_end    = end;
+		flash_log.page_offset = offset;
+		flash_log.head_open   = is_erased(offset, end);
+	}
+
+	// blocks without a header (e.g. erased in advance) have been erased about as often as the others
+	max_erase_count = 0;
+	for(b=0; b<FLASH_LOG_BLOCKS; b++) {
+		if(flash_log.erase_counts[b] != ERASE_COUNT_UNKNOWN && flash_log.erase_counts[b] > max_erase_count)
+			max_erase_count = flash_log.erase_counts[b];
+	}
+	for(b=0; b<FLASH_LOG_BLOCKS; b++) {
+		if(flash_log.erase_counts[b] == ERASE_COUNT_UNKNOWN)
+			flash_log.erase_counts[b] = max_erase_count;
+	}
+
+	// the erase of the next block may have been interrupted, so it is only used if it is erased completely
+	flash_log.spare_erased = block_location((flash_log.head + 1) % FLASH_LOG_BLOCKS, &offset, &end)
+	                         && is_erased(offset, end);
+	flash_log.stats.sequence = flash_log.sequence;
+
+	log_record(FLASH_LOG_SESSION, NULL, 0);
+	return 1;
+}
+
+int start_flash_log_writer(int priority, int lock_priority) {
+	INT8U err;
+
+	if(!flash_log.flash)
+		return 0;
+
+	// a task holding the lock inherits lock_priority, so a medium-priority task cannot keep it waiting
+	flash_log.lock = OSMutexCreate(lock_priority, &err);
+	if(err != OS_NO_ERR)
+		return 0;
+
+	err = OSTaskCreateExt(flash_log_writer_task,
+	                      NULL,
+	                      (void *) &flash_log_writer_stk[FLASH_LOG_WRITER_STACKSIZE-1],
+	                      priority,
+	                      priority,
+	                      flash_log_writer_stk,
+	                      FLASH_LOG_WRITER_STACKSIZE,
+	                      NULL,
+	                      0);
+
+	return err == OS_NO_ERR;
+}
+
+int log_record(alt_u8 type, const void *data, alt_u8 length) {
+	FlashLogRecordHeader record;
+	alt_u32 size = sizeof(record) + length;
+	alt_u32 fill;
+	int success = 0;
+#if OS_CRITICAL_METHOD == 3
+	OS_CPU_SR cpu_sr = 0;
+#endif
+
+	if(length > FLASH_LOG_MAX_PAYLOAD)
+		return 0;
+
+	record.magic     = FLASH_LOG_RECORD_MAGIC;
+	record.type      = type;
+	record.length    = length;
+	record.timestamp = alt_nticks();
+	// calculated by the writer task
+	record.crc       = 0;
+
+	OS_ENTER_CRITICAL();
+
+	fill = flash_log.buffer_in - flash_log.buffer_out;
+	if(fill + size <= FLASH_LOG_BUFFER_SIZE) {
+		buffer_write(flash_log.buffer_in, &record, sizeof(record));
+		buffer_write(flash_log.buffer_in + sizeof(record), data, length);
+		flash_log.buffer_in += size;
+
+		flash_log.stats.records++;
+		if(fill + size > flash_log.stats.max_buffered)
+			flash_log.stats.max_buffered = fill + size;
+		success = 1;
+	}
+	else {
+		flash_log.stats.dropped++;
+	}
+
+	OS_EXIT_CRITICAL();
+
+	return success;
+}
+
+int queue_flash_job(FlashLogJob job, void *context) {
+	int success = 0;
+#if OS_CRITICAL_METHOD == 3
+	OS_CPU_SR cpu_sr = 0;
+#endif
+
+	OS_ENTER_CRITICAL();
+
+	if(flash_log.lock && !flash_log.job_pending) {
+		flash_log.job         = job;
+		flash_log.job_context = context;
+		flash_log.job_pending = 1;
+		success = 1;
+	}
+
+	OS_EXIT_CRITICAL();
+
+	return success;
+}
+
+void lock_flash_log(void) {
+	INT8U err;
+
+	if(flash_log.lock)
+		OSMutexPend(flash_log.lock, 0, &err);
+}
+
+void unlock_flash_log(void) {
+	if(flash_log.lock)
+		OSMutexPost(flash_log.lock);
+}
+
+void get_flash_log_stats(FlashLogStats *stats) {
+	int b;
+#if OS_CRITICAL_METHOD == 3
+	OS_CPU_SR cpu_sr = 0;
+#endif
+
+	OS_ENTER_CRITICAL();
+	*stats = flash_log.stats;
+	OS_EXIT_CRITICAL();
+
+	stats->min_erase_count = flash_log.erase_counts[0];
+	stats->max_erase_count = flash_log.erase_counts[0];
+	for(b=1; b<FLASH_LOG_BLOCKS; b++) {
+		if(flash_log.erase_counts[b] < stats->min_erase_count)
+			stats->min_erase_count = flash_log.erase_counts[b];
+		if(flash_log.erase_counts[b] > stats->max_erase_count)
+			stats->max_erase_count = flash_log.erase_counts[b];
+	}
+}
+
+/**
+ * Move a cursor to the first record of a block.
+ */
+static int set_cursor(FlashLogCursor *cursor, alt_u16 block, alt_u32 sequence) {
+	alt_u32 offset, end;
+
+	if(!block_location(block, &offset, &end))
+		return 0;
+
+	cursor->block    = block;
+	cursor->sequence = sequence;
+	cursor->offset   = offset + sizeof(FlashLogBlockHeader);
+	cursor->end      = end;
+	return 1;
+}
+
+int first_log_record(FlashLogCursor *cursor) {
+	alt_u16 newest, oldest;
+	alt_u32 newest_sequence, oldest_sequence;
+
+	if(!flash_log.flash || scan_blocks(&newest, &newest_sequence, &oldest, &oldest_sequence) == 0)
+		return 0;
+
+	cursor->blocks_left = FLASH_LOG_BLOCKS - 1;
+	return set_cursor(cursor, oldest, oldest_sequence);
+}
+
+int next_log_record(FlashLogCursor *cursor, FlashLogRecordHeader *record, void *payload) {
+	FlashLogBlockHeader header;
+
+	while(!read_record(cursor->offset, cursor->end, record, payload)) {
+		// the next block has the next sequence number, blocks that could not be written are skipped
+		do {
+			if(cursor->blocks_left == 0)
+				return 0;
+			cursor->blocks_left--;
+			cursor->block = (cursor->block + 1) % FLASH_LOG_BLOCKS;
+		} while(!read_block_header(cursor->block, &header));
+
+		if(header.sequence != cursor->sequence + 1 || !set_cursor(cursor, cursor->block, header.sequence))
+			return 0;
+	}
+
+	cursor->offset += sizeof(FlashLogRecordHeader) + record->length;
+	return 1;
+}
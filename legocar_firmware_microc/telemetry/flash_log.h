@@ -0,0 +1,239 @@
+/*
+ * flash_log.h
+ *
+ * Append-only log of telemetry records (motor commands, state of the INS, faults) in the
+ * EPCS flash, so that drive sessions can be analysed afterwards.
+ *
+ * The log occupies FLASH_LOG_BLOCKS blocks right in front of the block of the INS calibration
+ * and uses them as a ring: the blocks are always written in the same order, so all of them are
+ * erased equally often (wear leveling). Every block starts with a header holding a sequence
+ * number that is incremented for every block that is started, and the records are appended
+ * behind it. At boot, the newest and the oldest block are found by scanning the headers of all
+ * the blocks, and the position to append at by scanning the records of the newest block.
+ *
+ * Tasks add records with 'log_record', which only copies the record to a buffer in the RAM and
+ * never blocks. A writer task with a low priority moves the records from the buffer to the flash
+ * page by page and erases the block following the one it is writing in advance (erase-ahead).
+ * Erasing a block of the EPCS takes about 1 s, in which the records are only collected in the
+ * buffer, so the buffer has to be large enough for the records of that time.
+ *
+ *  Created on: 17.10.2026
+ */
+
+#ifndef FLASH_LOG_H_
+#define FLASH_LOG_H_
+
+#include <alt_types.h>
+
+//! "TLOG"
+#define FLASH_LOG_BLOCK_MAGIC  0x544C4F47
+//! "LR"
+#define FLASH_LOG_RECORD_MAGIC 0x4C52
+//! increment whenever the layout of the blocks or records changes
+#define FLASH_LOG_VERSION      1
+
+//! number of flash blocks of the log (in front of the block of the INS calibration)
+#define FLASH_LOG_BLOCKS       8
+
+//! maximum size of the payload of a record (bytes)
+#define FLASH_LOG_MAX_PAYLOAD  64
+//! size of the buffer in the RAM (bytes, power of two): 1.8 s of records at 1 kHz with 24 bytes of payload
+#define FLASH_LOG_BUFFER_SIZE  65536
+//! the writer writes to the flash in pages of this size
+#define FLASH_LOG_PAGE_SIZE    256
+//! records that do not fill a page are written after this number of ticks at the latest
+#define FLASH_LOG_FLUSH_TICKS  100
+
+#define FLASH_LOG_WRITER_STACKSIZE 1024
+
+
+// types of the records
+#define FLASH_LOG_SESSION   0  // the system has been started (no payload)
+#define FLASH_LOG_MOTOR     1  // FlashLogMotor
+#define FLASH_LOG_INS       2  // FlashLogINS
+#define FLASH_LOG_FAULT     3  // FlashLogFault
+#define FLASH_LOG_BENCHMARK 4  // added by 'benchmark_flash_log' (FlashLogINS)
+
+// codes of the faults
+#define FLASH_LOG_FAULT_SENSOR_READ  1    // the acceleration sensor could not be read
+#define FLASH_LOG_FAULT_CALIBRATION  2    // the calibration could not be stored
+#define FLASH_LOG_FAULT_FLASH_CHECK  3    // a block of the flash differs from the manifest (value: block)
+
+
+// header of every block of the log (only 32 bit members => no padding)
+typedef struct FlashLogBlockHeader {
+	alt_u32 magic;
+	alt_u32 version;
+	alt_u32 sequence;       // incremented with every block that is started
+	alt_u32 erase_count;    // number of times the block has been erased by the log
+	alt_u32 crc;            // CRC-32 of all the members above
+} FlashLogBlockHeader;
+
+// header in front of the payload of every record
+typedef struct FlashLogRecordHeader {
+	alt_u16 magic;
+	alt_u8  type;           // FLASH_LOG_*
+	alt_u8  length;         // size of the payload (bytes)
+	alt_u32 timestamp;      // system time when the record has been added (alt_nticks)
+	alt_u32 crc;            // CRC-32 of the members above and the payload
+} FlashLogRecordHeader;
+
+
+// payload of the records
+typedef struct FlashLogMotor {
+	alt_32 mode;            // driving pattern (MOVE_*)
+	float  direction;       // alignment of the wheels
+	float  power;           // power of the engines
+} FlashLogMotor;
+
+typedef struct FlashLogINS {
+	float acceleration[3];
+	float speed[3];
+} FlashLogINS;
+
+typedef struct FlashLogFault {
+	alt_u32 code;           // FLASH_LOG_FAULT_*
+	alt_u32 value;          // depends on the fault
+} FlashLogFault;
+
+
+/**
+ * Statistics of the log
+ */
+typedef struct FlashLogStats {
+	alt_u32 records;        // records added to the buffer
+	alt_u32 dropped;        // records dropped, because the buffer was full
+	alt_u32 written;        // records written to the flash
+	alt_u32 bytes;          // bytes written to the flash
+	alt_u32 erases;         // blocks erased
+	alt_u32 errors;         // failed accesses to the flash
+	alt_u32 max_buffered;   // maximum fill level of the buffer (bytes)
+	alt_u32 sequence;       // sequence number of the block that is written
+	alt_u32 min_erase_count;
+	alt_u32 max_erase_count;
+} FlashLogStats;
+
+
+/**
+ * Position of a reader in the log (see 'first_log_record')
+ */
+typedef struct FlashLogCursor {
+	alt_u16 block;          // block of the log (0 .. FLASH_LOG_BLOCKS-1)
+	alt_u16 blocks_left;    // number of blocks after this one
+	alt_u32 sequence;       // sequence number of the block
+	alt_u32 offset;         // offset of the next record in the flash
+	alt_u32 end;            // end of the block in the flash
+} FlashLogCursor;
+
+
+/**
+ * Open the flash and recover the state of the log from it: the block that has been written
+ * last, and the position behind its last valid record. If the rest of that block is not
+ * completely erased (e.g. the power failed during a write), the log continues in the next block.
+ * A FLASH_LOG_SESSION record is added to the buffer.
+ * Has to be called before 'start_flash_log_writer'.
+ *
+ * @param flash_name name of the flash device (e.g. EPCS_NAME)
+ *
+ * @result 1: success, 0: the flash cannot be opened or is too small
+ */
+int  init_flash_log(char *flash_name);
+
+
+/**
+ * Create the writer task, which moves the records from the buffer to the flash.
+ * Has to be called after OSInit and 'init_flash_log'.
+ *
+ * @param priority priority of the writer task (should be lower than the ones of all the
+ *                 tasks that add records)
+ * @param lock_priority priority inherited by a task holding 'lock_flash_log' (priority
+ *                 inheritance of the mutex): a free priority above the writer task and all
+ *                 the other tasks taking the lock, but below all the control tasks
+ *
+ * @result 1: success, 0: the task or the lock cannot be created
+ */
+int  start_flash_log_writer(int priority, int lock_priority);
+
+
+/**
+ * Add a record to the log.
+ * The record is only copied to the buffer, so this function never blocks and can be called
+ * from any task at high rates. If the buffer is full, the record is dropped.
+ *
+ * @param type type of the record (FLASH_LOG_*)
+ * @param data the payload
+ * @param length size of the payload (at most FLASH_LOG_MAX_PAYLOAD bytes)
+ *
+ * @result 1: success, 0: the record has been dropped
+ */
+int  log_record(alt_u8 type, const void *data, alt_u8 length);
+
+
+/**
+ * Job that the writer task runs with exclusive access to the flash (see 'queue_flash_job').
+ */
+typedef void (*FlashLogJob)(void *context);
+
+
+/**
+ * Let the writer task run a job that accesses the flash, e.g. erasing and writing a block.
+ * Tasks with a high priority use this instead of 'lock_flash_log', so that they never wait
+ * for the flash. There is room for one job: the next one can be queued when it has been run.
+ *
+ * @param job the job
+ * @param context passed to the job
+ *
+ * @result 1: success, 0: another job is waiting or the writer task is not running
+ */
+int  queue_flash_job(FlashLogJob job, void *context);
+
+
+/**
+ * Get exclusive access to the flash while the writer task is running.
+ * The driver of the EPCS and the read cache of flash.c cannot handle concurrent accesses, so
+ * every other user of the flash has to hold the lock. Waits for the current write or erase of the writer task to finish,
+ * which can take about 1 s: only background tasks with a priority below the lock priority
+ * (see 'start_flash_log_writer') take the lock, all others use 'queue_flash_job'.
+ */
+void lock_flash_log(void);
+
+
+/**
+ * Release the lock taken by 'lock_flash_log'.
+ */
+void unlock_flash_log(void);
+
+
+/**
+ * Get the statistics of the log.
+ *
+ * @param stats the statistics are copied to this structure
+ */
+void get_flash_log_stats(FlashLogStats *stats);
+
+
+/**
+ * Find the oldest record in the flash.
+ * Reading the log must not overlap with the writer task, so the records of the previous
+ * sessions have to be read before 'start_flash_log_writer'.
+ *
+ * @param cursor the position of the reader, pass it to 'next_log_record'
+ *
+ * @result 1: success, 0: the log is empty
+ */
+int  first_log_record(FlashLogCursor *cursor);
+
+
+/**
+ * Read the next record of the log and move the cursor behind it.
+ *
+ * @param cursor the position of the reader (see 'first_log_record')
+ * @param record the header of the record
+ * @param payload buffer for the payload (FLASH_LOG_MAX_PAYLOAD bytes)
+ *
+ * @result 1: success, 0: there are no more records
+ */
+int  next_log_record(FlashLogCursor *cursor, FlashLogRecordHeader *record, void *payload);
+
+
+#endif /* FLASH_LOG_H_ */
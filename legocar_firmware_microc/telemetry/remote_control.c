@@ -0,0 +1,179 @@
+/*
+ * remote_control.c
+ *
+ *  Created on: 17.10.2026
+ */
+
+#include "remote_control.h"
+
+#include <string.h>
+
+#include "uart_telemetry.h"
+#include "../common/crc32.h"
+#include "../terasic_lib/terasic_includes.h"
+
+
+typedef struct CommandDecoder {
+	alt_u8  frame[COMMAND_FRAME_SIZE];
+	alt_u32 size;           // decoded bytes of the current frame
+	alt_u8  code;           // code byte of the current block of COBS
+	alt_u8  left;           // bytes left in the current block
+	int     overflow;       // the frame is too long, it is skipped up to the next zero
+} CommandDecoder;
+
+
+static CommandDecoder decoder;
+
+static RemoteControlStats remote_stats;
+
+// system time of the last valid command, and whether its timeout has not been reported yet
+static alt_u32 last_command;
+static int     timeout_pending;
+
+
+static void reset_decoder(void) {
+	decoder.size     = 0;
+	decoder.code     = 0;
+	decoder.left     = 0;
+	decoder.overflow = 0;
+}
+
+static void append_byte(alt_u8 byte) {
+	if(decoder.size < COMMAND_FRAME_SIZE)
+		decoder.frame[decoder.size++] = byte;
+	else
+		decoder.overflow = 1;
+}
+
+/**
+ * Check a complete frame and copy it to the command.
+ *
+ * @result 1: the frame is a valid command, 0: it is invalid
+ */
+static int finish_frame(RemoteCommand *command) {
+	CommandHeader header;
+	alt_u32 crc, length;
+
+	if(decoder.overflow || decoder.left != 0 || decoder.size < sizeof(header) + sizeof(crc))
+		return 0;
+
+	length = decoder.size - sizeof(header) - sizeof(crc);
+	memcpy(&header, decoder.frame, sizeof(header));
+	memcpy(&crc, decoder.frame + sizeof(header) + length, sizeof(crc));
+
+	if(header.length != length || crc != crc32(decoder.frame, sizeof(header) + length))
+		return 0;
+
+	command->type      = header.type;
+	command->sequence  = header.sequence;
+	command->direction = 0;
+	command->power     = 0;
+
+	switch(header.type) {
+	case COMMAND_VELOCITY: {
+		CommandVelocity velocity;
+
+		if(length != sizeof(velocity))
+			return 0;
+		memcpy(&velocity, decoder.frame + sizeof(header), sizeof(velocity));
+		command->direction = velocity.direction;
+		command->power     = velocity.power;
+		break;
+	}
+
+	case COMMAND_ROTATE: {
+		CommandRotate rotate;
+
+		if(length != sizeof(rotate))
+			return 0;
+		memcpy(&rotate, decoder.frame + sizeof(header), sizeof(rotate));
+		command->power = rotate.power;
+		break;
+	}
+
+	case COMMAND_STOP:
+	case COMMAND_QUERY:
+		if(length != 0)
+			return 0;
+		break;
+
+	default:
+		return 0;
+	}
+
+	return 1;
+}
+
+int receive_command(RemoteCommand *command, int max_bytes) {
+	alt_u8 byte;
+	alt_u32 time;
+	int valid;
+
+	while(max_bytes-- > 0 && receive_uart_byte(&byte, &time)) {
+
+		// the end of a frame
+		if(byte == 0) {
+			valid = decoder.size > 0 && finish_frame(command);
+			if(decoder.size > 0 || decoder.overflow) {
+				if(valid)
+					remote_stats.commands++;
+				else
+					remote_stats.errors++;
+			}
+			reset_decoder();
+
+			if(valid) {
+				command->received = time;
+				last_command      = time;
+				timeout_pending   = 1;
+				return 1;
+			}
+			continue;
+		}
+
+		if(decoder.left > 0) {
+			append_byte(byte);
+			decoder.left--;
+			continue;
+		}
+
+		// a new block of COBS: a block shorter than 254 bytes ended with a zero
+		if(decoder.code != 0 && decoder.code != 0xFF)
+			append_byte(0);
+		decoder.code = byte;
+		decoder.left = byte - 1;
+	}
+
+	return 0;
+}
+
+int apply_commands(void (*apply)(const RemoteCommand *command), int max_commands, int max_bytes) {
+	RemoteCommand command;
+	int n;
+
+	for(n=0; n<max_commands && receive_command(&command, max_bytes); n++)
+		apply(&command);
+
+	return n;
+}
+
+int command_timeout(alt_u32 timeout) {
+	if(!timeout_pending || alt_nticks() - last_command <= timeout)
+		return 0;
+
+	timeout_pending = 0;
+	return 1;
+}
+
+void command_applied(const RemoteCommand *command) {
+	alt_u32 latency = alt_nticks() - command->received;
+
+	remote_stats.latency_last = latency;
+	remote_stats.latency_sum += latency;
+	if(latency > remote_stats.latency_max)
+		remote_stats.latency_max = latency;
+}
+
+void get_remote_control_stats(RemoteControlStats *stats) {
+	*stats = remote_stats;
+}
@@ -0,0 +1,148 @@
+/*
+ * remote_control.h
+ *
+ * Commands of the host for driving the car at runtime, received on uart_0.
+ *
+ * A command is framed like the telemetry records (see uart_telemetry.h): a header (type,
+ * sequence number, length), the payload and a CRC-32 over both, encoded with COBS and
+ * terminated by a zero byte. The interrupt of the UART collects the bytes with their arrival
+ * time; the control task decodes them with 'receive_command' byte by byte (bounded time per
+ * byte, the CRC is checked over at most COMMAND_FRAME_SIZE bytes at the end of a frame), and
+ * applies the command in the same period. The time from the arrival of the last byte of a
+ * command until the engines have been set is measured with 'command_applied'.
+ *
+ * The host sends the commands with tools/remote_command.c.
+ *
+ *  Created on: 17.10.2026
+ */
+
+#ifndef REMOTE_CONTROL_H_
+#define REMOTE_CONTROL_H_
+
+#include <alt_types.h>
+
+// types of the commands
+#define COMMAND_VELOCITY 1  // CommandVelocity: drive in a direction (MOVE_DIAGONAL)
+#define COMMAND_ROTATE   2  // CommandRotate: rotate on the spot (MOVE_ROTATE)
+#define COMMAND_STOP     3  // no payload
+#define COMMAND_QUERY    4  // no payload, the car answers with a TELEMETRY_STATE record
+
+//! maximum size of the payload of a command (bytes)
+#define COMMAND_MAX_PAYLOAD 8
+//! maximum size of a decoded frame: header, payload and CRC
+#define COMMAND_FRAME_SIZE  (sizeof(CommandHeader) + COMMAND_MAX_PAYLOAD + sizeof(alt_u32))
+
+
+// header in front of the payload of every command
+typedef struct CommandHeader {
+	alt_u8  type;           // COMMAND_*
+	alt_u8  sequence;       // chosen by the host, returned in the TELEMETRY_STATE record
+	alt_u16 length;         // size of the payload (bytes)
+} CommandHeader;
+
+
+// payload of the commands
+typedef struct CommandVelocity {
+	alt_16 direction;       // alignment of the wheels (Q15)
+	alt_16 power;           // power of the engines (Q15)
+} CommandVelocity;
+
+typedef struct CommandRotate {
+	alt_16 power;           // power of the engines (Q15)
+} CommandRotate;
+
+
+/**
+ * A decoded command
+ */
+typedef struct RemoteCommand {
+	alt_u8  type;           // COMMAND_*
+	alt_u8  sequence;
+	alt_16  direction;      // COMMAND_VELOCITY
+	alt_16  power;          // COMMAND_VELOCITY, COMMAND_ROTATE
+	alt_u32 received;       // system time when the last byte has been received (alt_nticks)
+} RemoteCommand;
+
+
+/**
+ * Statistics of the commands
+ */
+typedef struct RemoteControlStats {
+	alt_u32 commands;       // valid commands
+	alt_u32 errors;         // frames with a wrong CRC, size or type
+	alt_u32 latency_last;   // ticks from the arrival of the command until it has been applied
+	alt_u32 latency_max;
+	alt_u32 latency_sum;
+} RemoteControlStats;
+
+
+// payload of the TELEMETRY_STATE record
+typedef struct RemoteControlState {
+	alt_u8  sequence;       // of the last command
+	alt_u8  mode;           // driving pattern (MOVE_*)
+	alt_16  direction;      // Q15
+	alt_16  power;          // Q15
+	alt_u16 reserved;
+	alt_u32 commands;
+	alt_u32 errors;
+	alt_u32 latency_last;   // ticks
+	alt_u32 latency_max;    // ticks
+} RemoteControlState;
+
+
+/**
+ * Decode the received bytes until a command is complete.
+ * At most 'max_bytes' bytes are taken from the receiver, the rest stays for the next call.
+ * Must only be called by one task.
+ *
+ * @param command the decoded command
+ * @param max_bytes maximum number of bytes to decode
+ *
+ * @result 1: a command has been decoded, 0: no complete command
+ */
+int  receive_command(RemoteCommand *command, int max_bytes);
+
+
+/**
+ * Decode and apply the commands received since the last call.
+ * At most 'max_commands' commands are applied and at most 'max_bytes' bytes are decoded per
+ * command, so a flood of bytes from the host cannot take over the calling task: the rest stays
+ * for the next call. Must only be called by one task.
+ *
+ * @param apply called for every command, has to call 'command_applied' when the engines are set
+ * @param max_commands maximum number of commands
+ * @param max_bytes maximum number of bytes to decode per command (see 'receive_command')
+ *
+ * @result number of commands applied
+ */
+int  apply_commands(void (*apply)(const RemoteCommand *command), int max_commands, int max_bytes);
+
+
+/**
+ * Check whether the host has stopped sending commands, e.g. because the connection is lost.
+ * Reports every gap only once: the next valid command starts the time again.
+ *
+ * @param timeout maximum time between two commands (ticks of the system timer)
+ *
+ * @result 1: there has been a command, but no further one for more than 'timeout' ticks
+ */
+int  command_timeout(alt_u32 timeout);
+
+
+/**
+ * Measure the latency of a command after it has been applied to the engines.
+ *
+ * @param command the command (see 'receive_command')
+ */
+void command_applied(const RemoteCommand *command);
+
+
+/**
+ * Get the statistics of the commands.
+ *
+ * @param stats the statistics are copied to this structure
+ */
+void get_remote_control_stats(RemoteControlStats *stats);
+
+
+#endif /* REMOTE_CONTROL_H_ */
@@ -0,0 +1,235 @@
+/*
+ * uart_telemetry.c
+ *
+ *  Created on: 17.10.2026
+ */
+
+#include "uart_telemetry.h"
+
+// critical sections from MicroC-OS
+#include "includes.h"
+
+#include <string.h>
+#include <system.h>
+#include <altera_avalon_uart_regs.h>
+#include <sys/alt_irq.h>
+
+#include "../common/crc32.h"
+#include "../terasic_lib/terasic_includes.h"
+
+
+// size of a frame before and after the encoding (header, payload, CRC, overhead of COBS and zero)
+#define FRAME_SIZE   (sizeof(TelemetryHeader) + TELEMETRY_MAX_PAYLOAD + sizeof(alt_u32))
+#define ENCODED_SIZE (FRAME_SIZE + FRAME_SIZE/254 + 2)
+
+
+typedef struct UartTelemetry {
+	int     started;
+	alt_u8  sequence;
+
+	// encoded frames waiting for the transmitter (the positions are not wrapped)
+	alt_u8  buffer[TELEMETRY_BUFFER_SIZE];
+	volatile alt_u32 buffer_in;
+	volatile alt_u32 buffer_out;
+
+	// received bytes and their arrival times, filled by the interrupt
+	volatile alt_u8  rx_buffer[TELEMETRY_RX_BUFFER_SIZE];
+	volatile alt_u32 rx_times[TELEMETRY_RX_BUFFER_SIZE];
+	volatile alt_u32 rx_in;
+	volatile alt_u32 rx_out;
+
+	// copy of the control register of the UART
+	alt_u32 control;
+
+	TelemetryStats stats;
+} UartTelemetry;
+
+
+static UartTelemetry telemetry;
+
+
+/**
+ * Take the received byte, and move one byte to the transmitter whenever it is ready. The
+ * interrupt of the transmitter is switched off when the buffer is empty.
+ */
+static void uart_telemetry_isr(void *context) {
+	alt_u32 status = IORD_ALTERA_AVALON_UART_STATUS(UART_0_BASE);
+	alt_u8 byte;
+
+	// clear the error bits
+	IOWR_ALTERA_AVALON_UART_STATUS(UART_0_BASE, 0);
+	if(status & (ALTERA_AVALON_UART_STATUS_ROE_MSK | ALTERA_AVALON_UART_STATUS_FE_MSK | ALTERA_AVALON_UART_STATUS_PE_MSK))
+		telemetry.stats.rx_errors++;
+
+	if(status & ALTERA_AVALON_UART_STATUS_RRDY_MSK) {
+		byte = IORD_ALTERA_AVALON_UART_RXDATA(UART_0_BASE);
+		telemetry.stats.received++;
+
+		if(telemetry.rx_in - telemetry.rx_out < TELEMETRY_RX_BUFFER_SIZE) {
+			telemetry.rx_buffer[telemetry.rx_in % TELEMETRY_RX_BUFFER_SIZE] = byte;
+			telemetry.rx_times[telemetry.rx_in % TELEMETRY_RX_BUFFER_SIZE]  = alt_nticks();
+			telemetry.rx_in++;
+		}
+		else {
+			telemetry.stats.rx_dropped++;
+		}
+	}
+
+	if(!(status & ALTERA_AVALON_UART_STATUS_TRDY_MSK) || !(telemetry.control & ALTERA_AVALON_UART_CONTROL_TRDY_MSK))
+		return;
+
+	if(telemetry.buffer_out != telemetry.buffer_in) {
+		IOWR_ALTERA_AVALON_UART_TXDATA(UART_0_BASE, telemetry.buffer[telemetry.buffer_out % TELEMETRY_BUFFER_SIZE]);
+		telemetry.buffer_out++;
+		telemetry.stats.bytes++;
+	}
+	else {
+		telemetry.control &= ~ALTERA_AVALON_UART_CONTROL_TRDY_MSK;
+		IOWR_ALTERA_AVALON_UART_CONTROL(UART_0_BASE, telemetry.control);
+	}
+}
+
+/**
+ * Copy data to the buffer, wrapping around at its end.
+ */
+static void buffer_write(alt_u32 position, const void *data, alt_u32 size) {
+	alt_u32 start = position % TELEMETRY_BUFFER_SIZE;
+	alt_u32 first = TELEMETRY_BUFFER_SIZE - start;
+
+	if(first > size)
+		first = size;
+
+	memcpy(&telemetry.buffer[start], data, first);
+	memcpy(telemetry.buffer, (const alt_u8 *) data + first, size - first);
+}
+
+
+alt_u32 cobs_encode(const alt_u8 *data, alt_u32 size, alt_u8 *encoded) {
+	// position of the code byte of the current block, which holds the distance to the next zero
+	alt_u32 code = 0;
+	alt_u32 out = 1;
+	alt_u32 i;
+
+	for(i=0; i<size; i++) {
+		if(data[i] != 0)
+			encoded[out++] = data[i];
+
+		// a zero or a full block ends the block
+		if(data[i] == 0 || out - code == 0xFF) {
+			encoded[code] = out - code;
+			code = out++;
+		}
+	}
+
+	encoded[code] = out - code;
+	encoded[out++] = 0;
+
+	return out;
+}
+
+int init_uart_telemetry(void) {
+	TelemetrySession session = { TELEMETRY_VERSION, 0 };
+
+	telemetry.buffer_in  = 0;
+	telemetry.buffer_out = 0;
+	telemetry.rx_in      = 0;
+	telemetry.rx_out     = 0;
+	memset(&telemetry.stats, 0, sizeof(telemetry.stats));
+
+	// the interrupt of the transmitter is only switched on while there is something to send
+	telemetry.control = ALTERA_AVALON_UART_CONTROL_RRDY_MSK;
+	IOWR_ALTERA_AVALON_UART_CONTROL(UART_0_BASE, telemetry.control);
+	IOWR_ALTERA_AVALON_UART_STATUS(UART_0_BASE, 0);
+
+	if(alt_ic_isr_register(UART_0_IRQ_INTERRUPT_CONTROLLER_ID, UART_0_IRQ, uart_telemetry_isr, NULL, NULL) != 0)
+		return 0;
+
+	telemetry.started = 1;
+
+	session.ticks_per_second = alt_ticks_per_second();
+	send_telemetry(TELEMETRY_SESSION, &session, sizeof(session));
+
+	return 1;
+}
+
+int send_telemetry(alt_u8 type, const void *data, alt_u16 length) {
+	alt_u8 frame[FRAME_SIZE];
+	alt_u8 encoded[ENCODED_SIZE];
+	TelemetryHeader header;
+	alt_u32 crc, size, fill;
+	int success = 0;
+#if OS_CRITICAL_METHOD == 3
+	OS_CPU_SR cpu_sr = 0;
+#endif
+
+	if(!telemetry.started || length > TELEMETRY_MAX_PAYLOAD)
+		return 0;
+
+	// dropped records leave a gap in the sequence numbers
+	OS_ENTER_CRITICAL();
+	header.sequence = telemetry.sequence++;
+	OS_EXIT_CRITICAL();
+
+	header.type      = type;
+	header.length    = length;
+	header.timestamp = alt_nticks();
+
+	// the frame is encoded outside of the critical section
+	memcpy(frame, &header, sizeof(header));
+	memcpy(frame + sizeof(header), data, length);
+	crc = crc32(frame, sizeof(header) + length);
+	memcpy(frame + sizeof(header) + length, &crc, sizeof(crc));
+
+	size = cobs_encode(frame, sizeof(header) + length + sizeof(crc), encoded);
+
+	OS_ENTER_CRITICAL();
+
+	fill = telemetry.buffer_in - telemetry.buffer_out;
+	if(fill + size <= TELEMETRY_BUFFER_SIZE) {
+		buffer_write(telemetry.buffer_in, encoded, size);
+		telemetry.buffer_in += size;
+
+		telemetry.stats.records++;
+		if(fill + size > telemetry.stats.max_buffered)
+			telemetry.stats.max_buffered = fill + size;
+		success = 1;
+
+		// the interrupt sends the frame as soon as the transmitter is ready
+		if(!(telemetry.control & ALTERA_AVALON_UART_CONTROL_TRDY_MSK)) {
+			telemetry.control |= ALTERA_AVALON_UART_CONTROL_TRDY_MSK;
+			IOWR_ALTERA_AVALON_UART_CONTROL(UART_0_BASE, telemetry.control);
+		}
+	}
+	else {
+		telemetry.stats.dropped++;
+	}
+
+	OS_EXIT_CRITICAL();
+
+	return success;
+}
+
+int receive_uart_byte(alt_u8 *byte, alt_u32 *time) {
+	alt_u32 position = telemetry.rx_out;
+
+	if(position == telemetry.rx_in)
+		return 0;
+
+	*byte = telemetry.rx_buffer[position % TELEMETRY_RX_BUFFER_SIZE];
+	*time = telemetry.rx_times[position % TELEMETRY_RX_BUFFER_SIZE];
+
+	// only one task takes bytes, so no critical section is needed
+	telemetry.rx_out = position + 1;
+
+	return 1;
+}
+
+void get_telemetry_stats(TelemetryStats *stats) {
+#if OS_CRITICAL_METHOD == 3
+	OS_CPU_SR cpu_sr = 0;
+#endif
+
+	OS_ENTER_CRITICAL();
+	*stats = telemetry.stats;
+	OS_EXIT_CRITICAL();
+}
@@ -0,0 +1,156 @@
+/*
+ * uart_telemetry.h
+ *
+ * Binary telemetry stream on uart_0, which replaces formatting floating point values with
+ * printf in the tasks (that pulls vfprintf and dtoa into the soft-float CPU and takes
+ * milliseconds per line).
+ *
+ * Every record is sent as one frame: a header (type, sequence number, length, system time),
+ * the payload and a CRC-32 over both, encoded with COBS (consistent overhead byte stuffing)
+ * and terminated by a zero byte. Since COBS removes all zeros from the frame, the receiver
+ * finds the start of the next frame after any corruption or lost byte. The payloads have a
+ * fixed layout (little endian, as the Nios II).
+ *
+ * Tasks add records with 'send_telemetry', which encodes the frame on the stack and copies it
+ * to a ring buffer. It never waits for the UART: the interrupt of the UART moves the buffer to
+ * the transmitter byte by byte, and if the buffer is full, the record is dropped.
+ *
+ * The host decodes the stream with tools/telemetry_decode.c.
+ *
+ * The interrupt also collects the received bytes in a second ring buffer, together with the
+ * system time of their arrival, for the commands of the host (see remote_control.h).
+ *
+ *  Created on: 17.10.2026
+ */
+
+#ifndef UART_TELEMETRY_H_
+#define UART_TELEMETRY_H_
+
+#include <alt_types.h>
+
+//! increment whenever the layout of the frames or records changes
+#define TELEMETRY_VERSION       1
+
+//! maximum size of the payload of a record (bytes)
+#define TELEMETRY_MAX_PAYLOAD   64
+//! size of the ring buffer of the transmitter (bytes, power of two): 0.35 s at 115200 baud
+#define TELEMETRY_BUFFER_SIZE   4096
+//! size of the ring buffer of the receiver (bytes, power of two)
+#define TELEMETRY_RX_BUFFER_SIZE 256
+
+
+// types of the records
+#define TELEMETRY_SESSION 0  // the system has been started (TelemetrySession)
+#define TELEMETRY_INS     1  // TelemetryINS
+#define TELEMETRY_MOTOR   2  // TelemetryMotor
+#define TELEMETRY_TASKS   3  // TelemetryTasks
+#define TELEMETRY_STATE   4  // RemoteControlState (answer to COMMAND_QUERY)
+
+
+// header in front of the payload of every record
+typedef struct TelemetryHeader {
+	alt_u8  type;           // TELEMETRY_*
+	alt_u8  sequence;       // incremented with every record, gaps show dropped records
+	alt_u16 length;         // size of the payload (bytes)
+	alt_u32 timestamp;      // system time when the record has been sent (alt_nticks)
+} TelemetryHeader;
+
+
+// payload of the records
+typedef struct TelemetrySession {
+	alt_u32 version;        // TELEMETRY_VERSION
+	alt_u32 ticks_per_second;
+} TelemetrySession;
+
+typedef struct TelemetryINS {
+	alt_16 sample[3];       // latest raw output of the sensor
+	alt_16 samples;         // number of samples of the period
+	float  acceleration[3]; // m/s^2
+	float  speed[3];        // m/s
+} TelemetryINS;
+
+typedef struct TelemetryMotor {
+	alt_32 mode;            // driving pattern (MOVE_*)
+	alt_16 speed[4];        // power of the engines of the wheels (Q15)
+	alt_16 direction[4];    // power of the engines of the alignment (Q15)
+} TelemetryMotor;
+
+typedef struct TelemetryTasks {
+	alt_u32 releases[3];        // of the rate groups (RATE_GROUP_*)
+	alt_u32 deadline_misses[3];
+	alt_u32 overruns[3];
+	alt_u32 dropped;            // records dropped by the telemetry (before this one)
+} TelemetryTasks;
+
+
+/**
+ * Statistics of the telemetry
+ */
+typedef struct TelemetryStats {
+	alt_u32 records;        // records added to the buffer
+	alt_u32 dropped;        // records dropped, because the buffer was full
+	alt_u32 bytes;          // bytes sent by the interrupt
+	alt_u32 max_buffered;   // maximum fill level of the buffer (bytes)
+	alt_u32 received;       // bytes received
+	alt_u32 rx_dropped;     // bytes dropped, because the buffer of the receiver was full
+	alt_u32 rx_errors;      // overrun, framing and parity errors of the UART
+} TelemetryStats;
+
+
+/**
+ * Take over uart_0 for the telemetry and send a TELEMETRY_SESSION record.
+ * The interrupt of the UART is registered anew, so uart_0 must not be used through the
+ * HAL driver (/dev/uart_0) any more.
+ *
+ * @result 1: success, 0: the interrupt cannot be registered
+ */
+int  init_uart_telemetry(void);
+
+
+/**
+ * Send a record.
+ * The frame is encoded on the stack and copied to the buffer of the transmitter, so this
+ * function never blocks and can be called from any task. If the buffer is full, or before
+ * 'init_uart_telemetry', the record is dropped.
+ *
+ * @param type type of the record (TELEMETRY_*)
+ * @param data the payload
+ * @param length size of the payload (at most TELEMETRY_MAX_PAYLOAD bytes)
+ *
+ * @result 1: success, 0: the record has been dropped
+ */
+int  send_telemetry(alt_u8 type, const void *data, alt_u16 length);
+
+
+/**
+ * Take the oldest byte from the buffer of the receiver.
+ *
+ * @param byte the received byte
+ * @param time system time when the byte has been received (alt_nticks)
+ *
+ * @result 1: success, 0: no byte has been received
+ */
+int  receive_uart_byte(alt_u8 *byte, alt_u32 *time);
+
+
+/**
+ * Get the statistics of the telemetry.
+ *
+ * @param stats the statistics are copied to this structure
+ */
+void get_telemetry_stats(TelemetryStats *stats);
+
+
+/**
+ * Encode a frame with COBS, including the terminating zero.
+ *
+ * @param data the frame
+ * @param size size of the frame (bytes)
+ * @param encoded buffer for the encoded frame (at least size + size/254 + 2 bytes)
+ *
+ * @result size of the encoded frame (bytes)
+ */
+alt_u32 cobs_encode(const alt_u8 *data, alt_u32 size, alt_u8 *encoded);
+
+
+#endif /* UART_TELEMETRY_H_ */
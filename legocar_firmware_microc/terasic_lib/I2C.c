@@ -31,6 +31,7 @@
 // --------------------------------------------------------------------
 #include "terasic_includes.h"
 #include "I2C.h"
+#include "includes.h"  // uC/OS-II: semaphores for the queued transfers
 
 // Note. Remember to reset device befroe acceess I2C interface
 #ifdef DEBUG_I2C
@@ -46,26 +47,106 @@
 //void dump_message(char *pMessage);
 //#define DEBUG_DUMP dump_message
 
-#define SDA_DIR_IN(data_base)   IOWR_ALTERA_AVALON_PIO_DIRECTION(data_base,0)
-#define SDA_DIR_OUT(data_base)  IOWR_ALTERA_AVALON_PIO_DIRECTION(data_base,1) 
-#define SDA_HIGH(data_base)     IOWR_ALTERA_AVALON_PIO_DATA(data_base, 1)
-#define SDA_LOW(data_base)      IOWR_ALTERA_AVALON_PIO_DATA(data_base, 0)
+#ifdef I2C_TRACE
+static void i2c_trace(alt_u8 Line, alt_u8 Value);
+#define I2C_TRACE_EDGE(line, value)     i2c_trace(line, value)
+#else
+#define I2C_TRACE_EDGE(line, value)
+#endif
+
+#define SDA_DIR_IN(data_base)   do{ IOWR_ALTERA_AVALON_PIO_DIRECTION(data_base,0); I2C_TRACE_EDGE(2, 0); }while(0)
+#define SDA_DIR_OUT(data_base)  do{ IOWR_ALTERA_AVALON_PIO_DIRECTION(data_base,1); I2C_TRACE_EDGE(2, 1); }while(0)
+#define SDA_HIGH(data_base)     do{ IOWR_ALTERA_AVALON_PIO_DATA(data_base, 1); I2C_TRACE_EDGE(1, 1); }while(0)
+#define SDA_LOW(data_base)      do{ IOWR_ALTERA_AVALON_PIO_DATA(data_base, 0); I2C_TRACE_EDGE(1, 0); }while(0)
 #define SDA_READ(data_base)     IORD_ALTERA_AVALON_PIO_DATA(data_base)
-#define SCL_HIGH(clk_base)     IOWR_ALTERA_AVALON_PIO_DATA(clk_base, 1)
-#define SCL_LOW(clk_base)      IOWR_ALTERA_AVALON_PIO_DATA(clk_base, 0)
+#define SCL_HIGH(clk_base)      do{ IOWR_ALTERA_AVALON_PIO_DATA(clk_base, 1); I2C_TRACE_EDGE(0, 1); }while(0)
+#define SCL_LOW(clk_base)       do{ IOWR_ALTERA_AVALON_PIO_DATA(clk_base, 0); I2C_TRACE_EDGE(0, 0); }while(0)
+
+#define SCL_DELAY    i2c_delay()
+
+// delay of a half clock: nDelayLoop iterations of the delay loop, usleep(1) if not calibrated
+static bool bDelayCalibrated = FALSE;
+static alt_u32 nDelayLoop = 0;
+static alt_u32 nLoopPs = 0;     // duration of one iteration of the delay loop (ps)
+static alt_u32 nBusClock = 0;
+
+#ifdef I2C_TRACE
+static alt_u32 nTraceLoops = 0; // time of the trace without timestamp timer
+#endif
 
-#define SCL_DELAY    usleep(1)
+static void i2c_delay_loop(alt_u32 nLoop){
+    volatile alt_u32 n;
+    for(n=nLoop;n>0;n--)
+        ;
+}
+
+static void i2c_delay(void){
+    if (!bDelayCalibrated){
+        usleep(1);
+#ifdef I2C_TRACE
+        nTraceLoops++;
+#endif
+        return;
+    }
+    i2c_delay_loop(nDelayLoop);
+#ifdef I2C_TRACE
+    nTraceLoops += nDelayLoop;
+#endif
+}
 
 
 void i2c_start(alt_u32 clk_base, alt_u32 data_base);
 void i2c_stop(alt_u32 clk_base, alt_u32 data_base);
 bool i2c_write(alt_u32 clk_base, alt_u32 data_base, alt_u8 Data);
 void i2c_read(alt_u32 clk_base, alt_u32 data_base, alt_u8 *pData, bool bAck);
+bool i2c_wait_ready(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr);
+static bool i2c_write_page(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr, alt_u8 ControlAddr, alt_u8 *pData, alt_u16 len);
+
+static alt_u32 nWriteTimeout = I2C_WRITE_TIMEOUT_DEFAULT;
+static alt_u16 nPageSize = 0;
+
+static bool bAsyncActive = FALSE;
+
+// queue the transfer if it may sleep, i.e. in a task while the driver task is running
+static bool i2c_use_queue(void){
+    return bAsyncActive && OSRunning && OSIntNesting == 0;
+}
+
+// blocking transfer through the queue, split into pieces of I2C_MAX_TRANSFER_SIZE
+static bool i2c_queued_transfer(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr, alt_u8 ControlAddr, bool bRead, alt_u8 *pData, alt_u16 len){
+    bool bSuccess = TRUE;
+    alt_u16 nLen;
+    int nTicket;
+    do{
+        nLen = len;
+        if (nLen > I2C_MAX_TRANSFER_SIZE)
+            nLen = I2C_MAX_TRANSFER_SIZE;
+        // sleep while the queue is full, the bus must not be accessed directly while the driver task runs
+        while((nTicket = I2C_Submit(clk_base, data_base, DeviceAddr, ControlAddr, bRead, pData, nLen)) < 0)
+            OSTimeDly(1);
+        bSuccess = I2C_Wait(nTicket, 0);
+        ControlAddr += nLen;
+        pData += nLen;
+        len -= nLen;
+    }while(len > 0 && bSuccess);
+    return bSuccess;
+}
+
+void I2C_SetWriteTimeout(alt_u32 nTimeoutMs){
+    nWriteTimeout = nTimeoutMs;
+}
+
+void I2C_SetPageSize(alt_u16 nSize){
+    nPageSize = nSize;
+}
 
 
 
 bool I2C_Write(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr, alt_u8 ControlAddr, alt_u8 ControlData){
     bool bSuccess = TRUE;
+    
+    if (i2c_use_queue())
+        return i2c_queued_transfer(clk_base, data_base, DeviceAddr, ControlAddr, FALSE, &ControlData, 1);
     //alt_u8 DeviceAddr;
     
     // device id
@@ -86,7 +167,9 @@ bool I2C_Write(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr, alt_u8 Con
     }
     i2c_stop(clk_base, data_base);
     
-    usleep(7*1000); // delay to wait EE2 ready (at least 5 ms delay is required)
+    // wait until EE2 is ready (write cycle takes up to 5 ms)
+    if (bSuccess)
+        bSuccess = i2c_wait_ready(clk_base, data_base, DeviceAddr);
     
     return bSuccess;
 
@@ -95,6 +178,9 @@ bool I2C_Write(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr, alt_u8 Con
 
 bool I2C_Read(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr, alt_u8 ControlAddr, alt_u8 *pControlData){
     bool bSuccess = TRUE;
+    
+    if (i2c_use_queue())
+        return i2c_queued_transfer(clk_base, data_base, DeviceAddr, ControlAddr, TRUE, pControlData, 1);
     //alt_u8 DeviceAddr;
    
     // device id
@@ -126,6 +212,31 @@ bool I2C_Read(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr, alt_u8 Cont
 
 
 bool I2C_MultipleWrite(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr, alt_u8 ControlAddr, alt_u8 *pData, alt_u16 len){
+    bool bSuccess = TRUE;
+    alt_u16 nWriteLen;
+    
+    // one write (and one write cycle) per page
+    do{
+        nWriteLen = len;
+        if (nPageSize > 0 && nWriteLen > nPageSize - (ControlAddr % nPageSize))
+            nWriteLen = nPageSize - (ControlAddr % nPageSize);
+        if (i2c_use_queue()){
+            // the driver task waits for the write cycle as well
+            bSuccess = i2c_queued_transfer(clk_base, data_base, DeviceAddr, ControlAddr, FALSE, pData, nWriteLen);
+        }else{
+            bSuccess = i2c_write_page(clk_base, data_base, DeviceAddr, ControlAddr, pData, nWriteLen);
+            if (bSuccess)
+                bSuccess = i2c_wait_ready(clk_base, data_base, DeviceAddr);
+        }
+        ControlAddr += nWriteLen;
+        pData += nWriteLen;
+        len -= nWriteLen;
+    }while(len > 0 && bSuccess);
+    
+    return bSuccess;
+}
+
+static bool i2c_write_page(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr, alt_u8 ControlAddr, alt_u8 *pData, alt_u16 len){
     bool bSuccess = TRUE;
     int i;
 
@@ -148,8 +259,6 @@ bool I2C_MultipleWrite(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr, al
     }
     i2c_stop(clk_base, data_base);
     
-    usleep(7*1000); // delay to wait EE2 ready (at least 5 ms delay is required)
-    
     return bSuccess;
 
     
@@ -159,6 +268,9 @@ bool I2C_MultipleRead(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr, alt
     int i;
     bool bSuccess = TRUE;
     
+    if (i2c_use_queue())
+        return i2c_queued_transfer(clk_base, data_base, DeviceAddr, ControlAddr, TRUE, pBuf, len);
+    
    
     // device id
     //DeviceAddr = HMB_E2_I2C_ID;
@@ -274,6 +386,31 @@ bool i2c_write(alt_u32 clk_base, alt_u32 data_base, alt_u8 Data){ // return true
     return bAck;
 }    
 
+// ACK polling: the device does not acknowledge its address until the write cycle is done
+bool i2c_wait_ready(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr){
+    bool bAck;
+    alt_u32 nStart, nTimeout;
+    
+    if (nWriteTimeout == 0)
+        return TRUE;
+    
+    // at least the timeout, regardless of the phase of the system tick
+    nTimeout = nWriteTimeout * alt_ticks_per_second() / 1000 + 1;
+    nStart = alt_nticks();
+    do{
+        i2c_start(clk_base, data_base);
+        bAck = i2c_write(clk_base, data_base, DeviceAddr & 0xFE);
+        i2c_stop(clk_base, data_base);
+        // a task sleeps between the polls
+        if (!bAck && OSRunning && OSIntNesting == 0)
+            OSTimeDly(1);
+    }while(!bAck && (alt_nticks() - nStart) <= nTimeout);
+    
+    if (!bAck)
+        I2C_DEBUG(("I2C Fail: device not ready after write!\n"));
+    return bAck;
+}
+
 void i2c_read(alt_u32 clk_base, alt_u32 data_base, alt_u8 *pData, bool bAck){ // return true if device response ack
     alt_u8 Data=0;
     int i;
@@ -312,6 +449,348 @@ void i2c_read(alt_u32 clk_base, alt_u32 data_base, alt_u8 *pData, bool bAck){ //
     *pData = Data;
 }
 
+//==========================================================
+// bus speed
+
+// clock of the calibration: the timestamp timer, or the system timer if there is none
+static bool bTimestamp = FALSE;
+
+static alt_u32 i2c_clock(void){
+    if (bTimestamp)
+        return alt_timestamp();
+    return alt_nticks();
+}
+
+// duration of one operation (ps): batches of I2C_CALIBRATE_NUM PIO writes or delay loop iterations
+// run for I2C_CALIBRATE_MS at least, starting at an edge of the clock. 0: the clock does not run
+static alt_u32 i2c_measure(alt_u32 clk_base, bool bLoop, alt_u32 Freq){
+    alt_u32 Start, Now, nTicks, nBatch = 0;
+    int i;
+    
+    nTicks = (alt_u32)((alt_u64)Freq * I2C_CALIBRATE_MS / 1000);
+    if (nTicks == 0)
+        nTicks = 1;
+    
+    Start = i2c_clock();
+    while((Now = i2c_clock()) == Start){
+        if (++nBatch > I2C_CALIBRATE_BATCH_MAX * I2C_CALIBRATE_NUM)
+            return 0;
+    }
+    Start = Now;
+    nBatch = 0;
+    do{
+        if (bLoop){
+            i2c_delay_loop(I2C_CALIBRATE_NUM);
+        }else{
+            // SCL idles high, so writing high does not change the bus
+            for(i=0;i<I2C_CALIBRATE_NUM;i++)
+                IOWR_ALTERA_AVALON_PIO_DATA(clk_base, 1);
+        }
+        nBatch++;
+        Now = i2c_clock();
+    }while(Now - Start < nTicks && nBatch < I2C_CALIBRATE_BATCH_MAX);
+    if (Now - Start < nTicks)
+        return 0;
+    
+    return (alt_u32)((alt_u64)(Now - Start) * 1000000000000ULL / ((alt_u64)Freq * nBatch * I2C_CALIBRATE_NUM));
+}
+
+alt_u32 I2C_SetSpeed(alt_u32 clk_base, alt_u32 nSpeedHz){
+    alt_u32 Freq, PioPs;
+    alt_u64 HalfPs;
+    
+    bDelayCalibrated = FALSE;
+    nLoopPs = 0;
+    nBusClock = 0;
+    bTimestamp = (alt_timestamp_start() >= 0);
+    Freq = bTimestamp?alt_timestamp_freq():alt_ticks_per_second();
+    if (Freq == 0)
+        return 0;
+    
+    // cost of the PIO write of a half clock and of one iteration of the delay loop
+    PioPs = i2c_measure(clk_base, FALSE, Freq);
+    nLoopPs = i2c_measure(clk_base, TRUE, Freq);
+    if (nLoopPs == 0){
+        I2C_DEBUG(("I2C: calibration failed, the clock does not run\r\n"));
+        return 0;
+    }
+    
+    // a half clock consists of a PIO write and the delay
+    nDelayLoop = 0;
+    if (nSpeedHz != I2C_SPEED_MAX){
+        HalfPs = 1000000000000ULL / (2 * (alt_u64)nSpeedHz);
+        if (HalfPs > PioPs)
+            nDelayLoop = (alt_u32)((HalfPs - PioPs) / nLoopPs);
+    }
+    bDelayCalibrated = TRUE;
+    
+    // achieved clock: the empty delay costs nothing but the PIO write
+    HalfPs = PioPs + (alt_u64)nDelayLoop * nLoopPs;
+    if (HalfPs == 0)
+        HalfPs = 1;
+    nBusClock = (alt_u32)(1000000000000ULL / (2 * HalfPs));
+    
+    I2C_DEBUG(("I2C: %d loops per half clock, bus clock %d Hz\r\n", (int)nDelayLoop, (int)nBusClock));
+    return nBusClock;
+}
+
+alt_u32 I2C_GetBusClock(void){
+    return nBusClock;
+}
+
+#ifdef I2C_TRACE
+static I2C_TRACE_ENTRY szTrace[I2C_TRACE_SIZE];
+static int nTraceNum = 0;
+
+static void i2c_trace(alt_u8 Line, alt_u8 Value){
+    if (nTraceNum >= I2C_TRACE_SIZE)
+        return;
+    szTrace[nTraceNum].Time = bTimestamp?alt_timestamp():nTraceLoops;
+    szTrace[nTraceNum].Line = Line;
+    szTrace[nTraceNum].Value = Value;
+    nTraceNum++;
+}
+
+int I2C_TraceGet(I2C_TRACE_ENTRY *pTrace, int nMaxEntry){
+    int i, nNum = nTraceNum;
+    if (nNum > nMaxEntry)
+        nNum = nMaxEntry;
+    for(i=0;i<nNum;i++)
+        pTrace[i] = szTrace[i];
+    nTraceNum = 0;
+    nTraceLoops = 0;
+    return nNum;
+}
+
+alt_u32 I2C_TraceFreq(void){
+    if (bTimestamp)
+        return alt_timestamp_freq();
+    if (bDelayCalibrated && nLoopPs > 0)
+        return (alt_u32)(1000000000000ULL / nLoopPs);
+    return 0;
+}
+
+void I2C_TraceDump(void){
+    int i;
+    printf("time,line,value (%lu time steps per second)\r\n", (unsigned long)I2C_TraceFreq());
+    for(i=0;i<nTraceNum;i++)
+        printf("%lu,%d,%d\r\n", (unsigned long)szTrace[i].Time, szTrace[i].Line, szTrace[i].Value);
+    nTraceNum = 0;
+    nTraceLoops = 0;
+}
+#endif
+
+//==========================================================
+// non-blocking transfers
+
+typedef enum{
+        I2C_SLOT_FREE = 0,
+        I2C_SLOT_QUEUED,
+        I2C_SLOT_ACTIVE,
+        I2C_SLOT_DONE,
+        I2C_SLOT_ABANDONED  // waiter timed out, the driver task frees the slot
+}I2C_SLOT_STATE;
+
+typedef struct{
+    volatile I2C_SLOT_STATE State;
+    alt_u32 clk_base;
+    alt_u32 data_base;
+    alt_8 DeviceAddr;
+    alt_u8 ControlAddr;
+    bool bRead;
+    bool bSuccess;
+    alt_u16 len;
+    alt_u8 *pUserData;
+    alt_u8 szData[I2C_MAX_TRANSFER_SIZE];  // copy, so an abandoned transfer does not touch the caller's buffer
+    OS_EVENT *pDoneSem;
+}I2C_SLOT;
+
+static I2C_SLOT szSlot[I2C_QUEUE_SIZE];
+static int nQueueHead = 0;  // next slot for the driver
+static int nQueueTail = 0;  // next slot for I2C_Submit
+static OS_EVENT *pQueueSem = NULL;
+static OS_STK szDriverStk[I2C_DRIVER_STACKSIZE];
+
+// the whole transfer on the bus, with interrupts enabled
+static bool i2c_execute(I2C_SLOT *p){
+    bool bSuccess;
+    alt_u16 i;
+
+    i2c_start(p->clk_base, p->data_base);
+    bSuccess = i2c_write(p->clk_base, p->data_base, p->DeviceAddr & 0xFE);
+    if (bSuccess)
+        bSuccess = i2c_write(p->clk_base, p->data_base, p->ControlAddr);
+    if (bSuccess && p->bRead){
+        i2c_start(p->clk_base, p->data_base);
+        bSuccess = i2c_write(p->clk_base, p->data_base, p->DeviceAddr | 1);
+        for(i=0;i<p->len && bSuccess;i++)
+            i2c_read(p->clk_base, p->data_base, &p->szData[i], (i == p->len-1)?FALSE:TRUE);
+    }else{
+        for(i=0;i<p->len && bSuccess;i++)
+            bSuccess = i2c_write(p->clk_base, p->data_base, p->szData[i]);
+        if (!bSuccess)
+            I2C_DEBUG(("I2C Fail: write NACK!\n"));
+    }
+    i2c_stop(p->clk_base, p->data_base);
+
+    // the write cycle of the device, the driver task sleeps between the polls
+    if (bSuccess && !p->bRead)
+        bSuccess = i2c_wait_ready(p->clk_base, p->data_base, p->DeviceAddr);
+    return bSuccess;
+}
+
+static void i2c_driver_task(void *pdata){
+    I2C_SLOT *pSlot;
+    bool bSuccess, bSkip;
+    INT8U err;
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    while(1){
+        // sleep until a transfer is queued
+        OSSemPend(pQueueSem, 0, &err);
+
+        pSlot = &szSlot[nQueueHead];
+        nQueueHead = (nQueueHead + 1) % I2C_QUEUE_SIZE;
+
+        OS_ENTER_CRITICAL();
+        bSkip = (pSlot->State == I2C_SLOT_ABANDONED);
+        if (bSkip)
+            pSlot->State = I2C_SLOT_FREE;
+        else
+            pSlot->State = I2C_SLOT_ACTIVE;
+        OS_EXIT_CRITICAL();
+        if (bSkip)
+            continue;
+
+        bSuccess = i2c_execute(pSlot);
+
+        // wake up the waiting task
+        OS_ENTER_CRITICAL();
+        bSkip = (pSlot->State == I2C_SLOT_ABANDONED);
+        if (bSkip){
+            pSlot->State = I2C_SLOT_FREE;
+        }else{
+            pSlot->bSuccess = bSuccess;
+            pSlot->State = I2C_SLOT_DONE;
+        }
+        OS_EXIT_CRITICAL();
+        if (!bSkip)
+            OSSemPost(pSlot->pDoneSem);
+    }
+}
+
+bool I2C_AsyncInit(alt_u8 DriverPriority){
+    int i;
+    INT8U err;
+
+    if (bAsyncActive)
+        return TRUE;
+
+    pQueueSem = OSSemCreate(0);
+    if (!pQueueSem)
+        return FALSE;
+    for(i=0;i<I2C_QUEUE_SIZE;i++){
+        szSlot[i].State = I2C_SLOT_FREE;
+        szSlot[i].pDoneSem = OSSemCreate(0);
+        if (!szSlot[i].pDoneSem)
+            return FALSE;
+    }
+    nQueueHead = 0;
+    nQueueTail = 0;
+
+    err = OSTaskCreateExt(i2c_driver_task,
+                          NULL,
+                          (void *) &szDriverStk[I2C_DRIVER_STACKSIZE-1],
+                          DriverPriority,
+                          DriverPriority,
+                          szDriverStk,
+                          I2C_DRIVER_STACKSIZE,
+                          NULL,
+                          0);
+    if (err != OS_NO_ERR)
+        return FALSE;
+
+    bAsyncActive = TRUE;
+    return TRUE;
+}
+
+int I2C_Submit(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr, alt_u8 ControlAddr, bool bRead, alt_u8 *pData, alt_u16 len){
+    I2C_SLOT *pSlot;
+    int nTicket;
+    int i;
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    if (!bAsyncActive || len > I2C_MAX_TRANSFER_SIZE)
+        return -1;
+
+    // fill the next slot, the slots are served in order
+    OS_ENTER_CRITICAL();
+    nTicket = nQueueTail;
+    pSlot = &szSlot[nTicket];
+    if (pSlot->State != I2C_SLOT_FREE){
+        OS_EXIT_CRITICAL();
+        return -1;
+    }
+    pSlot->clk_base = clk_base;
+    pSlot->data_base = data_base;
+    pSlot->DeviceAddr = DeviceAddr;
+    pSlot->ControlAddr = ControlAddr;
+    pSlot->bRead = bRead;
+    pSlot->bSuccess = FALSE;
+    pSlot->len = len;
+    pSlot->pUserData = pData;
+    if (!bRead){
+        for(i=0;i<len;i++)
+            pSlot->szData[i] = pData[i];
+    }
+    pSlot->State = I2C_SLOT_QUEUED;
+    nQueueTail = (nQueueTail + 1) % I2C_QUEUE_SIZE;
+    OS_EXIT_CRITICAL();
+
+    OSSemPost(pQueueSem);
+    return nTicket;
+}
+
+bool I2C_Wait(int Ticket, alt_u16 Timeout){
+    I2C_SLOT *pSlot;
+    bool bSuccess = FALSE;
+    bool bDone;
+    int i;
+    INT8U err;
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    if (Ticket < 0 || Ticket >= I2C_QUEUE_SIZE)
+        return FALSE;
+    pSlot = &szSlot[Ticket];
+
+    OSSemPend(pSlot->pDoneSem, Timeout, &err);
+
+    OS_ENTER_CRITICAL();
+    bDone = (pSlot->State == I2C_SLOT_DONE);
+    if (!bDone)
+        pSlot->State = I2C_SLOT_ABANDONED;
+    OS_EXIT_CRITICAL();
+
+    if (bDone){
+        // the transfer may have finished just after the timeout
+        OSSemAccept(pSlot->pDoneSem);
+        bSuccess = pSlot->bSuccess;
+        if (bSuccess && pSlot->bRead){
+            for(i=0;i<pSlot->len;i++)
+                pSlot->pUserData[i] = pSlot->szData[i];
+        }
+        pSlot->State = I2C_SLOT_FREE;
+    }
+
+    return bSuccess;
+}
+
 //==========================================================
 // function for verify
 
@@ -42,4 +42,51 @@ bool I2C_MultipleWrite(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr, al
 //
 bool I2C_Verify(alt_u32 scl_base, alt_u32 sda_base, alt_u32 size);
 
+// bus speed, the delay between the edges is calibrated against the timestamp timer, or the
+// system timer if there is no timestamp timer: the PIO writes and the iterations of the delay
+// loop are counted over I2C_CALIBRATE_MS (interrupts have to be enabled).
+// Without calibration every half clock is delayed by usleep(1).
+#define I2C_CALIBRATE_MS        4       // length of a measurement
+#define I2C_CALIBRATE_NUM       256     // operations per batch of a measurement
+#define I2C_CALIBRATE_BATCH_MAX 100000  // the clock does not run, calibration failed
+#define I2C_SPEED_STANDARD  100000
+#define I2C_SPEED_FAST      400000
+#define I2C_SPEED_MAX       0       // no delay, as fast as the PIO allows
+alt_u32 I2C_SetSpeed(alt_u32 clk_base, alt_u32 nSpeedHz); // return achieved bus clock in Hz, 0: not calibrated
+alt_u32 I2C_GetBusClock(void);  // achieved bus clock in Hz, 0: not calibrated
+
+// end of the write cycle: after a write the device is polled until it acknowledges its address
+#define I2C_WRITE_TIMEOUT_DEFAULT   10  // ms, EEPROMs need up to 5 ms
+void I2C_SetWriteTimeout(alt_u32 nTimeoutMs); // 0: do not wait for the device
+// I2C_MultipleWrite splits the data at the page boundaries of an EEPROM (0: no splitting, default)
+void I2C_SetPageSize(alt_u16 nPageSize);
+
+// non-blocking transfers: a driver task executes the queued transfers, so the requesting task
+// sleeps during the transfer. The driver bit-bangs a whole transfer with interrupts enabled
+// (about 20 half clocks per byte) and sleeps between the polls of the write cycle, so it should
+// have a low priority. Once I2C_AsyncInit has been called, the blocking functions above use the
+// queue as well (when called from a task): they split transfers larger than I2C_MAX_TRANSFER_SIZE
+// and sleep while the queue is full.
+#define I2C_QUEUE_SIZE          4   // maximum number of queued transfers
+#define I2C_MAX_TRANSFER_SIZE   32  // maximum number of data bytes per queued transfer
+#define I2C_DRIVER_STACKSIZE    512
+bool I2C_AsyncInit(alt_u8 DriverPriority);  // call after OSInit()
+int  I2C_Submit(alt_u32 clk_base, alt_u32 data_base, alt_8 DeviceAddr, alt_u8 ControlAddr, bool bRead, alt_u8 *pData, alt_u16 len); // return ticket, -1: queue full
+bool I2C_Wait(int Ticket, alt_u16 Timeout);  // Timeout in OS ticks, 0: forever. Read data is copied to pData of I2C_Submit
+
+// log of the edges on the bus (compile with -DI2C_TRACE), to check the timing offline.
+// Without timestamp timer the time counts the iterations of the delay loop since the log has
+// been cleared (not calibrated: the number of delays), PIO writes take no time then.
+#ifdef I2C_TRACE
+#define I2C_TRACE_SIZE  1024
+typedef struct{
+    alt_u32 Time;   // alt_timestamp ticks or delay loop iterations
+    alt_u8 Line;    // 0: SCL, 1: SDA, 2: SDA direction
+    alt_u8 Value;
+}I2C_TRACE_ENTRY;
+int I2C_TraceGet(I2C_TRACE_ENTRY *pTrace, int nMaxEntry);  // return number of entries, clears the log
+alt_u32 I2C_TraceFreq(void);  // time steps per second, 0: unknown (not calibrated)
+void I2C_TraceDump(void);  // print the log as CSV: time,line,value
+#endif
+
 #endif /*I2C_H_*/
@@ -91,9 +91,91 @@ bool ADXL345_SPI_XYZ_Read(alt_u32 device_base, alt_u16 szData16[3]){
     return bPass;
 }
 
+// INT_SOURCE (0x30) .. DATAZ1 (0x37) are contiguous: read status and data in one burst
+// the data is only valid if XL345_DATAREADY is set in *pIntSource
+bool ADXL345_SPI_ReadStatusAndXYZ(alt_u32 device_base, alt_u8 *pIntSource, alt_u16 szData16[3]){
+    bool bPass;
+    alt_u8 szData8[8];
+    bPass = SPI_MultipleRead(device_base, ADXL345_REG_INT_SOURCE, (alt_u8 *)&szData8, sizeof(szData8));
+    if (bPass){
+        // szData8[1] is DATA_FORMAT
+        *pIntSource = szData8[0];
+        szData16[0] = (szData8[3] << 8) | szData8[2]; 
+        szData16[1] = (szData8[5] << 8) | szData8[4];
+        szData16[2] = (szData8[7] << 8) | szData8[6];
+    }        
+    
+    return bPass;
+}
+
 bool ADXL345_SPI_IdRead(alt_u32 device_base, alt_u8 *pId){
     bool bPass;
     bPass = SPI_Read(device_base, ADXL345_REG_DEVID, pId);
     
     return bPass;
 }
+
+
+bool ADXL345_SPI_FifoInit(alt_u32 device_base, alt_u8 Rate, alt_u8 Watermark){
+    bool bSuccess;
+    
+    // stop measure
+    bSuccess = SPI_Write(device_base, ADXL345_REG_POWER_CTL, XL345_STANDBY);
+    
+    // Output Data Rate
+    if (bSuccess){
+        bSuccess = SPI_Write(device_base, ADXL345_REG_BW_RATE, Rate);
+    }
+    
+    // stream mode: the oldest samples are dropped when the fifo is full
+    if (bSuccess){
+        bSuccess = SPI_Write(device_base, ADXL345_REG_FIFO_CTL, XL345_FIFO_MODE_STREAM | (Watermark & XL345_FIFO_SAMPLES_MASK));
+    }
+    
+    //INT_Enable: Data Ready, Watermark, Overrun
+    if (bSuccess){
+        bSuccess = SPI_Write(device_base, ADXL345_REG_INT_ENALBE, XL345_DATAREADY | XL345_WATERMARK | XL345_OVERRUN);
+    }
+    
+    // start measure
+    if (bSuccess){
+        bSuccess = SPI_Write(device_base, ADXL345_REG_POWER_CTL, XL345_MEASURE);
+    }
+    
+    return bSuccess;
+}
+
+bool ADXL345_SPI_FifoEntries(alt_u32 device_base, alt_u8 *pEntries){
+    bool bPass;
+    alt_u8 data8;
+    
+    bPass = SPI_Read(device_base, ADXL345_REG_FIFO_STATUS, &data8);
+    if (bPass)
+        *pEntries = data8 & XL345_FIFO_ENTRIES_MASK;
+    
+    return bPass;
+}
+
+// read all samples that are queued in the fifo (at most nMaxSample)
+// the entries are read only once, every sample costs one burst read of DATAX0..DATAZ1
+bool ADXL345_SPI_FifoRead(alt_u32 device_base, alt_u16 szData16[][3], alt_u8 nMaxSample, alt_u8 *pSampleNum){
+    bool bPass;
+    alt_u8 nEntries = 0;
+    int i;
+    
+    bPass = ADXL345_SPI_FifoEntries(device_base, &nEntries);
+    if (bPass && nEntries > nMaxSample)
+        nEntries = nMaxSample;
+    
+    for(i=0;i<nEntries;i++){
+        if (!ADXL345_SPI_XYZ_Read(device_base, szData16[i]))
+            break;
+    }
+    
+    // number of samples that have been read successfully
+    *pSampleNum = i;
+    if (bPass && i < nEntries)
+        bPass = FALSE;
+    
+    return bPass;
+}
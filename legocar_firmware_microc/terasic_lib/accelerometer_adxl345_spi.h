@@ -63,6 +63,20 @@
 #define XL345_ACT_INACT_SERIAL     0x20
 #define XL345_ACT_INACT_CONCURRENT 0x00
 
+/* Bit values in FIFO_CTL                                               */
+#define XL345_FIFO_MODE_BYPASS     0x00
+#define XL345_FIFO_MODE_FIFO       0x40
+#define XL345_FIFO_MODE_STREAM     0x80
+#define XL345_FIFO_MODE_TRIGGER    0xc0
+#define XL345_FIFO_SAMPLES_MASK    0x1f
+
+/* Bit values in FIFO_STATUS                                            */
+#define XL345_FIFO_ENTRIES_MASK    0x3f
+#define XL345_FIFO_TRIG            0x80
+
+/* 32 samples in the FIFO + 1 sample in the data registers              */
+#define XL345_FIFO_MAX_ENTRIES     33
+
 // Register List
 #define ADXL345_REG_DEVID       0x00
 #define ADXL345_REG_POWER_CTL   0x2D
@@ -79,12 +93,19 @@
 #define ADXL345_REG_DATAY1      0x35  // read only
 #define ADXL345_REG_DATAZ0      0x36  // read only
 #define ADXL345_REG_DATAZ1      0x37  // read only
+#define ADXL345_REG_FIFO_STATUS 0x39  // read only
 
      
 bool ADXL345_SPI_Init(alt_u32 device_base);
 bool ADXL345_SPI_IsDataReady(alt_u32 device_base);
 bool ADXL345_SPI_XYZ_Read(alt_u32 device_base, alt_u16 szData16[3]);
+bool ADXL345_SPI_ReadStatusAndXYZ(alt_u32 device_base, alt_u8 *pIntSource, alt_u16 szData16[3]);
 bool ADXL345_SPI_IdRead(alt_u32 device_base, alt_u8 *pId);
 
+// FIFO in stream mode: the sensor keeps the latest samples, they are read in one pass
+bool ADXL345_SPI_FifoInit(alt_u32 device_base, alt_u8 Rate, alt_u8 Watermark);
+bool ADXL345_SPI_FifoEntries(alt_u32 device_base, alt_u8 *pEntries);
+bool ADXL345_SPI_FifoRead(alt_u32 device_base, alt_u16 szData16[][3], alt_u8 nMaxSample, alt_u8 *pSampleNum);
+
 
 #endif /*ACCELEROMETER_ADXL345_SPI_H_*/
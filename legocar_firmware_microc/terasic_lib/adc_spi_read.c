@@ -1,33 +1,274 @@
 #include "terasic_includes.h"
 #include "adc_spi_read.h"
+#include "includes.h"  // uC/OS-II: critical sections
 
 #define START_FLAG  0x8000
 #define DONE_FLAG   0x8000
+#define VALUE_MASK  0x0FFF  // 12 bits
+
+#define ADC_READ_TIMEOUT    2  // ticks
+
+#define RING_MASK   (ADC_RING_SIZE - 1)
+
+#if (ADC_RING_SIZE & RING_MASK) != 0
+#error ADC_RING_SIZE has to be a power of two
+#endif
+
+typedef struct{
+    volatile ADC_SAMPLE szRing[ADC_RING_SIZE];
+    volatile alt_u32 nHead;  // number of samples written (free running, slot: nHead & RING_MASK)
+    alt_u16 nDecimation;
+    alt_u16 nSumCnt;
+    alt_u32 nSum;
+}ADC_CHANNEL;
+
+static ADC_CHANNEL szAdcChannel[ADC_CHANNEL_NUM];
+static bool bScanActive = FALSE;
+static alt_alarm adc_alarm;
+
+// state of the scan (only used in the interrupt while scanning)
+static alt_u8 szScanChannel[ADC_CHANNEL_NUM];
+static int nScanNum;
+static int nScanIndex;          // next channel in szScanChannel
+static int nConversionPerTick;
+static bool bPending;           // a conversion has been started
+static bool bPrimed;            // the pending conversion returns the value of ResultChannel
+static alt_u8 ResultChannel;    // channel converted in the pending transaction
+static alt_u8 SentChannel;      // channel sent with the pending transaction (converted in the next one)
+static ADC_SCAN_STATS ScanStats;
+
+// the value is converted in the transaction following the one that selected the channel
+static void adc_start(alt_u8 NextChannel){
+    IOWR(ADC_SPI_READ_BASE, 0, NextChannel);
+    IOWR(ADC_SPI_READ_BASE, 0, NextChannel | START_FLAG);
+}
+
+static void adc_stop(void){
+    IOWR(ADC_SPI_READ_BASE, 0, 0);
+}
+
+static void adc_push(alt_u8 Channel, alt_u16 Value){
+    ADC_CHANNEL *pCh = &szAdcChannel[Channel];
+    volatile ADC_SAMPLE *pSlot;
+
+    pCh->nSum += Value;
+    if (++pCh->nSumCnt < pCh->nDecimation)
+        return;
+
+    // write the slot before publishing it with the head
+    pSlot = &pCh->szRing[pCh->nHead & RING_MASK];
+    pSlot->Timestamp = alt_nticks();
+    pSlot->Value = (pCh->nSumCnt == 1)?pCh->nSum:(pCh->nSum / pCh->nSumCnt);
+    pCh->nHead++;
+    pCh->nSum = 0;
+    pCh->nSumCnt = 0;
+}
+
+// finish the pending conversion and start the next one, FALSE: the conversion is not done yet
+static bool adc_scan_step(void){
+    alt_u16 Data16;
+    int nPoll = 0;
+
+    if (bPending){
+        // the conversion has been started in the previous step, usually it is done already
+        do{
+            Data16 = IORD(ADC_SPI_READ_BASE, 0);
+        }while(!(Data16 & DONE_FLAG) && ++nPoll < ADC_POLL_MAX);
+        if (nPoll > ScanStats.nPollMax)
+            ScanStats.nPollMax = nPoll;
+        if (!(Data16 & DONE_FLAG)){
+            ScanStats.nBusy++;
+            return FALSE;
+        }
+        adc_stop();
+        ScanStats.nConversion++;
+        if (bPrimed)
+            adc_push(ResultChannel, Data16 & VALUE_MASK);
+        // the first conversion returns the channel selected before the scan, it is discarded
+        ResultChannel = SentChannel;
+        bPrimed = TRUE;
+    }
+
+    SentChannel = szScanChannel[nScanIndex];
+    if (++nScanIndex >= nScanNum)
+        nScanIndex = 0;
+    adc_start(SentChannel);
+    bPending = TRUE;
+    return TRUE;
+}
+
+static alt_u32 adc_alarm_callback(void *context){
+    int i;
+    for(i=0;i<nConversionPerTick;i++){
+        if (!adc_scan_step())
+            break;
+    }
+    return 1;  // again in the next tick
+}
 
 alt_u16 ADC_Read(alt_u8 NextChannel){
     alt_u16 Data16, DigitalValue = 0;
     bool bDone = FALSE;
-    const int nMaxWait = 1000;
-    int nWaitCnt = 0;
-    
+    alt_u32 nStart;
+
+    if (bScanActive)
+        return 0;
+
     // start
-    Data16 = NextChannel;
-    IOWR(ADC_SPI_READ_BASE, 0, Data16);
-    Data16 |= START_FLAG;
-    IOWR(ADC_SPI_READ_BASE, 0, Data16);
-    usleep(10000); // wait 10ms
-    
-    // wait done
-    while(!bDone && nWaitCnt++ <= nMaxWait){
+    adc_start(NextChannel);
+
+    // wait done (a conversion takes some microseconds)
+    nStart = alt_nticks();
+    do{
         Data16 = IORD(ADC_SPI_READ_BASE,0);
         bDone = (Data16 & DONE_FLAG)?TRUE:FALSE;
-    }
-    
+    }while(!bDone && (alt_nticks() - nStart) <= ADC_READ_TIMEOUT);
+
     if (bDone)
-        DigitalValue = Data16 & 0xFFF; // 12 bits
-    
+        DigitalValue = Data16 & VALUE_MASK;
+
     // stop
-    IOWR(ADC_SPI_READ_BASE, 0, 0);
-    
+    adc_stop();
+
     return DigitalValue;
 }
+
+//===== continuous scanning
+
+bool ADC_ScanStart(const alt_u8 *szChannel, int nChannelNum, int nConvPerTick){
+    int i;
+
+    if (nChannelNum <= 0 || nChannelNum > ADC_CHANNEL_NUM || nConvPerTick <= 0)
+        return FALSE;
+    for(i=0;i<nChannelNum;i++){
+        if (szChannel[i] >= ADC_CHANNEL_NUM)
+            return FALSE;
+    }
+
+    ADC_ScanStop();
+
+    for(i=0;i<ADC_CHANNEL_NUM;i++){
+        if (szAdcChannel[i].nDecimation == 0)
+            szAdcChannel[i].nDecimation = 1;
+        szAdcChannel[i].nSum = 0;
+        szAdcChannel[i].nSumCnt = 0;
+    }
+    memcpy(szScanChannel, szChannel, nChannelNum);
+    nScanNum = nChannelNum;
+    nScanIndex = 0;
+    nConversionPerTick = nConvPerTick;
+    bPending = FALSE;
+    bPrimed = FALSE;
+    memset(&ScanStats, 0, sizeof(ScanStats));
+
+    if (alt_alarm_start(&adc_alarm, 1, adc_alarm_callback, NULL) < 0)
+        return FALSE;
+
+    bScanActive = TRUE;
+    return TRUE;
+}
+
+void ADC_ScanStop(void){
+    if (!bScanActive)
+        return;
+    alt_alarm_stop(&adc_alarm);
+    adc_stop();
+    bScanActive = FALSE;
+}
+
+void ADC_SetDecimation(alt_u8 Channel, alt_u16 nDecimation){
+    ADC_CHANNEL *pCh;
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    if (Channel >= ADC_CHANNEL_NUM)
+        return;
+    pCh = &szAdcChannel[Channel];
+
+    OS_ENTER_CRITICAL();
+    pCh->nDecimation = (nDecimation == 0)?1:nDecimation;
+    pCh->nSum = 0;
+    pCh->nSumCnt = 0;
+    OS_EXIT_CRITICAL();
+}
+
+bool ADC_GetLatest(alt_u8 Channel, ADC_SAMPLE *pSample){
+    ADC_CHANNEL *pCh;
+    volatile ADC_SAMPLE *pSlot;
+    alt_u32 nHead;
+
+    if (Channel >= ADC_CHANNEL_NUM)
+        return FALSE;
+    pCh = &szAdcChannel[Channel];
+
+    // the interrupt only writes to the slot behind the head, so the copy is torn only
+    // if it went round the whole ring meanwhile
+    do{
+        nHead = pCh->nHead;
+        if (nHead == 0)
+            return FALSE;
+        pSlot = &pCh->szRing[(nHead - 1) & RING_MASK];
+        pSample->Timestamp = pSlot->Timestamp;
+        pSample->Value = pSlot->Value;
+    }while(pCh->nHead - nHead >= ADC_RING_SIZE - 1);
+
+    return TRUE;
+}
+
+int ADC_GetSamples(alt_u8 Channel, alt_u32 *pPos, ADC_SAMPLE szSample[], int nMaxNum, alt_u32 *pLost){
+    ADC_CHANNEL *pCh;
+    volatile ADC_SAMPLE *pSlot;
+    alt_u32 nHead, nPos, nLost = 0, nOver;
+    int i, nNum;
+
+    if (pLost)
+        *pLost = 0;
+    if (Channel >= ADC_CHANNEL_NUM || nMaxNum <= 0)
+        return 0;
+    pCh = &szAdcChannel[Channel];
+
+    nHead = pCh->nHead;
+    nPos = *pPos;
+    if (nHead - nPos > ADC_RING_SIZE){
+        // overwritten before they have been read
+        nLost = nHead - ADC_RING_SIZE - nPos;
+        nPos = nHead - ADC_RING_SIZE;
+    }
+    nNum = nHead - nPos;
+    if (nNum > nMaxNum)
+        nNum = nMaxNum;
+
+    for(i=0;i<nNum;i++){
+        pSlot = &pCh->szRing[(nPos + i) & RING_MASK];
+        szSample[i].Timestamp = pSlot->Timestamp;
+        szSample[i].Value = pSlot->Value;
+    }
+
+    // drop the samples that have been overwritten while copying
+    nHead = pCh->nHead;
+    if (nHead - nPos > ADC_RING_SIZE){
+        nOver = nHead - ADC_RING_SIZE - nPos;
+        if (nOver > (alt_u32)nNum)
+            nOver = nNum;
+        memmove(szSample, szSample + nOver, (nNum - nOver) * sizeof(ADC_SAMPLE));
+        nNum -= nOver;
+        nLost += nOver;
+        nPos += nOver;
+    }
+
+    *pPos = nPos + nNum;
+    if (pLost)
+        *pLost = nLost;
+    return nNum;
+}
+
+void ADC_GetScanStats(ADC_SCAN_STATS *pStats){
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    OS_ENTER_CRITICAL();
+    *pStats = ScanStats;
+    OS_EXIT_CRITICAL();
+}
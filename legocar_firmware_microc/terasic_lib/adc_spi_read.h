@@ -1,6 +1,34 @@
 #ifndef ADC_SPI_READ_H_
 #define ADC_SPI_READ_H_
 
-alt_u16 ADC_Read(alt_u8 NextChannel);
+alt_u16 ADC_Read(alt_u8 NextChannel);  // return the value of the channel selected by the previous call, 0: timeout or scanning
+
+//===== continuous scanning
+// The system timer interrupt reads the finished conversion and starts the next one in every
+// tick, round robin over the configured channels. The ADC converts the channel selected in the
+// previous conversion, so the channel of the next conversion is sent with the current one and
+// no conversion is wasted. The samples are kept in a ring buffer per channel, which the tasks
+// read without locking.
+#define ADC_CHANNEL_NUM         8
+#define ADC_RING_SIZE           64      // samples per channel (power of two)
+#define ADC_POLL_MAX            100     // polls of the done flag per conversion in the interrupt
+
+typedef struct{
+    alt_u32 Timestamp;      // alt_nticks of the last conversion
+    alt_u16 Value;          // 12 bits, average over the decimation
+}ADC_SAMPLE;
+
+typedef struct{
+    alt_u32 nConversion;    // finished conversions
+    alt_u32 nBusy;          // done flag not set after ADC_POLL_MAX polls (tried again in the next tick)
+    alt_u32 nPollMax;
+}ADC_SCAN_STATS;
+
+bool ADC_ScanStart(const alt_u8 *szChannel, int nChannelNum, int nConvPerTick);  // nChannelNum <= ADC_CHANNEL_NUM
+void ADC_ScanStop(void);
+void ADC_SetDecimation(alt_u8 Channel, alt_u16 nDecimation);  // a sample is the average of nDecimation conversions (default 1)
+bool ADC_GetLatest(alt_u8 Channel, ADC_SAMPLE *pSample);  // FALSE: no sample yet
+int  ADC_GetSamples(alt_u8 Channel, alt_u32 *pPos, ADC_SAMPLE szSample[], int nMaxNum, alt_u32 *pLost);  // samples after *pPos (start with 0), return the number, pLost: overwritten samples (may be NULL)
+void ADC_GetScanStats(ADC_SCAN_STATS *pStats);
 
 #endif /*ADC_SPI_READ_H_*/
@@ -32,6 +32,8 @@
 
 #include "terasic_includes.h"
 #include "flash.h"
+#include "includes.h"  // uC/OS-II: critical sections and memory partitions
+#include "../common/crc32.h"
 
 
 #ifdef DEBUG_FLASH
@@ -40,12 +42,257 @@
     #define FLASH_DEBUG(x)
 #endif
 
+// index of a region, built by Flash_Open (offsets counted from the start of the first region)
 typedef struct{
+    alt_u32 offset;         // offset of the first block
+    alt_u32 block_size;
+    alt_u16 first_block;    // index of the first block
+    alt_u16 number_of_blocks;
+}FLASH_REGION_INDEX;
+
+typedef struct{
+    bool bUsed;             // the entry of the handle pool is taken
     alt_flash_fd* fd_flash;
     flash_region *regions_flash;
     int number_of_regions_flash;
+    FLASH_REGION_INDEX region_index[ALT_MAX_NUMBER_OF_FLASH_REGIONS];
+    alt_u16 block_count;
+    alt_u32 size;
 }FLASH_INFO;
 
+//===== handle pool and buffers
+static FLASH_INFO szHandle[FLASH_HANDLE_NUM];
+static OS_MEM *pBufferPartition;
+static alt_u32 nBufferPartitionSize;
+static FLASH_ALLOC_STATS AllocStats;
+
+static FLASH_INFO *flash_handle_get(void){
+    FLASH_INFO *pFlash = NULL;
+    int i;
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    OS_ENTER_CRITICAL();
+    for(i=0;i<FLASH_HANDLE_NUM && !pFlash;i++){
+        if (!szHandle[i].bUsed){
+            pFlash = &szHandle[i];
+            pFlash->bUsed = TRUE;
+        }
+    }
+    if (pFlash){
+        AllocStats.nHandleUsed++;
+        if (AllocStats.nHandleUsed > AllocStats.nHandleMax)
+            AllocStats.nHandleMax = AllocStats.nHandleUsed;
+    }else{
+        AllocStats.nHandleFail++;
+    }
+    OS_EXIT_CRITICAL();
+    return pFlash;
+}
+
+static void flash_handle_put(FLASH_INFO *pFlash){
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    OS_ENTER_CRITICAL();
+    pFlash->bUsed = FALSE;
+    AllocStats.nHandleUsed--;
+    OS_EXIT_CRITICAL();
+}
+
+static alt_u8 *flash_buffer_get(void){
+    alt_u8 *pBuf = NULL;
+    INT8U err;
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    if (pBufferPartition){
+        pBuf = (alt_u8 *)OSMemGet(pBufferPartition, &err);
+        if (err != OS_NO_ERR)
+            pBuf = NULL;
+    }
+    OS_ENTER_CRITICAL();
+    if (pBuf){
+        AllocStats.nBufferUsed++;
+        if (AllocStats.nBufferUsed > AllocStats.nBufferMax)
+            AllocStats.nBufferMax = AllocStats.nBufferUsed;
+    }else{
+        AllocStats.nBufferFail++;
+    }
+    OS_EXIT_CRITICAL();
+    return pBuf;
+}
+
+static void flash_buffer_put(alt_u8 *pBuf){
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    OSMemPut(pBufferPartition, pBuf);
+    OS_ENTER_CRITICAL();
+    AllocStats.nBufferUsed--;
+    OS_EXIT_CRITICAL();
+}
+
+void Flash_SetBufferPartition(OS_MEM *pPartition, alt_u32 nBufSize){
+    pBufferPartition = pPartition;
+    nBufferPartitionSize = nBufSize;
+}
+
+void Flash_GetAllocStats(FLASH_ALLOC_STATS *pStats){
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    OS_ENTER_CRITICAL();
+    *pStats = AllocStats;
+    OS_EXIT_CRITICAL();
+}
+
+static bool flash_build_index(FLASH_INFO *pFlash){
+    flash_region *nextreg = pFlash->regions_flash;
+    FLASH_REGION_INDEX *pIndex = pFlash->region_index;
+    alt_u32 offset = 0;
+    alt_u16 block_count = 0;
+    int r;
+    
+    if (pFlash->number_of_regions_flash > ALT_MAX_NUMBER_OF_FLASH_REGIONS)
+        return FALSE;
+    
+    for(r=0;r<pFlash->number_of_regions_flash;r++){
+        pIndex->offset = offset;
+        pIndex->block_size = nextreg->block_size;
+        pIndex->first_block = block_count;
+        pIndex->number_of_blocks = nextreg->number_of_blocks;
+        offset += nextreg->block_size * nextreg->number_of_blocks;
+        block_count += nextreg->number_of_blocks;
+        pIndex++;
+        nextreg++;
+    }
+    pFlash->block_count = block_count;
+    pFlash->size = offset;
+    return TRUE;
+}
+
+// binary search: last region whose first block is <= block_index
+static FLASH_REGION_INDEX *flash_region_of_block(FLASH_INFO *pFlash, alt_u16 block_index){
+    int lo = 0, hi = pFlash->number_of_regions_flash - 1, mid;
+    
+    if (block_index >= pFlash->block_count)
+        return NULL;
+    while(lo < hi){
+        mid = (lo + hi + 1) / 2;
+        if (pFlash->region_index[mid].first_block <= block_index)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return &pFlash->region_index[lo];
+}
+
+// binary search: last region whose offset is <= offset
+static FLASH_REGION_INDEX *flash_region_of_offset(FLASH_INFO *pFlash, alt_u32 offset){
+    int lo = 0, hi = pFlash->number_of_regions_flash - 1, mid;
+    
+    if (offset >= pFlash->size)
+        return NULL;
+    while(lo < hi){
+        mid = (lo + hi + 1) / 2;
+        if (pFlash->region_index[mid].offset <= offset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    return &pFlash->region_index[lo];
+}
+
+//===== read cache
+typedef struct{
+    alt_flash_fd* fd_flash;     // NULL: the line is empty
+    alt_u32 offset;             // offset of the line in the flash
+    alt_u32 LastUse;            // value of nCacheClock at the last use, 0: empty
+    alt_u8 szData[FLASH_CACHE_LINE_SIZE];
+}FLASH_CACHE_LINE;
+
+// not guarded: the callers of Flash_Read/Write/Erase hold a lock (see flash.h)
+static FLASH_CACHE_LINE szCacheLine[FLASH_CACHE_LINE_NUM];
+static alt_u32 nCacheClock;
+static FLASH_CACHE_STATS CacheStats;
+
+// find the line, or read it from the flash into the least recently used line
+static FLASH_CACHE_LINE *flash_cache_line(FLASH_INFO *pFlash, alt_u32 line_offset){
+    FLASH_CACHE_LINE *pLine, *pVictim = &szCacheLine[0];
+    int i;
+    
+    for(i=0;i<FLASH_CACHE_LINE_NUM;i++){
+        pLine = &szCacheLine[i];
+        if (pLine->fd_flash == pFlash->fd_flash && pLine->offset == line_offset){
+            CacheStats.nHit++;
+            pLine->LastUse = ++nCacheClock;
+            return pLine;
+        }
+        if (pLine->LastUse < pVictim->LastUse)
+            pVictim = pLine;
+    }
+    
+    CacheStats.nMiss++;
+    pVictim->fd_flash = NULL;
+    pVictim->LastUse = 0;
+    if (alt_read_flash(pFlash->fd_flash, line_offset, pVictim->szData, FLASH_CACHE_LINE_SIZE) != 0)
+        return NULL;
+    pVictim->fd_flash = pFlash->fd_flash;
+    pVictim->offset = line_offset;
+    pVictim->LastUse = ++nCacheClock;
+    return pVictim;
+}
+
+// drop the lines overlapping [offset, offset+size)
+static void flash_cache_invalidate(FLASH_INFO *pFlash, alt_u32 offset, alt_u32 size){
+    FLASH_CACHE_LINE *pLine;
+    int i;
+    
+    for(i=0;i<FLASH_CACHE_LINE_NUM;i++){
+        pLine = &szCacheLine[i];
+        if (pLine->fd_flash == pFlash->fd_flash && pLine->offset < offset + size && pLine->offset + FLASH_CACHE_LINE_SIZE > offset){
+            pLine->fd_flash = NULL;
+            pLine->LastUse = 0;
+            CacheStats.nInvalidate++;
+        }
+    }
+}
+
+void Flash_InvalidateCache(void){
+    int i;
+    for(i=0;i<FLASH_CACHE_LINE_NUM;i++){
+        szCacheLine[i].fd_flash = NULL;
+        szCacheLine[i].LastUse = 0;
+    }
+}
+
+void Flash_GetCacheStats(FLASH_CACHE_STATS *pStats){
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    // consistent copy, while a task holding the lock updates the counters
+    OS_ENTER_CRITICAL();
+    *pStats = CacheStats;
+    OS_EXIT_CRITICAL();
+}
+
+void Flash_ResetCacheStats(void){
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    OS_ENTER_CRITICAL();
+    memset(&CacheStats, 0, sizeof(CacheStats));
+    OS_EXIT_CRITICAL();
+}
+
 
 
 bool Flash_InfoDump(char *pFlashName){
@@ -94,17 +341,23 @@ FLASH_HANDLE Flash_Open(char *pFlashName){
     bool bSuccess = FALSE;
     FLASH_INFO *pFlash=NULL;
     
-    pFlash = (FLASH_INFO *)malloc(sizeof(FLASH_INFO));
+    pFlash = flash_handle_get();
+    if (!pFlash){
+        FLASH_DEBUG(("Flash_Open fail, all %d handles are open\r\n", FLASH_HANDLE_NUM));
+        return NULL;
+    }
     pFlash->fd_flash = alt_flash_open_dev(pFlashName);
     if (pFlash->fd_flash){
         error_code = alt_get_flash_info(pFlash->fd_flash,&pFlash->regions_flash,&pFlash->number_of_regions_flash);
         if (error_code == 0){
-            bSuccess = TRUE;
+            bSuccess = flash_build_index(pFlash);
         }            
+        if (!bSuccess)
+            alt_flash_close_dev(pFlash->fd_flash);
     }
     
     if (!bSuccess){
-        free(pFlash);
+        flash_handle_put(pFlash);
         pFlash= NULL;
     }        
     return pFlash;
@@ -113,54 +366,79 @@ FLASH_HANDLE Flash_Open(char *pFlashName){
 
 bool Flash_Close(FLASH_HANDLE Handle){
     FLASH_INFO *pFlash = (FLASH_INFO *)Handle;
+    if (!pFlash || !pFlash->bUsed)
+        return FALSE;
     if (pFlash->fd_flash){
         alt_flash_close_dev(pFlash->fd_flash);
+        pFlash->fd_flash = NULL;
     }
-    free(Handle);
+    flash_handle_put(pFlash);
     return TRUE;
 }
 
 bool Flash_GetBlockInfo(FLASH_HANDLE Handle, alt_u16 block_index, alt_32 *poffset, alt_32 *psize){
     FLASH_INFO *pFlash = (FLASH_INFO *)Handle;
-    alt_u32 offset=0, length;        
-    int r, i, block_count=0;
-    flash_region *nextreg = pFlash->regions_flash;
-    bool bFind = FALSE;
+    FLASH_REGION_INDEX *pRegion;
     
     if (!pFlash->fd_flash)
         return FALSE;
     
+    pRegion = flash_region_of_block(pFlash, block_index);
+    if (!pRegion)
+        return FALSE;
     
-    for(r=0;r<pFlash->number_of_regions_flash && !bFind;r++){
-        for(i=0;i<nextreg->number_of_blocks;i++){
-            if (block_count == block_index){
-                bFind = TRUE;
-                length = nextreg->block_size;
-            }else{
-                offset += nextreg->block_size;
-                block_count++;
-            }
-        }
-        nextreg++;
-    }    
-    if (bFind){
-        *poffset = offset;
-        *psize = length;
-    }
+    *poffset = pRegion->offset + (block_index - pRegion->first_block) * pRegion->block_size;
+    *psize = pRegion->block_size;
+    return TRUE;
     
-    return bFind;
+}
+
+bool Flash_GetBlockIndex(FLASH_HANDLE Handle, alt_u32 offset, alt_u16 *pblock_index){
+    FLASH_INFO *pFlash = (FLASH_INFO *)Handle;
+    FLASH_REGION_INDEX *pRegion;
+    
+    if (!pFlash->fd_flash)
+        return FALSE;
     
+    pRegion = flash_region_of_offset(pFlash, offset);
+    if (!pRegion)
+        return FALSE;
+    
+    *pblock_index = pRegion->first_block + (offset - pRegion->offset) / pRegion->block_size;
+    return TRUE;
 }
 
 bool Flash_Read(FLASH_HANDLE Handle, alt_u32 offset, alt_u8 *szBuf, alt_u32 size){
     FLASH_INFO *pFlash = (FLASH_INFO *)Handle;
+    FLASH_CACHE_LINE *pLine;
+    alt_u32 line_offset, read_size;
     int error_code;
     if (!pFlash->fd_flash)
         return FALSE;
-    error_code = alt_read_flash(pFlash->fd_flash, offset, szBuf, size);
-    if (error_code == 0)
-        return TRUE;
-    return FALSE;                    
+    
+    // large reads would only evict the cache
+    if (size > FLASH_CACHE_BYPASS_SIZE || offset + size > pFlash->size){
+        CacheStats.nBypass++;
+        error_code = alt_read_flash(pFlash->fd_flash, offset, szBuf, size);
+        if (error_code == 0)
+            return TRUE;
+        return FALSE;
+    }
+    
+    while(size > 0){
+        line_offset = offset - offset % FLASH_CACHE_LINE_SIZE;
+        pLine = flash_cache_line(pFlash, line_offset);
+        if (!pLine)
+            return FALSE;
+        read_size = line_offset + FLASH_CACHE_LINE_SIZE - offset;
+        if (read_size > size)
+            read_size = size;
+        memcpy(szBuf, pLine->szData + (offset - line_offset), read_size);
+        offset += read_size;
+        szBuf += read_size;
+        size -= read_size;
+    }
+    return TRUE;
     
 }
 
@@ -171,6 +449,7 @@ bool Flash_Write(FLASH_HANDLE Handle, alt_u32 offset, alt_u8 *szData, alt_u32 si
     
     if (!pFlash->fd_flash)
         return FALSE;
+    flash_cache_invalidate(pFlash, offset, size);
     //FLASH_DEBUG(("Flash_Write, offset=%d, size=%d\r\n", offset, size));
 #if 0
     error_code = alt_write_flash(fd_flash, offset, szData, size); // note. !!!! it will erase flash block content before write data
@@ -180,41 +459,31 @@ bool Flash_Write(FLASH_HANDLE Handle, alt_u32 offset, alt_u8 *szData, alt_u32 si
         FLASH_DEBUG(("alt_write_flash fail, error_code=%d\r\n", error_code));
     }    
 #else
-    int block_offset, block_size, write_count, this_write_size, r, i;//, first_offset;        
-    flash_region *nextreg = pFlash->regions_flash;
-
+    FLASH_REGION_INDEX *pRegion;
+    alt_u32 block_offset, write_count, this_write_size;
     
-    block_offset = 0;
+    // write block by block, the block of an offset is looked up in the index
     write_count = 0;
-    for(r=0;r<pFlash->number_of_regions_flash && bSuccess;r++){
-        for(i=0;i<nextreg->number_of_blocks && bSuccess;i++){
-            block_size = nextreg->block_size;
-//            FLASH_DEBUG(("block_offset=%d, block_size=%d\r\n", block_offset, block_size));
-//            if ((offset >= block_offset) && ((offset+size) <= (block_offset + block_size))){
-            if (((offset+write_count) >= block_offset) && (write_count < size)){
-                // write
-                this_write_size = size - write_count;
-                if (write_count == 0){
-                    // first block
-                    if (this_write_size > (block_offset + block_size - offset))
-                        this_write_size = block_offset + block_size - offset;
-                }else{
-                    // block aligement
-                    if (this_write_size > block_size)
-                        this_write_size = block_size;
-                }        
-                error_code = alt_write_flash_block(pFlash->fd_flash, block_offset, offset+write_count, szData+write_count, this_write_size);
-                //FLASH_DEBUG(("alt_write_flash_block, block_offset:%d, offset:%d, len:%d, this block_size:%d\r\n", block_offset, offset+write_count, this_write_size, block_size));
-                if (error_code != 0){
-                    bSuccess = FALSE;
-                    FLASH_DEBUG(("alt_write_flash_block fail, error_code=%d\r\n", error_code));
-                }    
-                write_count += this_write_size;
-            }
-            block_offset += block_size;
+    while(write_count < size && bSuccess){
+        pRegion = flash_region_of_offset(pFlash, offset+write_count);
+        if (!pRegion){
+            bSuccess = FALSE;
+            FLASH_DEBUG(("Flash_Write fail, offset=%d beyond the flash\r\n", offset+write_count));
+            break;
         }
-        nextreg++;
-    }      
+        block_offset = offset + write_count - pRegion->offset;
+        block_offset = pRegion->offset + block_offset - (block_offset % pRegion->block_size);
+        this_write_size = size - write_count;
+        if (this_write_size > (block_offset + pRegion->block_size - (offset+write_count)))
+            this_write_size = block_offset + pRegion->block_size - (offset+write_count);
+        error_code = alt_write_flash_block(pFlash->fd_flash, block_offset, offset+write_count, szData+write_count, this_write_size);
+        //FLASH_DEBUG(("alt_write_flash_block, block_offset:%d, offset:%d, len:%d\r\n", block_offset, offset+write_count, this_write_size));
+        if (error_code != 0){
+            bSuccess = FALSE;
+            FLASH_DEBUG(("alt_write_flash_block fail, error_code=%d\r\n", error_code));
+        }    
+        write_count += this_write_size;
+    }
 #endif      
         
 /*        
@@ -237,6 +506,7 @@ bool Flash_Erase(FLASH_HANDLE Handle, alt_u16 block_index){
 
     
     if (Flash_GetBlockInfo(Handle, block_index, &offset, &length)){
+        flash_cache_invalidate(pFlash, offset, length);
         error_code = alt_erase_flash_block(pFlash->fd_flash, offset, length);
         //DEBUG_FLASH("Erase block[%d], offset=%Xh, lenght=%Xh", block_no, offset, length);
         if (error_code == 0)
@@ -248,14 +518,7 @@ bool Flash_Erase(FLASH_HANDLE Handle, alt_u16 block_index){
 
 alt_u16 Flash_GetBlockCount(FLASH_HANDLE Handle){
     FLASH_INFO *pFlash = (FLASH_INFO *)Handle;    
-    alt_u16 no=0;
-    flash_region *nextreg = pFlash->regions_flash;
-    int r;
-    for(r=0;r<pFlash->number_of_regions_flash;r++){
-        no += nextreg->number_of_blocks;
-        nextreg++;
-    }
-    return no;
+    return pFlash->block_count;
 }
 
 
@@ -283,17 +546,132 @@ alt_u32 Flash_Size(char *pFlashName){
 
 
 
+//===== non-destructive verify
+bool Flash_BlockCrc(FLASH_HANDLE Handle, alt_u16 block_index, alt_u32 *pCrc, alt_u8 *pBuf, int nBufSize){
+    FLASH_INFO *pFlash = (FLASH_INFO *)Handle;
+    alt_32 Offset, Size;
+    alt_u32 nReadSizeSum, nReadSize, Crc;
+    
+    if (!pFlash->fd_flash || !pBuf || nBufSize <= 0)
+        return FALSE;
+    if (!Flash_GetBlockInfo(Handle, block_index, &Offset, &Size))
+        return FALSE;
+    
+    // read directly, a whole block would only evict the read cache
+    Crc = CRC32_INIT;
+    nReadSizeSum = 0;
+    while(nReadSizeSum < Size){
+        nReadSize = nBufSize;
+        if (nReadSize > (Size - nReadSizeSum))
+            nReadSize = Size - nReadSizeSum;
+        if (alt_read_flash(pFlash->fd_flash, Offset+nReadSizeSum, pBuf, nReadSize) != 0){
+            FLASH_DEBUG(("Flash_BlockCrc fail at block-offset %d-%d\r\n", block_index, Offset+nReadSizeSum));
+            return FALSE;
+        }
+        Crc = crc32_update(Crc, pBuf, nReadSize);
+        nReadSizeSum += nReadSize;
+    }
+    *pCrc = crc32_final(Crc);
+    return TRUE;
+}
+
+static alt_u32 flash_manifest_crc(const FLASH_MANIFEST *pManifest){
+    return crc32(pManifest, offsetof(FLASH_MANIFEST, Crc));
+}
+
+bool Flash_ManifestBuild(FLASH_HANDLE Handle, alt_u16 first_block, alt_u16 block_num, FLASH_MANIFEST *pManifest, alt_u8 *pBuf, int nBufSize){
+    int i;
+    
+    if (block_num > FLASH_MANIFEST_BLOCK_MAX)
+        return FALSE;
+    memset(pManifest, 0xFF, sizeof(FLASH_MANIFEST));
+    pManifest->Magic = FLASH_MANIFEST_MAGIC;
+    pManifest->FirstBlock = first_block;
+    pManifest->BlockNum = block_num;
+    for(i=0;i<block_num;i++){
+        if (!Flash_BlockCrc(Handle, first_block+i, &pManifest->szCrc[i], pBuf, nBufSize))
+            return FALSE;
+    }
+    pManifest->Crc = flash_manifest_crc(pManifest);
+    return TRUE;
+}
+
+bool Flash_ManifestStore(FLASH_HANDLE Handle, alt_u16 block_index, const FLASH_MANIFEST *pManifest){
+    alt_32 Offset, Size;
+    
+    if (!Flash_GetBlockInfo(Handle, block_index, &Offset, &Size) || Size < (alt_32)sizeof(FLASH_MANIFEST))
+        return FALSE;
+    // the manifest must not describe its own block
+    if (block_index >= pManifest->FirstBlock && block_index < pManifest->FirstBlock + pManifest->BlockNum)
+        return FALSE;
+    if (!Flash_Erase(Handle, block_index))
+        return FALSE;
+    return Flash_Write(Handle, Offset, (alt_u8 *)pManifest, sizeof(FLASH_MANIFEST));
+}
+
+bool Flash_ManifestLoad(FLASH_HANDLE Handle, alt_u16 block_index, FLASH_MANIFEST *pManifest){
+    alt_32 Offset, Size;
+    
+    if (!Flash_GetBlockInfo(Handle, block_index, &Offset, &Size) || Size < (alt_32)sizeof(FLASH_MANIFEST))
+        return FALSE;
+    if (!Flash_Read(Handle, Offset, (alt_u8 *)pManifest, sizeof(FLASH_MANIFEST)))
+        return FALSE;
+    return pManifest->Magic == FLASH_MANIFEST_MAGIC && pManifest->BlockNum <= FLASH_MANIFEST_BLOCK_MAX &&
+           pManifest->Crc == flash_manifest_crc(pManifest);
+}
+
+void Flash_VerifyStart(FLASH_VERIFY_STATE *pState){
+    memset(pState, 0, sizeof(FLASH_VERIFY_STATE));
+    pState->nFirstMismatch = -1;
+}
+
+bool Flash_VerifyStep(FLASH_HANDLE Handle, const FLASH_MANIFEST *pManifest, FLASH_VERIFY_STATE *pState, int nBlockNum, alt_u8 *pBuf, int nBufSize){
+    alt_u32 Crc;
+    
+    while(nBlockNum-- > 0 && pState->nNext < pManifest->BlockNum){
+        if (!Flash_BlockCrc(Handle, pManifest->FirstBlock+pState->nNext, &Crc, pBuf, nBufSize)){
+            pState->nError++;
+        }else if (Crc != pManifest->szCrc[pState->nNext]){
+            if (pState->nFirstMismatch < 0)
+                pState->nFirstMismatch = pManifest->FirstBlock+pState->nNext;
+            pState->nMismatch++;
+        }
+        pState->nNext++;
+    }
+    return pState->nNext >= pManifest->BlockNum;  // TRUE: all blocks are checked
+}
+
 // bQuick=TRUE: just check first and last block 
 bool FLASH_Verify(char *pFlashName, alt_u8 InitValue, bool bShowMessage, bool bQuickVerify){
+    bool bPass;
+    alt_u8 *pBuf;
+    
+    //===== alloc buffer
+    pBuf = flash_buffer_get();
+    if (!pBuf){
+        if (bShowMessage)
+            printf("[Error] Failed to alloc memory.\r\n");
+        return FALSE;
+    }        
+    
+    bPass = FLASH_VerifyBuffer(pFlashName, InitValue, bShowMessage, bQuickVerify, pBuf, nBufferPartitionSize);
+    
+    flash_buffer_put(pBuf);
+    return bPass;
+}
+
+bool FLASH_VerifyBuffer(char *pFlashName, alt_u8 InitValue, bool bShowMessage, bool bQuickVerify, alt_u8 *pBuf, int nBufSize){
     bool bPass = TRUE;
     int i, k, BlockNum;
     FLASH_HANDLE hFlash;
     alt_u32 Offset, Size;
-    alt_u8 *pBuf, Cnt;
-    const int nBufSize = 8*1024; // 16K
+    alt_u8 Cnt;
     int nWriteSizeSum, nWriteSize;
     int nReadSizeSum, nReadSize;
     
+    if (!pBuf || nBufSize <= 0)
+        return FALSE;
+    
     hFlash = Flash_Open(pFlashName);
     if (!hFlash){
         if (bShowMessage)
@@ -304,14 +682,6 @@ bool FLASH_Verify(char *pFlashName, alt_u8 InitValue, bool bShowMessage, bool bQ
         
     BlockNum = Flash_GetBlockCount(hFlash);
     
-    //===== alloc buffer
-    pBuf = (alt_u8 *)malloc(nBufSize);
-    if (!pBuf){
-        if (bShowMessage)
-            printf("[Error] Failed to alloc memory.\r\n");
-        return FALSE;
-    }        
-    
     
     //===== erase
     for(i=0;i<BlockNum && bPass;i++){
@@ -413,11 +783,7 @@ bool FLASH_Verify(char *pFlashName, alt_u8 InitValue, bool bShowMessage, bool bQ
         }  
     }
     
-    if (pBuf)
-        free(pBuf);
-    
-    if (hFlash)
-        Flash_Close(hFlash);
+    Flash_Close(hFlash);
     
     //
     return bPass;
@@ -38,20 +38,96 @@
 
 typedef void *FLASH_HANDLE;    
 
+// Locking: the read cache is shared by all handles and the HAL driver of the EPCS cannot handle
+// concurrent accesses either, so the functions that access the flash (Flash_Read, Flash_Write,
+// Flash_Erase, Flash_BlockCrc, Flash_Manifest*, Flash_VerifyStep, Flash_InvalidateCache) must not
+// run in two tasks at the same time. The caller holds a lock around them (lock_flash_log of the
+// telemetry log), or calls them before the tasks are started. Only Flash_Open, Flash_Close and the
+// statistics are safe without a lock.
+
 
 bool Flash_InfoDump(char *pFlashName);
 
 FLASH_HANDLE Flash_Open(char *pFlashName);
 bool Flash_Close(FLASH_HANDLE Handle);
 bool Flash_GetBlockInfo(FLASH_HANDLE Handle, alt_u16 block_index, alt_32 *poffset, alt_32 *psize);  // zero base index
+bool Flash_GetBlockIndex(FLASH_HANDLE Handle, alt_u32 offset, alt_u16 *pblock_index);  // block containing offset
 bool Flash_Read(FLASH_HANDLE Handle, alt_u32 offset, alt_u8 *szBuf, alt_u32 size);
 bool Flash_Write(FLASH_HANDLE Handle, alt_u32 offset, alt_u8 *szData, alt_u32 size);
 bool Flash_Erase(FLASH_HANDLE Handle, alt_u16 block_index); // zero base index
 alt_u16 Flash_GetBlockCount(FLASH_HANDLE Handle);
 alt_u32 Flash_Size(char *pFlashName);
 
-// bQuick=TRUE: just check first and last block 
-bool FLASH_Verify(char *pFlashName, alt_u8 InitValue, bool bShowMessage, bool bQuickVerify);
+//===== read cache
+// Flash_Read keeps the data in lines of FLASH_CACHE_LINE_SIZE bytes, the least recently used
+// line is replaced. The lines are shared by all handles of a device and dropped by Flash_Write
+// and Flash_Erase. Call Flash_InvalidateCache after writing the flash in another way.
+#define FLASH_CACHE_LINE_SIZE   256     // bytes per line
+#define FLASH_CACHE_LINE_NUM    32      // 8 KB
+#define FLASH_CACHE_BYPASS_SIZE 1024    // larger reads are not cached
+
+typedef struct{
+    alt_u32 nHit;           // lines found in the cache
+    alt_u32 nMiss;          // lines read from the flash
+    alt_u32 nBypass;        // reads that have not used the cache
+    alt_u32 nInvalidate;    // lines dropped by writes and erases
+}FLASH_CACHE_STATS;
+
+void Flash_InvalidateCache(void);
+void Flash_GetCacheStats(FLASH_CACHE_STATS *pStats);
+void Flash_ResetCacheStats(void);
+
+//===== non-destructive verify
+// The CRC-32 of every block is compared with a manifest recorded before, a few blocks per call
+// of Flash_VerifyStep, so the check can run in a background task. The content of the flash is
+// only read (FLASH_Verify erases and overwrites it).
+#define FLASH_MANIFEST_MAGIC        0x464D4E46  // "FNMF"
+#define FLASH_MANIFEST_BLOCK_MAX    128         // EPCS64
+
+typedef struct{
+    alt_u32 Magic;
+    alt_u16 FirstBlock;
+    alt_u16 BlockNum;
+    alt_u32 szCrc[FLASH_MANIFEST_BLOCK_MAX];   // CRC-32 of block FirstBlock+i
+    alt_u32 Crc;                                // CRC-32 of the members above
+}FLASH_MANIFEST;
+
+typedef struct{
+    int nNext;              // next block (index in the manifest)
+    int nMismatch;          // blocks that differ from the manifest
+    int nError;             // blocks that could not be read
+    int nFirstMismatch;     // block index, -1: none
+}FLASH_VERIFY_STATE;
+
+bool Flash_BlockCrc(FLASH_HANDLE Handle, alt_u16 block_index, alt_u32 *pCrc, alt_u8 *pBuf, int nBufSize);  // pBuf: buffer for reading the block
+bool Flash_ManifestBuild(FLASH_HANDLE Handle, alt_u16 first_block, alt_u16 block_num, FLASH_MANIFEST *pManifest, alt_u8 *pBuf, int nBufSize);
+bool Flash_ManifestStore(FLASH_HANDLE Handle, alt_u16 block_index, const FLASH_MANIFEST *pManifest);  // erase the block and write the manifest at its start
+bool Flash_ManifestLoad(FLASH_HANDLE Handle, alt_u16 block_index, FLASH_MANIFEST *pManifest);  // FALSE: no valid manifest in the block
+void Flash_VerifyStart(FLASH_VERIFY_STATE *pState);
+bool Flash_VerifyStep(FLASH_HANDLE Handle, const FLASH_MANIFEST *pManifest, FLASH_VERIFY_STATE *pState, int nBlockNum, alt_u8 *pBuf, int nBufSize);  // check the next nBlockNum blocks, TRUE: all blocks are checked
+
+//===== memory
+// The handles are taken from a static pool, buffers from a uC/OS memory partition or from the
+// caller, so nothing is allocated on the heap.
+#define FLASH_HANDLE_NUM        4       // maximum number of open handles
+
+struct os_mem;  // OS_MEM of uC/OS-II
+
+typedef struct{
+    alt_u32 nHandleUsed;    // handles open now
+    alt_u32 nHandleMax;     // maximum number of open handles
+    alt_u32 nHandleFail;    // Flash_Open failed, no handle left
+    alt_u32 nBufferUsed;    // buffers taken from the partition now
+    alt_u32 nBufferMax;
+    alt_u32 nBufferFail;    // no partition set or no buffer left
+}FLASH_ALLOC_STATS;
+
+void Flash_SetBufferPartition(struct os_mem *pPartition, alt_u32 nBufSize);  // buffers of FLASH_Verify, nBufSize: size of the blocks of the partition
+void Flash_GetAllocStats(FLASH_ALLOC_STATS *pStats);
+
+// destructive test: erase, write a pattern and read it back, bQuick=TRUE: just check first and last block 
+bool FLASH_Verify(char *pFlashName, alt_u8 InitValue, bool bShowMessage, bool bQuickVerify);  // buffer from the partition of Flash_SetBufferPartition
+bool FLASH_VerifyBuffer(char *pFlashName, alt_u8 InitValue, bool bShowMessage, bool bQuickVerify, alt_u8 *pBuf, int nBufSize);
 
 
 #endif /*FLASH_H_*/
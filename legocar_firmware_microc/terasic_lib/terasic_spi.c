@@ -1,5 +1,6 @@
 #include "terasic_includes.h"
 #include "terasic_spi.h"
+#include "includes.h"  // uC/OS-II: driver task and semaphores
 
 
 typedef enum{
@@ -19,7 +20,112 @@ typedef enum{
         SPI_STATUS_FLAG_DONE = 0x01
 }SPI_STATUS_FLAG;
 
+static SPI_STATS szStats[SPI_STATS_REG_NUM];
+static alt_u32 nLatencyFreq = 0;    // frequency of the latency clock, 0: no timestamp timer
+static bool bLatencyChecked = FALSE;
+
+// a transfer takes some 10 us, so the latency is only measured with the timestamp timer (the system timer is too coarse)
+static void SPI_LatencyInit(void){
+    if (bLatencyChecked)
+        return;
+    bLatencyChecked = TRUE;
+    if (alt_timestamp_start() >= 0)
+        nLatencyFreq = alt_timestamp_freq();
+}
+
+static alt_u32 SPI_LatencyClock(void){
+    if (nLatencyFreq)
+        return alt_timestamp();
+    return 0;
+}
+
+// histogram bucket of a value: number of significant bits, limited to the last bucket
+static int SPI_HistBucket(alt_u32 Value, int nShift){
+    int nBucket = 0;
+    Value >>= nShift;
+    while(Value > 0 && nBucket < SPI_STATS_HIST_NUM-1){
+        Value >>= 1;
+        nBucket++;
+    }
+    return nBucket;
+}
+
+static void SPI_RecordTransfer(alt_u8 RegIndex, alt_u8 nByteNum, alt_u32 nPoll, bool bDone, alt_u32 Latency){
+    SPI_STATS *pStats;
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    if (RegIndex >= SPI_STATS_REG_NUM)
+        RegIndex = SPI_STATS_REG_NUM-1;
+    pStats = &szStats[RegIndex];
+
+    OS_ENTER_CRITICAL();
+    pStats->nTransfers++;
+    if (bDone)
+        pStats->nBytes += nByteNum;
+    else
+        pStats->nTimeouts++;
+    pStats->nPollSum += nPoll;
+    if (nPoll > pStats->nPollMax)
+        pStats->nPollMax = nPoll;
+    pStats->szPollHist[SPI_HistBucket(nPoll, 0)]++;
+    if (nLatencyFreq){
+        pStats->LatencySum += Latency;
+        if (Latency > pStats->LatencyMax)
+            pStats->LatencyMax = Latency;
+        pStats->szLatencyHist[SPI_HistBucket(Latency, SPI_LATENCY_HIST_SHIFT)]++;
+    }
+    OS_EXIT_CRITICAL();
+}
+
+void SPI_GetStats(alt_u8 RegIndex, SPI_STATS *pStats){
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+    if (RegIndex >= SPI_STATS_REG_NUM)
+        RegIndex = SPI_STATS_REG_NUM-1;
+    OS_ENTER_CRITICAL();
+    *pStats = szStats[RegIndex];
+    OS_EXIT_CRITICAL();
+    pStats->LatencyFreq = nLatencyFreq;
+}
+
+void SPI_GetTotalStats(SPI_STATS *pStats){
+    SPI_STATS Stats;
+    int r, i;
+
+    memset(pStats, 0, sizeof(SPI_STATS));
+    for(r=0;r<SPI_STATS_REG_NUM;r++){
+        SPI_GetStats(r, &Stats);
+        pStats->nTransfers += Stats.nTransfers;
+        pStats->nBytes += Stats.nBytes;
+        pStats->nTimeouts += Stats.nTimeouts;
+        pStats->nPollSum += Stats.nPollSum;
+        if (Stats.nPollMax > pStats->nPollMax)
+            pStats->nPollMax = Stats.nPollMax;
+        pStats->LatencySum += Stats.LatencySum;
+        if (Stats.LatencyMax > pStats->LatencyMax)
+            pStats->LatencyMax = Stats.LatencyMax;
+        for(i=0;i<SPI_STATS_HIST_NUM;i++){
+            pStats->szPollHist[i] += Stats.szPollHist[i];
+            pStats->szLatencyHist[i] += Stats.szLatencyHist[i];
+        }
+    }
+    pStats->LatencyFreq = nLatencyFreq;
+}
+
+void SPI_ResetStats(void){
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+    OS_ENTER_CRITICAL();
+    memset(szStats, 0, sizeof(szStats));
+    OS_EXIT_CRITICAL();
+}
+
 void SPI_Init(alt_u32 spi_base){
+    SPI_LatencyInit();
     // clear fifo
     IOWR(spi_base, SPI_REG_CTRL_STATUS, 0);
     IOWR(spi_base, SPI_REG_CTRL_STATUS, SPI_FLAG_CLEAR_FIFO);
@@ -28,11 +134,73 @@ void SPI_Init(alt_u32 spi_base){
 }
 
 
+typedef enum{
+        SPI_SLOT_FREE = 0,
+        SPI_SLOT_QUEUED,
+        SPI_SLOT_ACTIVE,
+        SPI_SLOT_DONE,
+        SPI_SLOT_ABANDONED  // waiter timed out, the driver frees the slot
+}SPI_SLOT_STATE;
+
+typedef struct{
+    volatile SPI_SLOT_STATE State;
+    alt_u32 spi_base;
+    alt_u8 RegIndex;
+    bool bRead;
+    bool bSuccess;
+    alt_u8 nByteNum;
+    alt_u8 *pUserData;
+    alt_u8 szData[SPI_MAX_TRANSFER_SIZE];  // copy, so an abandoned transfer does not touch the caller's buffer
+    OS_EVENT *pDoneSem;
+}SPI_SLOT;
+
+static SPI_SLOT szSlot[SPI_QUEUE_SIZE];
+static int nQueueHead = 0;  // next slot for the driver
+static int nQueueTail = 0;  // next slot for SPI_Submit
+static OS_EVENT *pQueueSem = NULL;
+static bool bAsyncActive = FALSE;
+static OS_STK szDriverStk[SPI_DRIVER_STACKSIZE];
+
+static bool SPI_DoMultipleWrite(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 szData[], alt_u8 nByteNum);
+static bool SPI_DoMultipleRead(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 szBuf[], alt_u8 nByteNum);
+
+// queue the transfer if it may sleep, i.e. in a task while the driver task is running
+static bool SPI_UseQueue(void){
+    return bAsyncActive && OSRunning && OSIntNesting == 0;
+}
+
+// split the transfer into slots and wait for every one; while the queue is full, the task sleeps
+// (the SPI core must not be accessed directly here, the driver task may be in the middle of a transfer)
+static bool SPI_QueuedTransfer(alt_u32 spi_base, alt_u8 RegIndex, bool bRead, alt_u8 *pData, alt_u8 nByteNum){
+    bool bSuccess = TRUE;
+    alt_u8 nLen;
+    int nTicket;
+    while(nByteNum > 0 && bSuccess){
+        nLen = nByteNum;
+        if (nLen > SPI_MAX_TRANSFER_SIZE)
+            nLen = SPI_MAX_TRANSFER_SIZE;
+        while((nTicket = SPI_Submit(spi_base, RegIndex, bRead, pData, nLen)) < 0)
+            OSTimeDly(1);
+        bSuccess = SPI_Wait(nTicket, 0);
+        RegIndex += nLen;  // the registers are addressed in a burst
+        pData += nLen;
+        nByteNum -= nLen;
+    }
+    return bSuccess;
+}
+
 bool SPI_MultipleWrite(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 szData[], alt_u8 nByteNum){
+    if (SPI_UseQueue())
+        return SPI_QueuedTransfer(spi_base, RegIndex, FALSE, szData, nByteNum);
+    return SPI_DoMultipleWrite(spi_base, RegIndex, szData, nByteNum);
+}
+
+static bool SPI_DoMultipleWrite(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 szData[], alt_u8 nByteNum){
     alt_u8 Status;
     const int nMaxTry = 100;
     int nTryCnt = 0;
     int i;
+    alt_u32 Start = SPI_LatencyClock();
     
     // make sure processs is stoped, and set write flag
     IOWR(spi_base, SPI_REG_CTRL_STATUS, 0);
@@ -55,6 +223,9 @@ bool SPI_MultipleWrite(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 szData[], alt_u
     
     IOWR(spi_base, SPI_REG_CTRL_STATUS, 0);  //stop
     
+    SPI_RecordTransfer(RegIndex, nByteNum, (Status & SPI_STATUS_FLAG_DONE)?nTryCnt+1:nTryCnt,
+                       Status & SPI_STATUS_FLAG_DONE, SPI_LatencyClock() - Start);
+    
     if (Status & SPI_STATUS_FLAG_DONE)
         return TRUE;
     
@@ -66,10 +237,17 @@ bool SPI_Write(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 Value){
 }    
 
 bool SPI_MultipleRead(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 szBuf[], alt_u8 nByteNum){
+    if (SPI_UseQueue())
+        return SPI_QueuedTransfer(spi_base, RegIndex, TRUE, szBuf, nByteNum);
+    return SPI_DoMultipleRead(spi_base, RegIndex, szBuf, nByteNum);
+}
+
+static bool SPI_DoMultipleRead(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 szBuf[], alt_u8 nByteNum){
     alt_u8 Status, Value8;
     const int nMaxTry = 100;
     int nTryCnt = 0;
     int i;
+    alt_u32 Start = SPI_LatencyClock();
     
     // make sure processs is stoped, and set read flag
     IOWR(spi_base, SPI_REG_CTRL_STATUS, SPI_FLGA_REG_READ);
@@ -97,8 +275,14 @@ bool SPI_MultipleRead(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 szBuf[], alt_u8
             Value8 = IORD(spi_base, SPI_REG_DATA);
             szBuf[i] = Value8;
         }
-        return TRUE;
     }        
+    
+    // the data is part of the transfer
+    SPI_RecordTransfer(RegIndex, nByteNum, (Status & SPI_STATUS_FLAG_DONE)?nTryCnt+1:nTryCnt,
+                       Status & SPI_STATUS_FLAG_DONE, SPI_LatencyClock() - Start);
+    
+    if (Status & SPI_STATUS_FLAG_DONE)
+        return TRUE;
     return FALSE;
 }
 
@@ -107,3 +291,158 @@ bool SPI_Read(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 *pBuf){
 }
 
 
+
+//===== asynchronous transfers
+
+static void SPI_DriverTask(void *pdata){
+    SPI_SLOT *pSlot;
+    bool bSuccess, bSkip;
+    INT8U err;
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    while(1){
+        // sleep until a transfer is queued
+        OSSemPend(pQueueSem, 0, &err);
+
+        pSlot = &szSlot[nQueueHead];
+        nQueueHead = (nQueueHead + 1) % SPI_QUEUE_SIZE;
+
+        OS_ENTER_CRITICAL();
+        bSkip = (pSlot->State == SPI_SLOT_ABANDONED);
+        if (bSkip)
+            pSlot->State = SPI_SLOT_FREE;
+        else
+            pSlot->State = SPI_SLOT_ACTIVE;
+        OS_EXIT_CRITICAL();
+        if (bSkip)
+            continue;
+
+        if (pSlot->bRead)
+            bSuccess = SPI_DoMultipleRead(pSlot->spi_base, pSlot->RegIndex, pSlot->szData, pSlot->nByteNum);
+        else
+            bSuccess = SPI_DoMultipleWrite(pSlot->spi_base, pSlot->RegIndex, pSlot->szData, pSlot->nByteNum);
+
+        // wake up the waiting task
+        OS_ENTER_CRITICAL();
+        bSkip = (pSlot->State == SPI_SLOT_ABANDONED);
+        if (bSkip){
+            pSlot->State = SPI_SLOT_FREE;
+        }else{
+            pSlot->bSuccess = bSuccess;
+            pSlot->State = SPI_SLOT_DONE;
+        }
+        OS_EXIT_CRITICAL();
+        if (!bSkip)
+            OSSemPost(pSlot->pDoneSem);
+    }
+}
+
+bool SPI_AsyncInit(alt_u8 DriverPriority){
+    int i;
+    INT8U err;
+
+    if (bAsyncActive)
+        return TRUE;
+
+    pQueueSem = OSSemCreate(0);
+    if (!pQueueSem)
+        return FALSE;
+    for(i=0;i<SPI_QUEUE_SIZE;i++){
+        szSlot[i].State = SPI_SLOT_FREE;
+        szSlot[i].pDoneSem = OSSemCreate(0);
+        if (!szSlot[i].pDoneSem)
+            return FALSE;
+    }
+    nQueueHead = 0;
+    nQueueTail = 0;
+
+    err = OSTaskCreateExt(SPI_DriverTask,
+                          NULL,
+                          (void *) &szDriverStk[SPI_DRIVER_STACKSIZE-1],
+                          DriverPriority,
+                          DriverPriority,
+                          szDriverStk,
+                          SPI_DRIVER_STACKSIZE,
+                          NULL,
+                          0);
+    if (err != OS_NO_ERR)
+        return FALSE;
+
+    bAsyncActive = TRUE;
+    return TRUE;
+}
+
+int SPI_Submit(alt_u32 spi_base, alt_u8 RegIndex, bool bRead, alt_u8 szData[], alt_u8 nByteNum){
+    SPI_SLOT *pSlot;
+    int nTicket;
+    int i;
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    if (!bAsyncActive || nByteNum == 0 || nByteNum > SPI_MAX_TRANSFER_SIZE)
+        return -1;
+
+    // fill the next slot, the slots are served in order
+    OS_ENTER_CRITICAL();
+    nTicket = nQueueTail;
+    pSlot = &szSlot[nTicket];
+    if (pSlot->State != SPI_SLOT_FREE){
+        OS_EXIT_CRITICAL();
+        return -1;
+    }
+    pSlot->spi_base = spi_base;
+    pSlot->RegIndex = RegIndex;
+    pSlot->bRead = bRead;
+    pSlot->bSuccess = FALSE;
+    pSlot->nByteNum = nByteNum;
+    pSlot->pUserData = szData;
+    if (!bRead){
+        for(i=0;i<nByteNum;i++)
+            pSlot->szData[i] = szData[i];
+    }
+    pSlot->State = SPI_SLOT_QUEUED;
+    nQueueTail = (nQueueTail + 1) % SPI_QUEUE_SIZE;
+    OS_EXIT_CRITICAL();
+
+    OSSemPost(pQueueSem);
+    return nTicket;
+}
+
+bool SPI_Wait(int Ticket, alt_u16 Timeout){
+    SPI_SLOT *pSlot;
+    bool bSuccess = FALSE;
+    bool bDone;
+    int i;
+    INT8U err;
+#if OS_CRITICAL_METHOD == 3
+    OS_CPU_SR cpu_sr = 0;
+#endif
+
+    if (Ticket < 0 || Ticket >= SPI_QUEUE_SIZE)
+        return FALSE;
+    pSlot = &szSlot[Ticket];
+
+    OSSemPend(pSlot->pDoneSem, Timeout, &err);
+
+    OS_ENTER_CRITICAL();
+    bDone = (pSlot->State == SPI_SLOT_DONE);
+    if (!bDone)
+        pSlot->State = SPI_SLOT_ABANDONED;
+    OS_EXIT_CRITICAL();
+
+    if (bDone){
+        // the transfer may have finished just after the timeout
+        OSSemAccept(pSlot->pDoneSem);
+        bSuccess = pSlot->bSuccess;
+        if (bSuccess && pSlot->bRead){
+            for(i=0;i<pSlot->nByteNum;i++)
+                pSlot->pUserData[i] = pSlot->szData[i];
+        }
+        pSlot->State = SPI_SLOT_FREE;
+    }
+
+    return bSuccess;
+}
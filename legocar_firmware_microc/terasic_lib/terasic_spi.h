@@ -7,4 +7,45 @@ bool SPI_Write(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 Value);
 bool SPI_MultipleRead(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 szBuf[], alt_u8 nByteNum);
 bool SPI_Read(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 *pBuf);
 
+//===== asynchronous transfers
+// The transfers are queued and executed by a driver task, so the calling task sleeps
+// instead of polling the SPI core. Once the driver task is started, the blocking
+// functions above use the queue as well (when called from a task): they split transfers
+// larger than SPI_MAX_TRANSFER_SIZE and sleep while the queue is full.
+#define SPI_QUEUE_SIZE          8   // maximum number of queued transfers
+#define SPI_MAX_TRANSFER_SIZE   32  // maximum number of bytes per queued transfer
+#define SPI_DRIVER_STACKSIZE    512
+
+bool SPI_AsyncInit(alt_u8 DriverPriority);  // call after OSInit()
+int  SPI_Submit(alt_u32 spi_base, alt_u8 RegIndex, bool bRead, alt_u8 szData[], alt_u8 nByteNum); // return ticket, -1: queue full
+bool SPI_Wait(int Ticket, alt_u16 Timeout);  // Timeout in OS ticks, 0: forever. Read data is copied to szData of SPI_Submit
+
+//===== statistics of the transfers
+// Every transfer is counted for its register index. Latencies are measured in ticks of the
+// timestamp timer (LatencyFreq per second). Without a timestamp timer (as in the SOPC of the car)
+// LatencyFreq is 0 and the latencies are not measured: the polls of the status register are the
+// only measure of the duration of a transfer then. Histogram bucket i counts the values in
+// [2^(i-1), 2^i) (poll iterations) and [2^(i+SPI_LATENCY_HIST_SHIFT-1), 2^(i+SPI_LATENCY_HIST_SHIFT))
+// (latency); bucket 0 counts the smaller values, the last bucket all larger ones.
+#define SPI_STATS_REG_NUM       64  // register indexes 0..62, all others are counted in the last entry
+#define SPI_STATS_HIST_NUM      8
+#define SPI_LATENCY_HIST_SHIFT  6
+
+typedef struct{
+    alt_u32 nTransfers;
+    alt_u32 nBytes;
+    alt_u32 nTimeouts;
+    alt_u32 nPollSum;       // polls of the status register until SPI_STATUS_FLAG_DONE
+    alt_u32 nPollMax;
+    alt_u32 LatencySum;
+    alt_u32 LatencyMax;
+    alt_u32 szPollHist[SPI_STATS_HIST_NUM];
+    alt_u32 szLatencyHist[SPI_STATS_HIST_NUM];
+    alt_u32 LatencyFreq;    // ticks per second of the latencies, 0: not measured
+}SPI_STATS;
+
+void SPI_GetStats(alt_u8 RegIndex, SPI_STATS *pStats);
+void SPI_GetTotalStats(SPI_STATS *pStats);  // sum over all register indexes
+void SPI_ResetStats(void);
+
 #endif /*TERASIC_SPI_H_*/
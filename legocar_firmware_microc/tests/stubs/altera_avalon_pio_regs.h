@@ -0,0 +1,16 @@
+/*
+ * altera_avalon_pio_regs.h
+ *
+ * Host stand-in for the header of the Altera HAL.
+ */
+
+#ifndef ALTERA_AVALON_PIO_REGS_H_
+#define ALTERA_AVALON_PIO_REGS_H_
+
+#include "io.h"
+
+#define IORD_ALTERA_AVALON_PIO_DATA(base)            IORD(base, 0)
+#define IOWR_ALTERA_AVALON_PIO_DATA(base, data)      IOWR(base, 0, data)
+#define IOWR_ALTERA_AVALON_PIO_DIRECTION(base, data) IOWR(base, 1, data)
+
+#endif /* ALTERA_AVALON_PIO_REGS_H_ */
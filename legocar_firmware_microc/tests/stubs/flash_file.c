@@ -0,0 +1,199 @@
+/*
+ * flash_file.c
+ *
+ * Host stand-in for the flash functions of the Altera HAL: the EPCS is a file.
+ * Like on the real device, writing can only clear bits, erasing sets a whole block to 0xFF.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "flash_file.h"
+#include "sys/alt_flash.h"
+
+struct alt_flash_dev {
+	int unused;
+};
+
+alt_u32 flash_file_reads = 0, flash_file_writes = 0, flash_file_erases = 0;
+
+static FILE *file = NULL;
+static struct alt_flash_dev device;
+static flash_region regions[ALT_MAX_NUMBER_OF_FLASH_REGIONS] = {
+	{ 0, FLASH_FILE_BLOCKS * FLASH_FILE_BLOCK_SIZE, FLASH_FILE_BLOCKS, FLASH_FILE_BLOCK_SIZE }
+};
+static int number_of_regions = 1;
+static int flash_size = FLASH_FILE_BLOCKS * FLASH_FILE_BLOCK_SIZE;
+
+
+int flash_file_set_regions(const flash_region *layout, int number) {
+	static const flash_region epcs = { 0, FLASH_FILE_BLOCKS * FLASH_FILE_BLOCK_SIZE, FLASH_FILE_BLOCKS, FLASH_FILE_BLOCK_SIZE };
+	int r;
+
+	if(!layout) {
+		layout = &epcs;
+		number = 1;
+	}
+	if(number < 1 || number > ALT_MAX_NUMBER_OF_FLASH_REGIONS)
+		return 0;
+	for(r=0; r<number; r++)
+		if(layout[r].block_size > FLASH_FILE_BLOCK_SIZE)
+			return 0;
+
+	flash_size = 0;
+	for(r=0; r<number; r++) {
+		regions[r].offset           = flash_size;
+		regions[r].number_of_blocks = layout[r].number_of_blocks;
+		regions[r].block_size       = layout[r].block_size;
+		regions[r].region_size      = layout[r].number_of_blocks * layout[r].block_size;
+		flash_size += regions[r].region_size;
+	}
+	number_of_regions = number;
+
+	return 1;
+}
+
+
+int flash_file_open(const char *path) {
+	static alt_u8 erased[FLASH_FILE_BLOCK_SIZE];
+	long size;
+	int b;
+
+	flash_file_close();
+	flash_file_reads = flash_file_writes = flash_file_erases = 0;
+
+	if(path) {
+		file = fopen(path, "r+b");
+		if(!file)
+			file = fopen(path, "w+b");
+	}
+	else {
+		file = tmpfile();
+	}
+	if(!file)
+		return 0;
+
+	fseek(file, 0, SEEK_END);
+	size = ftell(file);
+
+	// a new flash is erased
+	if(size < flash_size) {
+		memset(erased, 0xFF, sizeof(erased));
+		fseek(file, 0, SEEK_SET);
+		for(b=0; b<flash_size; b+=sizeof(erased))
+			fwrite(erased, 1, sizeof(erased), file);
+		fflush(file);
+	}
+
+	return 1;
+}
+
+void flash_file_close(void) {
+	if(file)
+		fclose(file);
+	file = NULL;
+}
+
+FILE *flash_file(void) {
+	return file;
+}
+
+alt_flash_fd *alt_flash_open_dev(const char *name) {
+	return file ? &device : NULL;
+}
+
+void alt_flash_close_dev(alt_flash_fd *fd) {
+}
+
+int alt_get_flash_info(alt_flash_fd *fd, flash_region **info, int *number) {
+	*info = regions;
+	*number = number_of_regions;
+	return 0;
+}
+
+static int in_range(int offset, int length) {
+	return offset >= 0 && length >= 0 && offset + length <= flash_size;
+}
+
+int alt_read_flash(alt_flash_fd *fd, int offset, void *dest_addr, int length) {
+	flash_file_reads++;
+
+	if(!in_range(offset, length) || fseek(file, offset, SEEK_SET) != 0)
+		return -1;
+
+	return fread(dest_addr, 1, length, file) == (size_t) length ? 0 : -1;
+}
+
+int alt_write_flash_block(alt_flash_fd *fd, int block_offset, int data_offset, const void *data, int length) {
+	alt_u8 *content;
+	int i, result;
+
+	flash_file_writes++;
+
+	if(!in_range(data_offset, length))
+		return -1;
+
+	content = malloc(length);
+	if(!content)
+		return -1;
+
+	// programming only clears bits
+	fseek(file, data_offset, SEEK_SET);
+	result = fread(content, 1, length, file) == (size_t) length ? 0 : -1;
+	for(i=0; i<length; i++)
+		content[i] &= ((const alt_u8 *) data)[i];
+
+	fseek(file, data_offset, SEEK_SET);
+	if(result == 0 && fwrite(content, 1, length, file) != (size_t) length)
+		result = -1;
+	fflush(file);
+
+	free(content);
+	return result;
+}
+
+/**
+ * Like the HAL, alt_write_flash keeps the rest of the block, but erases it before writing.
+ * The blocks are taken as FLASH_FILE_BLOCK_SIZE, whatever the regions are.
+ */
+int alt_write_flash(alt_flash_fd *fd, int offset, const void *src_addr, int length) {
+	static alt_u8 content[FLASH_FILE_BLOCK_SIZE];
+	int block, size;
+
+	while(length > 0) {
+		block = offset - offset % FLASH_FILE_BLOCK_SIZE;
+		size  = block + FLASH_FILE_BLOCK_SIZE - offset;
+		if(size > length)
+			size = length;
+
+		if(alt_read_flash(fd, block, content, FLASH_FILE_BLOCK_SIZE) != 0)
+			return -1;
+		memcpy(content + (offset - block), src_addr, size);
+		if(alt_erase_flash_block(fd, block, FLASH_FILE_BLOCK_SIZE) != 0
+		   || alt_write_flash_block(fd, block, block, content, FLASH_FILE_BLOCK_SIZE) != 0)
+			return -1;
+
+		offset   += size;
+		src_addr  = (const alt_u8 *) src_addr + size;
+		length   -= size;
+	}
+
+	return 0;
+}
+
+int alt_erase_flash_block(alt_flash_fd *fd, int offset, int length) {
+	static alt_u8 erased[FLASH_FILE_BLOCK_SIZE];
+	int result;
+
+	flash_file_erases++;
+
+	if(!in_range(offset, length) || length > FLASH_FILE_BLOCK_SIZE)
+		return -1;
+
+	memset(erased, 0xFF, length);
+	fseek(file, offset, SEEK_SET);
+	result = fwrite(erased, 1, length, file) == (size_t) length ? 0 : -1;
+	fflush(file);
+
+	return result;
+}
@@ -0,0 +1,58 @@
+/*
+ * flash_file.h
+ *
+ * Control over the file-backed stand-in for the EPCS flash (see flash_file.c).
+ */
+
+#ifndef FLASH_FILE_H_
+#define FLASH_FILE_H_
+
+#include <stdio.h>
+
+#include "alt_types.h"
+#include "sys/alt_flash_types.h"
+
+// geometry of the EPCS16 of the DE0-Nano: 32 blocks of 64 KiB
+#define FLASH_FILE_BLOCKS     32
+#define FLASH_FILE_BLOCK_SIZE 65536
+
+//! number of accesses to the flash since the last 'flash_file_open'
+extern alt_u32 flash_file_reads, flash_file_writes, flash_file_erases;
+
+
+/**
+ * Use a file as the content of the flash for all following alt_flash_open_dev calls.
+ * The file is created and erased (0xFF), if it does not exist.
+ *
+ * @param path the file, NULL: an anonymous temporary file
+ *
+ * @result 1: success, 0: the file cannot be opened
+ */
+int  flash_file_open(const char *path);
+
+
+/**
+ * Set the regions of the flash for the following 'flash_file_open' calls, e.g. a flash with
+ * small boot blocks. The offsets and sizes of the regions are computed from the blocks.
+ *
+ * @param layout the regions, NULL: the geometry of the EPCS16 (the default)
+ * @param number_of_regions number of regions (at most ALT_MAX_NUMBER_OF_FLASH_REGIONS)
+ *
+ * @result 1: success, 0: too many regions, or a block is larger than FLASH_FILE_BLOCK_SIZE
+ */
+int  flash_file_set_regions(const flash_region *layout, int number_of_regions);
+
+
+/**
+ * Close the file of the flash.
+ */
+void flash_file_close(void);
+
+
+/**
+ * Access the file directly, e.g. to corrupt the content.
+ */
+FILE *flash_file(void);
+
+
+#endif /* FLASH_FILE_H_ */
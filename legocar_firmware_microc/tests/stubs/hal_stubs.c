@@ -0,0 +1,73 @@
+/*
+ * hal_stubs.c
+ *
+ * Host stand-ins for the functions of the Altera HAL that the tested modules use.
+ * The system timer runs at 1 kHz and only advances when a test changes host_nticks or sets
+ * host_nticks_step, alarms are called by the tests themselves.
+ */
+
+#include <stddef.h>
+
+#include "hal_stubs.h"
+#include "sys/alt_alarm.h"
+#include "sys/alt_irq.h"
+#include "sys/alt_timestamp.h"
+
+alt_u32 host_nticks = 0;
+alt_u32 host_nticks_step = 0;
+
+alt_u32 (*host_alarm_callback)(void *context) = NULL;
+void *host_alarm_context = NULL;
+
+
+alt_u32 alt_nticks(void) {
+	static alt_u32 calls = 0;
+
+	if(host_nticks_step > 0 && ++calls >= host_nticks_step) {
+		calls = 0;
+		host_nticks++;
+	}
+	return host_nticks;
+}
+
+alt_u32 alt_ticks_per_second(void) {
+	return 1000;
+}
+
+int alt_alarm_start(alt_alarm *alarm, alt_u32 nticks, alt_u32 (*callback)(void *), void *context) {
+	host_alarm_callback = callback;
+	host_alarm_context  = context;
+	return 0;
+}
+
+void alt_alarm_stop(alt_alarm *alarm) {
+	host_alarm_callback = NULL;
+}
+
+alt_irq_context alt_irq_disable_all(void) {
+	return 0;
+}
+
+void alt_irq_enable_all(alt_irq_context context) {
+}
+
+int alt_ic_isr_register(alt_u32 ic_id, alt_u32 irq, alt_isr_func isr, void *context, void *flags) {
+	return 0;
+}
+
+// the SOPC of the car has no timestamp timer
+int alt_timestamp_start(void) {
+	return -1;
+}
+
+alt_timestamp_type alt_timestamp(void) {
+	return 0;
+}
+
+alt_u32 alt_timestamp_freq(void) {
+	return 0;
+}
+
+// the host has no caches to flush
+void alt_dcache_flush_all(void) {
+}
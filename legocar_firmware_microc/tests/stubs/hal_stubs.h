@@ -0,0 +1,21 @@
+/*
+ * hal_stubs.h
+ *
+ * Control over the host stand-ins of the Altera HAL for the tests.
+ */
+
+#ifndef HAL_STUBS_H_
+#define HAL_STUBS_H_
+
+#include "alt_types.h"
+
+//! value of alt_nticks(), advanced by the tests
+extern alt_u32 host_nticks;
+//! alt_nticks() advances host_nticks by one every host_nticks_step calls (0: only the tests advance it)
+extern alt_u32 host_nticks_step;
+
+//! callback and context of the latest alt_alarm_start (NULL: no alarm running)
+extern alt_u32 (*host_alarm_callback)(void *context);
+extern void *host_alarm_context;
+
+#endif /* HAL_STUBS_H_ */
@@ -0,0 +1,61 @@
+/*
+ * includes.h
+ *
+ * Host stand-in for the header of MicroC-OS (see os_stubs.c): there is only one task,
+ * critical sections do nothing and semaphores never block.
+ */
+
+#ifndef INCLUDES_H_
+#define INCLUDES_H_
+
+#include "alt_types.h"
+
+typedef unsigned char  INT8U;
+typedef signed char    INT8S;
+typedef unsigned short INT16U;
+typedef unsigned int   INT32U;
+typedef unsigned int   OS_STK;
+typedef unsigned int   OS_CPU_SR;
+
+typedef struct os_event { INT16U OSEventCnt; } OS_EVENT;
+typedef struct os_mem OS_MEM;
+
+#define OS_CRITICAL_METHOD 3
+#define OS_ENTER_CRITICAL() ((void) (cpu_sr = 0))
+#define OS_EXIT_CRITICAL()  ((void) cpu_sr)
+
+#define OS_NO_ERR        0
+#define OS_ERR_NONE      0
+#define OS_TIMEOUT       10
+#define OS_MEM_NO_FREE_BLKS 113
+#define OS_TICKS_PER_SEC 1000
+#define OS_LOWEST_PRIO   20
+#define OS_PRIO_SELF     0xFF
+
+extern INT8U OSRunning;
+extern INT8U OSIntNesting;
+
+void   OSInit(void);
+void   OSStart(void);
+void   OSTimeDly(INT16U ticks);
+INT8U  OSTimeDlyHMSM(INT8U hours, INT8U minutes, INT8U seconds, INT16U milli);
+INT32U OSTimeGet(void);
+
+INT8U  OSTaskCreateExt(void (*task)(void *), void *pdata, OS_STK *ptos, INT8U prio, INT16U id,
+                       OS_STK *pbos, INT32U stk_size, void *pext, INT16U opt);
+INT8U  OSTaskDel(INT8U prio);
+
+OS_EVENT *OSSemCreate(INT16U cnt);
+void   OSSemPend(OS_EVENT *pevent, INT16U timeout, INT8U *perr);
+INT8U  OSSemPost(OS_EVENT *pevent);
+INT16U OSSemAccept(OS_EVENT *pevent);
+
+OS_EVENT *OSMutexCreate(INT8U prio, INT8U *perr);
+void   OSMutexPend(OS_EVENT *pevent, INT16U timeout, INT8U *perr);
+INT8U  OSMutexPost(OS_EVENT *pevent);
+
+OS_MEM *OSMemCreate(void *addr, INT32U nblks, INT32U blksize, INT8U *perr);
+void   *OSMemGet(OS_MEM *pmem, INT8U *perr);
+INT8U  OSMemPut(OS_MEM *pmem, void *pblk);
+
+#endif /* INCLUDES_H_ */
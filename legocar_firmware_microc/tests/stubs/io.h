@@ -0,0 +1,19 @@
+/*
+ * io.h
+ *
+ * Host stand-in for the header of the Altera HAL: the registers of a peripheral are an
+ * array of alt_u32 in the memory of the test, its address is the base address.
+ */
+
+#ifndef IO_H_
+#define IO_H_
+
+#include <stdint.h>
+#include "alt_types.h"
+
+#define IORD(base, reg)             (((volatile alt_u32 *) (uintptr_t) (base))[reg])
+#define IOWR(base, reg, data)       (((volatile alt_u32 *) (uintptr_t) (base))[reg] = (data))
+#define IORD_32DIRECT(base, offset) (*(volatile alt_u32 *) ((uintptr_t) (base) + (offset)))
+#define IOWR_32DIRECT(base, offset, data) (*(volatile alt_u32 *) ((uintptr_t) (base) + (offset)) = (data))
+
+#endif /* IO_H_ */
@@ -0,0 +1,164 @@
+/*
+ * os_stubs.c
+ *
+ * Host stand-ins for the functions of MicroC-OS that the tested modules use.
+ * The tests run in a single thread: tasks are never started, delays return immediately,
+ * and a semaphore that is not available times out instead of blocking.
+ * A test runs a task with host_task_step: the delay at the end of the loop of the task returns
+ * to the test.
+ */
+
+#include <setjmp.h>
+#include <stddef.h>
+
+#include "includes.h"
+#include "os_stubs.h"
+
+#define MAX_EVENTS     32
+#define MAX_PARTITIONS 4
+
+struct os_mem {
+	alt_u8 *addr;
+	INT32U  blocks;
+	INT32U  block_size;
+	INT32U  used;           // one bit per block
+};
+
+INT8U OSRunning    = 0;
+INT8U OSIntNesting = 0;
+
+static OS_EVENT events[MAX_EVENTS];
+static int      event_count = 0;
+
+static OS_MEM   partitions[MAX_PARTITIONS];
+static int      partition_count = 0;
+
+// the task run by host_task_step, until it calls OSTimeDly
+static jmp_buf  task_return;
+static int      task_running = 0;
+
+
+void host_task_step(void (*task)(void *), void *pdata) {
+	if(setjmp(task_return) == 0) {
+		task_running = 1;
+		task(pdata);
+	}
+	task_running = 0;
+}
+
+
+void OSInit(void) {
+}
+
+void OSStart(void) {
+}
+
+void OSTimeDly(INT16U ticks) {
+	if(task_running)
+		longjmp(task_return, 1);
+}
+
+INT8U OSTimeDlyHMSM(INT8U hours, INT8U minutes, INT8U seconds, INT16U milli) {
+	if(task_running)
+		longjmp(task_return, 1);
+	return OS_NO_ERR;
+}
+
+INT32U OSTimeGet(void) {
+	return 0;
+}
+
+INT8U OSTaskCreateExt(void (*task)(void *), void *pdata, OS_STK *ptos, INT8U prio, INT16U id,
+                      OS_STK *pbos, INT32U stk_size, void *pext, INT16U opt) {
+	return OS_NO_ERR;
+}
+
+INT8U OSTaskDel(INT8U prio) {
+	return OS_NO_ERR;
+}
+
+OS_EVENT *OSSemCreate(INT16U cnt) {
+	if(event_count >= MAX_EVENTS)
+		return NULL;
+
+	events[event_count].OSEventCnt = cnt;
+	return &events[event_count++];
+}
+
+void OSSemPend(OS_EVENT *pevent, INT16U timeout, INT8U *perr) {
+	if(pevent->OSEventCnt > 0) {
+		pevent->OSEventCnt--;
+		*perr = OS_NO_ERR;
+	}
+	else {
+		*perr = OS_TIMEOUT;
+	}
+}
+
+INT8U OSSemPost(OS_EVENT *pevent) {
+	pevent->OSEventCnt++;
+	return OS_NO_ERR;
+}
+
+INT16U OSSemAccept(OS_EVENT *pevent) {
+	INT16U cnt = pevent->OSEventCnt;
+
+	if(cnt > 0)
+		pevent->OSEventCnt--;
+	return cnt;
+}
+
+OS_EVENT *OSMutexCreate(INT8U prio, INT8U *perr) {
+	OS_EVENT *pevent = OSSemCreate(1);
+
+	*perr = pevent ? OS_NO_ERR : OS_TIMEOUT;
+	return pevent;
+}
+
+void OSMutexPend(OS_EVENT *pevent, INT16U timeout, INT8U *perr) {
+	OSSemPend(pevent, timeout, perr);
+}
+
+INT8U OSMutexPost(OS_EVENT *pevent) {
+	return OSSemPost(pevent);
+}
+
+OS_MEM *OSMemCreate(void *addr, INT32U nblks, INT32U blksize, INT8U *perr) {
+	OS_MEM *pmem;
+
+	if(partition_count >= MAX_PARTITIONS || nblks > 32) {
+		*perr = OS_MEM_NO_FREE_BLKS;
+		return NULL;
+	}
+
+	pmem = &partitions[partition_count++];
+	pmem->addr       = addr;
+	pmem->blocks     = nblks;
+	pmem->block_size = blksize;
+	pmem->used       = 0;
+
+	*perr = OS_NO_ERR;
+	return pmem;
+}
+
+void *OSMemGet(OS_MEM *pmem, INT8U *perr) {
+	INT32U i;
+
+	for(i=0; i<pmem->blocks; i++) {
+		if(!(pmem->used & (1u << i))) {
+			pmem->used |= 1u << i;
+			*perr = OS_NO_ERR;
+			return pmem->addr + i * pmem->block_size;
+		}
+	}
+
+	*perr = OS_MEM_NO_FREE_BLKS;
+	return NULL;
+}
+
+INT8U OSMemPut(OS_MEM *pmem, void *pblk) {
+	INT32U i = ((alt_u8 *) pblk - pmem->addr) / pmem->block_size;
+
+	pmem->used &= ~(1u << i);
+	return OS_NO_ERR;
+}
@@ -0,0 +1,19 @@
+/*
+ * os_stubs.h
+ *
+ * Control over the host stand-ins of MicroC-OS for the tests.
+ */
+
+#ifndef OS_STUBS_H_
+#define OS_STUBS_H_
+
+/**
+ * Run a task until it calls OSTimeDly, i.e. one pass of the loop of the task.
+ * The tasks are never started by OSTaskCreateExt, so the tests run them with this function.
+ *
+ * @param task the function of the task
+ * @param pdata passed to the task
+ */
+void host_task_step(void (*task)(void *), void *pdata);
+
+#endif /* OS_STUBS_H_ */
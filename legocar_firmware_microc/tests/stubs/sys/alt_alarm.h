@@ -0,0 +1,20 @@
+/*
+ * alt_alarm.h
+ *
+ * Host stand-in for the header of the Altera HAL (see hal_stubs.c).
+ */
+
+#ifndef ALT_ALARM_H_
+#define ALT_ALARM_H_
+
+#include "alt_types.h"
+
+typedef struct alt_alarm_s { int unused; } alt_alarm;
+
+int  alt_alarm_start(alt_alarm *alarm, alt_u32 nticks, alt_u32 (*callback)(void *), void *context);
+void alt_alarm_stop(alt_alarm *alarm);
+
+alt_u32 alt_nticks(void);
+alt_u32 alt_ticks_per_second(void);
+
+#endif /* ALT_ALARM_H_ */
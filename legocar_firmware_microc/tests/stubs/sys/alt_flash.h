@@ -0,0 +1,20 @@
+/*
+ * alt_flash.h
+ *
+ * Host stand-in for the header of the Altera HAL (see flash_file.c).
+ */
+
+#ifndef ALT_FLASH_H_
+#define ALT_FLASH_H_
+
+#include "alt_flash_types.h"
+
+alt_flash_fd *alt_flash_open_dev(const char *name);
+void alt_flash_close_dev(alt_flash_fd *fd);
+int  alt_get_flash_info(alt_flash_fd *fd, flash_region **info, int *number_of_regions);
+int  alt_read_flash(alt_flash_fd *fd, int offset, void *dest_addr, int length);
+int  alt_write_flash(alt_flash_fd *fd, int offset, const void *src_addr, int length);
+int  alt_write_flash_block(alt_flash_fd *fd, int block_offset, int data_offset, const void *data, int length);
+int  alt_erase_flash_block(alt_flash_fd *fd, int offset, int length);
+
+#endif /* ALT_FLASH_H_ */
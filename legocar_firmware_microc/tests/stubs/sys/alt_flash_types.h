@@ -0,0 +1,21 @@
+/*
+ * alt_flash_types.h
+ *
+ * Host stand-in for the header of the Altera HAL.
+ */
+
+#ifndef ALT_FLASH_TYPES_H_
+#define ALT_FLASH_TYPES_H_
+
+#define ALT_MAX_NUMBER_OF_FLASH_REGIONS 8
+
+typedef struct flash_region {
+	int offset;
+	int region_size;
+	int number_of_blocks;
+	int block_size;
+} flash_region;
+
+typedef struct alt_flash_dev alt_flash_fd;
+
+#endif /* ALT_FLASH_TYPES_H_ */
@@ -0,0 +1,19 @@
+/*
+ * alt_irq.h
+ *
+ * Host stand-in for the header of the Altera HAL (see hal_stubs.c).
+ */
+
+#ifndef ALT_IRQ_H_
+#define ALT_IRQ_H_
+
+#include "alt_types.h"
+
+typedef alt_u32 alt_irq_context;
+typedef void (*alt_isr_func)(void *context);
+
+alt_irq_context alt_irq_disable_all(void);
+void alt_irq_enable_all(alt_irq_context context);
+int  alt_ic_isr_register(alt_u32 ic_id, alt_u32 irq, alt_isr_func isr, void *context, void *flags);
+
+#endif /* ALT_IRQ_H_ */
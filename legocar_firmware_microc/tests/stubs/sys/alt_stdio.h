@@ -0,0 +1,14 @@
+/*
+ * alt_stdio.h
+ *
+ * Host stand-in for the header of the Altera HAL.
+ */
+
+#ifndef ALT_STDIO_H_
+#define ALT_STDIO_H_
+
+#include <stdio.h>
+
+#define alt_printf printf
+
+#endif /* ALT_STDIO_H_ */
@@ -0,0 +1,19 @@
+/*
+ * alt_timestamp.h
+ *
+ * Host stand-in for the header of the Altera HAL. Like on the SOPC of the car, there is
+ * no timestamp timer (see hal_stubs.c).
+ */
+
+#ifndef ALT_TIMESTAMP_H_
+#define ALT_TIMESTAMP_H_
+
+#include "alt_types.h"
+
+typedef alt_u32 alt_timestamp_type;
+
+int alt_timestamp_start(void);
+alt_timestamp_type alt_timestamp(void);
+alt_u32 alt_timestamp_freq(void);
+
+#endif /* ALT_TIMESTAMP_H_ */
@@ -0,0 +1,17 @@
+/*
+ * system.h
+ *
+ * Host stand-in for the generated header of the SOPC. The base addresses are never
+ * dereferenced by the tests, which pass their own register files.
+ */
+
+#ifndef SYSTEM_H_
+#define SYSTEM_H_
+
+#define GSENSOR_SPI_BASE 0x4000800
+#define I2C_SCL_BASE     0x4000840
+#define I2C_SDA_BASE     0x4000850
+#define EPCS_NAME        "/dev/epcs"
+#define ALT_CPU_FREQ     50000000
+
+#endif /* SYSTEM_H_ */
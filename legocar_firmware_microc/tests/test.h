@@ -0,0 +1,43 @@
+/*
+ * test.h
+ *
+ * Minimal checks for the host tests: every failed check is printed, 'test_result' is the
+ * exit code of the test program.
+ */
+
+#ifndef TEST_H_
+#define TEST_H_
+
+#include <stdio.h>
+
+static int test_checks   = 0;
+static int test_failures = 0;
+
+#define CHECK(condition) do { \
+		test_checks++; \
+		if(!(condition)) { \
+			test_failures++; \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+		} \
+	} while(0)
+
+#define CHECK_EQUAL(actual, expected) do { \
+		long long a_ = (long long) (actual), e_ = (long long) (expected); \
+		test_checks++; \
+		if(a_ != e_) { \
+			test_failures++; \
+			printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, a_, e_); \
+		} \
+	} while(0)
+
+/**
+ * Print the summary of the checks.
+ *
+ * @result exit code: 0 if all checks passed, 1 else
+ */
+static int test_result(const char *name) {
+	printf("%s: %d checks, %d failed\n", name, test_checks, test_failures);
+	return test_failures != 0;
+}
+
+#endif /* TEST_H_ */
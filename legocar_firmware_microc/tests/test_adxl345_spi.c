@@ -0,0 +1,132 @@
+/*
+ * test_adxl345_spi.c
+ *
+ * Decoding of ADXL345_SPI_ReadStatusAndXYZ against a register file of the sensor that
+ * stands in for the SPI layer (terasic_spi.c): status and data have to come from one
+ * burst starting at INT_SOURCE.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "../terasic_lib/terasic_includes.h"
+#include "../terasic_lib/accelerometer_adxl345_spi.h"
+#include "../terasic_lib/terasic_spi.h"
+
+#define SENSOR_BASE 0x1000
+
+// registers of the sensor and the transactions on the bus
+static alt_u8 registers[64];
+static int    transactions = 0;
+static alt_u8 last_index   = 0;
+static alt_u8 last_length  = 0;
+static bool   bus_ok       = TRUE;
+
+
+void SPI_Init(alt_u32 spi_base) {
+}
+
+bool SPI_MultipleWrite(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 szData[], alt_u8 nByteNum) {
+	transactions++;
+	memcpy(&registers[RegIndex], szData, nByteNum);
+	return bus_ok;
+}
+
+bool SPI_Write(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 Value) {
+	return SPI_MultipleWrite(spi_base, RegIndex, &Value, 1);
+}
+
+bool SPI_MultipleRead(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 szBuf[], alt_u8 nByteNum) {
+	transactions++;
+	last_index  = RegIndex;
+	last_length = nByteNum;
+	if(bus_ok)
+		memcpy(szBuf, &registers[RegIndex], nByteNum);
+	return bus_ok;
+}
+
+bool SPI_Read(alt_u32 spi_base, alt_u8 RegIndex, alt_u8 *pBuf) {
+	return SPI_MultipleRead(spi_base, RegIndex, pBuf, 1);
+}
+
+
+static void set_sample(alt_u8 int_source, alt_16 x, alt_16 y, alt_16 z) {
+	registers[ADXL345_REG_INT_SOURCE] = int_source;
+	registers[ADXL345_REG_DATA_FORMAT] = XL345_SPI3WIRE;
+	registers[ADXL345_REG_DATAX0] = x & 0xFF;
+	registers[ADXL345_REG_DATAX1] = (x >> 8) & 0xFF;
+	registers[ADXL345_REG_DATAY0] = y & 0xFF;
+	registers[ADXL345_REG_DATAY1] = (y >> 8) & 0xFF;
+	registers[ADXL345_REG_DATAZ0] = z & 0xFF;
+	registers[ADXL345_REG_DATAZ1] = (z >> 8) & 0xFF;
+}
+
+static void test_burst(void) {
+	alt_u8 int_source = 0;
+	alt_u16 data[3] = { 0, 0, 0 };
+
+	set_sample(XL345_DATAREADY | XL345_WATERMARK, 12, -3, 245);
+	transactions = 0;
+
+	CHECK(ADXL345_SPI_ReadStatusAndXYZ(SENSOR_BASE, &int_source, data));
+
+	// one burst of 8 bytes from INT_SOURCE (0x30) to DATAZ1 (0x37)
+	CHECK_EQUAL(transactions, 1);
+	CHECK_EQUAL(last_index, 0x30);
+	CHECK_EQUAL(last_length, 8);
+	CHECK_EQUAL(ADXL345_REG_DATAZ1 - ADXL345_REG_INT_SOURCE + 1, 8);
+
+	CHECK_EQUAL(int_source, XL345_DATAREADY | XL345_WATERMARK);
+	CHECK_EQUAL((alt_16) data[0], 12);
+	CHECK_EQUAL((alt_16) data[1], -3);
+	CHECK_EQUAL((alt_16) data[2], 245);
+}
+
+static void test_sign_extension(void) {
+	const alt_16 values[] = { -1, -256, -255, 255, 256, -32768, 32767, -512, 511 };
+	alt_u8 int_source;
+	alt_u16 data[3];
+	unsigned int i;
+
+	// the caller reads the data as alt_16 (see wait_for_data)
+	for(i=0; i<sizeof(values)/sizeof(values[0]); i++) {
+		set_sample(XL345_DATAREADY, values[i], -values[i], values[i] / 2);
+		CHECK(ADXL345_SPI_ReadStatusAndXYZ(SENSOR_BASE, &int_source, data));
+		CHECK_EQUAL((alt_16) data[0], values[i]);
+		CHECK_EQUAL((alt_16) data[1], (alt_16) -values[i]);
+		CHECK_EQUAL((alt_16) data[2], values[i] / 2);
+	}
+}
+
+static void test_data_ready(void) {
+	alt_u8 int_source = 0xFF;
+	alt_u16 data[3];
+
+	// no new data: the read succeeds, but the status tells the caller to drop the data
+	set_sample(XL345_WATERMARK, 1, 2, 3);
+	CHECK(ADXL345_SPI_ReadStatusAndXYZ(SENSOR_BASE, &int_source, data));
+	CHECK((int_source & XL345_DATAREADY) == 0);
+
+	// the status belongs to the data of the same burst
+	set_sample(XL345_DATAREADY, 4, 5, 6);
+	CHECK(ADXL345_SPI_ReadStatusAndXYZ(SENSOR_BASE, &int_source, data));
+	CHECK(int_source & XL345_DATAREADY);
+	CHECK_EQUAL((alt_16) data[0], 4);
+
+	// a failing transfer leaves the data and the status alone
+	int_source = 0x5A;
+	data[0] = 0x1234;
+	bus_ok = FALSE;
+	CHECK(!ADXL345_SPI_ReadStatusAndXYZ(SENSOR_BASE, &int_source, data));
+	CHECK_EQUAL(int_source, 0x5A);
+	CHECK_EQUAL(data[0], 0x1234);
+	bus_ok = TRUE;
+}
+
+int main(void) {
+	test_burst();
+	test_sign_extension();
+	test_data_ready();
+
+	return test_result("test_adxl345_spi");
+}
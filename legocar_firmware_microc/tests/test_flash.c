@@ -0,0 +1,505 @@
+/*
+ * test_flash.c
+ *
+ * The flash driver (flash.c) on a file that stands in for the flash (stubs/flash_file.c),
+ * with the geometry of the EPCS and of flashes with several regions:
+ * the block lookup through the index of Flash_Open has to agree with a linear scan of the
+ * regions, as the driver did before. The time of both lookups is printed for comparison.
+ * The read cache is compared with a copy of the content in the RAM over random reads, writes
+ * and erases, also through two handles that share the lines.
+ * The handles and the buffers of FLASH_Verify come from pools: their counters have to return
+ * to zero, and an exhausted pool has to be reported instead of being overrun.
+ * A manifest of the CRCs of the blocks has to survive the round trip through the flash, a damaged
+ * manifest has to be rejected and the check in steps has to find changed and unreadable blocks.
+ */
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "test.h"
+#include "flash_file.h"
+#include "includes.h"
+#include "../terasic_lib/terasic_includes.h"
+#include "../terasic_lib/flash.h"
+
+#define LOOKUPS 1000000
+
+// the random accesses to the cache stay around the end of the first block
+#define CACHE_OPERATIONS 200000
+#define CACHE_WINDOW     (4 * FLASH_CACHE_LINE_NUM * FLASH_CACHE_LINE_SIZE)
+#define CACHE_START      (FLASH_FILE_BLOCK_SIZE - CACHE_WINDOW / 2)
+
+typedef struct FlashLayout {
+	const char *name;
+	int number_of_regions;
+	flash_region regions[ALT_MAX_NUMBER_OF_FLASH_REGIONS];
+} FlashLayout;
+
+// offset and region size are computed by flash_file_set_regions
+static const FlashLayout layouts[] = {
+	{ "EPCS16, 32 x 64K",   1, { { 0, 0, 32, 65536 } } },
+	{ "512 x 4K",           1, { { 0, 0, 512, 4096 } } },
+	{ "boot blocks, 8 x 8K + 31 x 64K", 2, { { 0, 0, 8, 8192 }, { 0, 0, 31, 65536 } } },
+	{ "top and bottom boot blocks, 4K/8K/32K + 30 x 64K + 32K/8K/4K", 7,
+	  { { 0, 0, 4, 4096 }, { 0, 0, 2, 8192 }, { 0, 0, 1, 32768 }, { 0, 0, 30, 65536 },
+	    { 0, 0, 1, 32768 }, { 0, 0, 2, 8192 }, { 0, 0, 4, 4096 } } },
+	{ "8 regions", 8,
+	  { { 0, 0, 16, 4096 }, { 0, 0, 8, 8192 }, { 0, 0, 4, 16384 }, { 0, 0, 2, 32768 },
+	    { 0, 0, 24, 65536 }, { 0, 0, 2, 32768 }, { 0, 0, 4, 16384 }, { 0, 0, 8, 8192 } } },
+};
+
+#define LAYOUT_COUNT ((int) (sizeof(layouts) / sizeof(layouts[0])))
+
+// keeps the compiler from dropping the timed lookups
+static volatile alt_u32 sink;
+
+
+/**
+ * Find a block by scanning all regions (the lookup of the flash driver before the index).
+ */
+static int scan_block(const flash_region *regions, int number_of_regions, int block_index, alt_u32 *offset, alt_u32 *size) {
+	int r, i, block_count = 0;
+
+	*offset = 0;
+	for(r=0; r<number_of_regions; r++)
+		for(i=0; i<regions[r].number_of_blocks; i++) {
+			if(block_count == block_index) {
+				*size = regions[r].block_size;
+				return 1;
+			}
+			*offset += regions[r].block_size;
+			block_count++;
+		}
+
+	return 0;
+}
+
+/**
+ * Find the block containing an offset by scanning all regions.
+ */
+static int scan_offset(const flash_region *regions, int number_of_regions, alt_u32 offset, int *block_index) {
+	alt_u32 start = 0;
+	int r, i, block_count = 0;
+
+	for(r=0; r<number_of_regions; r++)
+		for(i=0; i<regions[r].number_of_blocks; i++) {
+			if(offset < start + regions[r].block_size) {
+				*block_index = block_count;
+				return 1;
+			}
+			start += regions[r].block_size;
+			block_count++;
+		}
+
+	return 0;
+}
+
+static double ns_per_lookup(clock_t start, clock_t end) {
+	return (double) (end - start) / CLOCKS_PER_SEC * 1e9 / LOOKUPS;
+}
+
+
+static void test_lookup(const FlashLayout *layout) {
+	FLASH_HANDLE flash;
+	alt_u32 expected_offset, expected_size, any_offset, flash_size = 0;
+	alt_32 offset, size;
+	alt_u16 block;
+	int b, r, expected_block, blocks = 0, mismatches = 0;
+	unsigned int random = 1;
+	clock_t start, end;
+	double ns_scan, ns_index;
+
+	CHECK(flash_file_set_regions(layout->regions, layout->number_of_regions));
+	CHECK(flash_file_open(NULL));
+	flash = Flash_Open(EPCS_NAME);
+	CHECK(flash != NULL);
+	if(!flash)
+		return;
+
+	for(r=0; r<layout->number_of_regions; r++) {
+		blocks     += layout->regions[r].number_of_blocks;
+		flash_size += layout->regions[r].number_of_blocks * layout->regions[r].block_size;
+	}
+	CHECK_EQUAL(Flash_GetBlockCount(flash), blocks);
+
+	// every block: its offset and size, and its first and last byte have to lead back to it
+	for(b=0; b<blocks; b++) {
+		scan_block(layout->regions, layout->number_of_regions, b, &expected_offset, &expected_size);
+		if(!Flash_GetBlockInfo(flash, b, &offset, &size)
+		   || (alt_u32) offset != expected_offset || (alt_u32) size != expected_size
+		   || !Flash_GetBlockIndex(flash, offset, &block) || block != b
+		   || !Flash_GetBlockIndex(flash, offset + size - 1, &block) || block != b)
+			mismatches++;
+	}
+	CHECK_EQUAL(mismatches, 0);
+
+	// offsets anywhere in the flash
+	for(b=0; b<100000; b++) {
+		random = random * 1103515245 + 12345;
+		any_offset = random % flash_size;
+		if(!scan_offset(layout->regions, layout->number_of_regions, any_offset, &expected_block)
+		   || !Flash_GetBlockIndex(flash, any_offset, &block) || block != expected_block)
+			mismatches++;
+	}
+	CHECK_EQUAL(mismatches, 0);
+
+	// nothing beyond the end
+	CHECK(!Flash_GetBlockInfo(flash, blocks, &offset, &size));
+	CHECK(!Flash_GetBlockIndex(flash, flash_size, &block));
+	CHECK(!scan_block(layout->regions, layout->number_of_regions, blocks, &expected_offset, &expected_size));
+
+	// the last blocks are the worst case for the scan
+	start = clock();
+	for(b=0; b<LOOKUPS; b++) {
+		scan_block(layout->regions, layout->number_of_regions, blocks - 1 - (b & 1), &expected_offset, &expected_size);
+		sink = expected_offset;
+	}
+	end = clock();
+	ns_scan = ns_per_lookup(start, end);
+
+	start = clock();
+	for(b=0; b<LOOKUPS; b++) {
+		Flash_GetBlockInfo(flash, blocks - 1 - (b & 1), &offset, &size);
+		sink = offset;
+	}
+	end = clock();
+	ns_index = ns_per_lookup(start, end);
+
+	printf("  flash lookup, %s (%d blocks): scan %.1f ns, index %.1f ns\n", layout->name, blocks, ns_scan, ns_index);
+
+	Flash_Close(flash);
+	flash_file_close();
+}
+
+// content of the first two blocks of the flash
+static alt_u8 shadow[2 * FLASH_FILE_BLOCK_SIZE];
+
+static unsigned int cache_random = 1;
+
+static alt_u32 next_random(alt_u32 range) {
+	cache_random = cache_random * 1103515245 + 12345;
+	return (cache_random >> 8) % range;
+}
+
+static void test_cache_straddling_write(void) {
+	FLASH_HANDLE flash;
+	alt_u8 data[4] = { 0x12, 0x34, 0x56, 0x78 }, read[2 * FLASH_CACHE_LINE_SIZE];
+	FLASH_CACHE_STATS stats;
+
+	CHECK(flash_file_open(NULL));
+	Flash_InvalidateCache();
+	flash = Flash_Open(EPCS_NAME);
+	CHECK(flash != NULL);
+	if(!flash)
+		return;
+
+	// both lines are in the cache, then a write covers the end of the first and the start of the second
+	CHECK(Flash_Read(flash, 0, read, sizeof(read)));
+	Flash_ResetCacheStats();
+	CHECK(Flash_Write(flash, FLASH_CACHE_LINE_SIZE - 2, data, sizeof(data)));
+	Flash_GetCacheStats(&stats);
+	CHECK_EQUAL(stats.nInvalidate, 2);
+
+	CHECK(Flash_Read(flash, 0, read, sizeof(read)));
+	CHECK(memcmp(read + FLASH_CACHE_LINE_SIZE - 2, data, sizeof(data)) == 0);
+	CHECK_EQUAL(read[FLASH_CACHE_LINE_SIZE - 3], 0xFF);
+	CHECK_EQUAL(read[FLASH_CACHE_LINE_SIZE + 2], 0xFF);
+
+	// the erase drops the lines of the block only
+	CHECK(Flash_Read(flash, FLASH_FILE_BLOCK_SIZE, read, 1));
+	Flash_ResetCacheStats();
+	CHECK(Flash_Erase(flash, 0));
+	Flash_GetCacheStats(&stats);
+	CHECK_EQUAL(stats.nInvalidate, 2);
+	CHECK(Flash_Read(flash, FLASH_CACHE_LINE_SIZE - 2, read, sizeof(data)));
+	CHECK_EQUAL(read[0] & read[1] & read[2] & read[3], 0xFF);
+
+	Flash_Close(flash);
+	flash_file_close();
+}
+
+static void test_cache_random(void) {
+	FLASH_HANDLE flash[2];
+	alt_u8 data[FLASH_CACHE_BYPASS_SIZE + FLASH_CACHE_LINE_SIZE];
+	FLASH_CACHE_STATS stats;
+	alt_u32 offset, size, i, n;
+	alt_u16 block;
+	int mismatches = 0, failures = 0, operation;
+	FILE *file;
+
+	CHECK(flash_file_open(NULL));
+	file = flash_file();
+	Flash_InvalidateCache();
+	Flash_ResetCacheStats();
+	flash[0] = Flash_Open(EPCS_NAME);
+	flash[1] = Flash_Open(EPCS_NAME);
+	CHECK(flash[0] != NULL && flash[1] != NULL);
+	if(!flash[0] || !flash[1])
+		return;
+	memset(shadow, 0xFF, sizeof(shadow));
+
+	for(n=0; n<CACHE_OPERATIONS; n++) {
+		operation = next_random(100);
+		offset    = CACHE_START + next_random(CACHE_WINDOW);
+
+		if(operation < 85) {
+			// mostly small records, sometimes reads that bypass the cache
+			size = next_random(8) == 0 ? next_random(sizeof(data)) + 1 : next_random(64) + 1;
+			if(offset + size > CACHE_START + CACHE_WINDOW)
+				size = CACHE_START + CACHE_WINDOW - offset;
+			if(!Flash_Read(flash[n & 1], offset, data, size))
+				failures++;
+			else if(memcmp(data, shadow + offset, size) != 0)
+				mismatches++;
+		}
+		else if(operation < 97) {
+			// programming only clears bits, a write may cross lines and the end of the block
+			size = next_random(3 * FLASH_CACHE_LINE_SIZE) + 1;
+			if(offset + size > CACHE_START + CACHE_WINDOW)
+				size = CACHE_START + CACHE_WINDOW - offset;
+			for(i=0; i<size; i++) {
+				data[i] = next_random(256) | next_random(256);
+				shadow[offset + i] &= data[i];
+			}
+			if(!Flash_Write(flash[next_random(2)], offset, data, size))
+				failures++;
+		}
+		else if(operation < 99) {
+			block = next_random(2);
+			memset(shadow + block * FLASH_FILE_BLOCK_SIZE, 0xFF, FLASH_FILE_BLOCK_SIZE);
+			if(!Flash_Erase(flash[next_random(2)], block))
+				failures++;
+		}
+		else {
+			// written around the driver, which has to be told
+			shadow[offset] = next_random(256);
+			fseek(file, offset, SEEK_SET);
+			fputc(shadow[offset], file);
+			fflush(file);
+			Flash_InvalidateCache();
+		}
+	}
+
+	CHECK_EQUAL(failures, 0);
+	CHECK_EQUAL(mismatches, 0);
+
+	// the flash itself holds the same
+	for(offset=0; offset<sizeof(shadow); offset+=FLASH_CACHE_BYPASS_SIZE) {
+		if(!Flash_Read(flash[0], offset, data, FLASH_CACHE_BYPASS_SIZE) || memcmp(data, shadow + offset, FLASH_CACHE_BYPASS_SIZE) != 0)
+			mismatches++;
+	}
+	CHECK_EQUAL(mismatches, 0);
+
+	Flash_GetCacheStats(&stats);
+	CHECK(stats.nHit > 0);
+	CHECK(stats.nMiss > 0);
+	CHECK(stats.nBypass > 0);
+	CHECK(stats.nInvalidate > 0);
+	printf("  flash cache, %d operations: %lu hits, %lu misses, %lu bypassed, %lu invalidated\n", CACHE_OPERATIONS,
+	       (unsigned long) stats.nHit, (unsigned long) stats.nMiss, (unsigned long) stats.nBypass, (unsigned long) stats.nInvalidate);
+
+	Flash_Close(flash[0]);
+	Flash_Close(flash[1]);
+	flash_file_close();
+}
+
+static void test_handle_pool(void) {
+	FLASH_HANDLE flash[FLASH_HANDLE_NUM];
+	FLASH_ALLOC_STATS before, stats;
+	int h;
+
+	CHECK(flash_file_open(NULL));
+	Flash_GetAllocStats(&before);
+	CHECK_EQUAL(before.nHandleUsed, 0);
+
+	for(h=0; h<FLASH_HANDLE_NUM; h++) {
+		flash[h] = Flash_Open(EPCS_NAME);
+		CHECK(flash[h] != NULL);
+	}
+
+	// all handles are open
+	CHECK(Flash_Open(EPCS_NAME) == NULL);
+	Flash_GetAllocStats(&stats);
+	CHECK_EQUAL(stats.nHandleUsed, FLASH_HANDLE_NUM);
+	CHECK_EQUAL(stats.nHandleMax, FLASH_HANDLE_NUM);
+	CHECK_EQUAL(stats.nHandleFail, before.nHandleFail + 1);
+
+	// a closed handle can be taken again, closing it twice does not free another one
+	CHECK(Flash_Close(flash[1]));
+	CHECK(!Flash_Close(flash[1]));
+	Flash_GetAllocStats(&stats);
+	CHECK_EQUAL(stats.nHandleUsed, FLASH_HANDLE_NUM - 1);
+	flash[1] = Flash_Open(EPCS_NAME);
+	CHECK(flash[1] != NULL);
+	CHECK(Flash_Open(EPCS_NAME) == NULL);
+
+	for(h=0; h<FLASH_HANDLE_NUM; h++)
+		CHECK(Flash_Close(flash[h]));
+	Flash_GetAllocStats(&stats);
+	CHECK_EQUAL(stats.nHandleUsed, 0);
+
+	// without a device, the handle is given back
+	flash_file_close();
+	CHECK(Flash_Open(EPCS_NAME) == NULL);
+	Flash_GetAllocStats(&stats);
+	CHECK_EQUAL(stats.nHandleUsed, 0);
+	CHECK_EQUAL(stats.nHandleFail, before.nHandleFail + 2);
+}
+
+static void test_verify_buffers(void) {
+	static alt_u8 partition[2][4096], buffer[4096];
+	FLASH_ALLOC_STATS before, stats;
+	OS_MEM *memory;
+	void *taken[2];
+	INT8U err;
+
+	CHECK(flash_file_open(NULL));
+	Flash_InvalidateCache();
+	Flash_GetAllocStats(&before);
+
+	// no partition set
+	CHECK(!FLASH_Verify(EPCS_NAME, 0x5A, FALSE, TRUE));
+	Flash_GetAllocStats(&stats);
+	CHECK_EQUAL(stats.nBufferFail, before.nBufferFail + 1);
+	CHECK_EQUAL(stats.nBufferUsed, 0);
+
+	// a buffer from the partition, given back afterwards
+	memory = OSMemCreate(partition, 2, sizeof(partition[0]), &err);
+	CHECK(memory != NULL);
+	if(!memory)
+		return;
+	Flash_SetBufferPartition(memory, sizeof(partition[0]));
+	CHECK(FLASH_Verify(EPCS_NAME, 0x5A, FALSE, TRUE));
+	Flash_GetAllocStats(&stats);
+	CHECK_EQUAL(stats.nBufferUsed, 0);
+	CHECK_EQUAL(stats.nBufferMax, 1);
+	CHECK_EQUAL(stats.nHandleUsed, 0);
+
+	// the partition is exhausted
+	taken[0] = OSMemGet(memory, &err);
+	taken[1] = OSMemGet(memory, &err);
+	CHECK(!FLASH_Verify(EPCS_NAME, 0x5A, FALSE, TRUE));
+	Flash_GetAllocStats(&stats);
+	CHECK_EQUAL(stats.nBufferFail, before.nBufferFail + 2);
+	CHECK_EQUAL(stats.nBufferUsed, 0);
+
+	// the buffer of the caller does not touch the partition
+	CHECK(FLASH_VerifyBuffer(EPCS_NAME, 0xA5, FALSE, TRUE, buffer, sizeof(buffer)));
+	CHECK(!FLASH_VerifyBuffer(EPCS_NAME, 0xA5, FALSE, TRUE, NULL, sizeof(buffer)));
+	Flash_GetAllocStats(&stats);
+	CHECK_EQUAL(stats.nBufferFail, before.nBufferFail + 2);
+	CHECK_EQUAL(stats.nBufferUsed, 0);
+	CHECK_EQUAL(stats.nHandleUsed, 0);
+
+	OSMemPut(memory, taken[0]);
+	OSMemPut(memory, taken[1]);
+	Flash_SetBufferPartition(NULL, 0);
+	flash_file_close();
+}
+
+/**
+ * Check all blocks of a manifest, one block per step.
+ */
+static int verify_in_steps(FLASH_HANDLE flash, const FLASH_MANIFEST *manifest, FLASH_VERIFY_STATE *state, alt_u8 *buffer, int size) {
+	int steps = 1;
+
+	Flash_VerifyStart(state);
+	while(!Flash_VerifyStep(flash, manifest, state, 1, buffer, size))
+		steps++;
+
+	return steps;
+}
+
+static void test_manifest(void) {
+	static FLASH_MANIFEST manifest, loaded;
+	static alt_u8 buffer[4096];
+	FLASH_VERIFY_STATE state;
+	FLASH_HANDLE flash;
+	alt_u8 data[64];
+	alt_32 offset, size;
+	int i;
+
+	CHECK(flash_file_open(NULL));
+	Flash_InvalidateCache();
+	flash = Flash_Open(EPCS_NAME);
+	CHECK(flash != NULL);
+	if(!flash)
+		return;
+
+	// some content in the blocks 0 .. 3, the manifest in block 5
+	for(i=0; i<(int) sizeof(data); i++)
+		data[i] = i * 7;
+	for(i=0; i<4; i++) {
+		CHECK(Flash_GetBlockInfo(flash, i, &offset, &size));
+		CHECK(Flash_Write(flash, offset + 100 * i, data, sizeof(data)));
+	}
+
+	CHECK(Flash_ManifestBuild(flash, 0, 4, &manifest, buffer, sizeof(buffer)));
+	CHECK(!Flash_ManifestBuild(flash, 0, FLASH_MANIFEST_BLOCK_MAX + 1, &loaded, buffer, sizeof(buffer)));
+	CHECK(!Flash_ManifestLoad(flash, 5, &loaded));
+	CHECK(!Flash_ManifestStore(flash, 3, &manifest));
+	CHECK(Flash_ManifestStore(flash, 5, &manifest));
+	CHECK(Flash_ManifestLoad(flash, 5, &loaded));
+	CHECK(memcmp(&loaded, &manifest, sizeof(manifest)) == 0);
+
+	// the CRCs do not depend on the size of the buffer
+	CHECK(Flash_ManifestBuild(flash, 0, 4, &loaded, buffer, 1000));
+	CHECK(memcmp(&loaded, &manifest, sizeof(manifest)) == 0);
+
+	// unchanged
+	CHECK_EQUAL(verify_in_steps(flash, &manifest, &state, buffer, sizeof(buffer)), 4);
+	CHECK_EQUAL(state.nMismatch, 0);
+	CHECK_EQUAL(state.nError, 0);
+	CHECK_EQUAL(state.nFirstMismatch, -1);
+
+	// a byte cleared in block 2 and in block 3
+	data[0] = 0;
+	CHECK(Flash_GetBlockInfo(flash, 3, &offset, &size));
+	CHECK(Flash_Write(flash, offset + size - 1, data, 1));
+	CHECK(Flash_GetBlockInfo(flash, 2, &offset, &size));
+	CHECK(Flash_Write(flash, offset, data, 1));
+	verify_in_steps(flash, &manifest, &state, buffer, sizeof(buffer));
+	CHECK_EQUAL(state.nMismatch, 2);
+	CHECK_EQUAL(state.nError, 0);
+	CHECK_EQUAL(state.nFirstMismatch, 2);
+
+	// a block beyond the end of the flash cannot be read
+	CHECK(Flash_ManifestBuild(flash, FLASH_FILE_BLOCKS - 1, 1, &loaded, buffer, sizeof(buffer)));
+	loaded.BlockNum = 2;
+	verify_in_steps(flash, &loaded, &state, buffer, sizeof(buffer));
+	CHECK_EQUAL(state.nMismatch, 0);
+	CHECK_EQUAL(state.nError, 1);
+
+	// the stored manifest changed: the CRC of a block cleared
+	CHECK(Flash_GetBlockInfo(flash, 5, &offset, &size));
+	CHECK(manifest.szCrc[1] != 0);
+	memset(data, 0, sizeof(manifest.szCrc[1]));
+	CHECK(Flash_Write(flash, offset + offsetof(FLASH_MANIFEST, szCrc[1]), data, sizeof(manifest.szCrc[1])));
+	CHECK(!Flash_ManifestLoad(flash, 5, &loaded));
+
+	// an erased block holds no manifest
+	CHECK(Flash_Erase(flash, 5));
+	CHECK(!Flash_ManifestLoad(flash, 5, &loaded));
+
+	Flash_Close(flash);
+	flash_file_close();
+}
+
+
+int main(void) {
+	int l;
+
+	for(l=0; l<LAYOUT_COUNT; l++)
+		test_lookup(&layouts[l]);
+	flash_file_set_regions(NULL, 0);
+
+	test_cache_straddling_write();
+	test_cache_random();
+	test_handle_pool();
+	test_verify_buffers();
+	test_manifest();
+
+	return test_result("test_flash");
+}
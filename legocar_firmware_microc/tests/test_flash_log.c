@@ -0,0 +1,243 @@
+/*
+ * test_flash_log.c
+ *
+ * The telemetry log (flash_log.c) on a file that stands in for the EPCS (stubs/flash_file.c):
+ * records written over several boots have to be read back in order after the ring of blocks
+ * has wrapped, the blocks have to be erased equally often, and a record that has not been
+ * written completely (the power failed during the write) has to be skipped, with the log
+ * continuing in the next block.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+#include "flash_file.h"
+#include "hal_stubs.h"
+#include "os_stubs.h"
+
+// the module is included, so that the test can run the writer task and close the flash of a boot
+#include "../telemetry/flash_log.c"
+
+#define WRITER_PRIORITY 10
+#define LOCK_PRIORITY   9
+
+// the writer task runs after this number of records
+#define RECORDS_PER_PASS 50
+
+#define RECORD_SIZE (sizeof(FlashLogRecordHeader) + sizeof(FlashLogINS))
+
+
+/**
+ * Start the system again: the flash is opened and the log recovered from it.
+ */
+static void boot(void) {
+	if(flash_log.flash)
+		Flash_Close(flash_log.flash);
+	Flash_InvalidateCache();
+
+	CHECK(init_flash_log(EPCS_NAME));
+}
+
+static void start_writer(void) {
+	CHECK(start_flash_log_writer(WRITER_PRIORITY, LOCK_PRIORITY));
+}
+
+static void run_writer(void) {
+	host_task_step(flash_log_writer_task, NULL);
+}
+
+/**
+ * Add records with consecutive numbers, one per tick of the system timer.
+ */
+static void write_records(alt_u32 first, int count) {
+	FlashLogINS state;
+	int i, dropped = 0;
+
+	memset(&state, 0, sizeof(state));
+	for(i=0; i<count; i++) {
+		state.acceleration[0] = first + i;
+		if(!log_record(FLASH_LOG_INS, &state, sizeof(state)))
+			dropped++;
+		host_nticks++;
+
+		if(i % RECORDS_PER_PASS == RECORDS_PER_PASS - 1)
+			run_writer();
+	}
+	CHECK_EQUAL(dropped, 0);
+}
+
+/**
+ * Let the writer task write the records that do not fill a page.
+ */
+static void flush(void) {
+	run_writer();
+	host_nticks += FLASH_LOG_FLUSH_TICKS;
+	run_writer();
+	CHECK_EQUAL(flash_log.buffer_in, flash_log.buffer_out);
+	CHECK_EQUAL(flash_log.page_fill, 0);
+}
+
+typedef struct ReadBack {
+	int records;            // FLASH_LOG_INS records
+	int sessions;
+	int unknown;            // records of other types
+	int gaps;               // records whose number does not follow the previous one
+	alt_u32 first, last;    // numbers of the first and the last record
+} ReadBack;
+
+/**
+ * Read the whole log, from the oldest to the newest record.
+ */
+static void read_back(ReadBack *result) {
+	FlashLogCursor cursor;
+	FlashLogRecordHeader record;
+	FlashLogINS state;
+	alt_u32 number;
+
+	memset(result, 0, sizeof(*result));
+	if(!first_log_record(&cursor))
+		return;
+
+	while(next_log_record(&cursor, &record, &state)) {
+		if(record.type == FLASH_LOG_SESSION) {
+			result->sessions++;
+			continue;
+		}
+
+		if(record.type != FLASH_LOG_INS) {
+			result->unknown++;
+			continue;
+		}
+
+		number = state.acceleration[0];
+		if(result->records == 0)
+			result->first = number;
+		else if(number != result->last + 1)
+			result->gaps++;
+		result->last = number;
+		result->records++;
+	}
+}
+
+static void check_stats(alt_u32 records) {
+	FlashLogStats stats;
+
+	get_flash_log_stats(&stats);
+	CHECK_EQUAL(stats.records, records);
+	CHECK_EQUAL(stats.written, records);
+	CHECK_EQUAL(stats.dropped, 0);
+	CHECK_EQUAL(stats.errors, 0);
+	CHECK(stats.max_erase_count - stats.min_erase_count <= 1);
+}
+
+
+static void test_boots(void) {
+	const int boots = 6, records = 10000;
+	FlashLogStats stats;
+	ReadBack log;
+	int b;
+
+	CHECK(flash_file_open(NULL));
+	host_nticks = 0;
+
+	for(b=0; b<boots; b++) {
+		boot();
+
+		// the records of the previous boots are read before the writer task starts
+		read_back(&log);
+		if(b == 0) {
+			CHECK_EQUAL(log.records, 0);
+		}
+		else {
+			CHECK_EQUAL(log.last, b * records - 1);
+			CHECK_EQUAL(log.gaps, 0);
+			CHECK_EQUAL(log.unknown, 0);
+		}
+
+		start_writer();
+		write_records(b * records, records);
+		flush();
+
+		// the session record of the boot as well
+		check_stats(records + 1);
+	}
+
+	// 60000 records: the ring has wrapped several times, the oldest blocks hold the newest records
+	boot();
+	read_back(&log);
+	CHECK_EQUAL(log.last, boots * records - 1);
+	CHECK_EQUAL(log.gaps, 0);
+	CHECK(log.first > 0);
+	CHECK(log.sessions >= 1);
+	// all but the block that has been erased in advance are kept
+	CHECK(log.records >= (int) ((FLASH_LOG_BLOCKS - 2) * (FLASH_FILE_BLOCK_SIZE / RECORD_SIZE)));
+
+	// the erase counts are recovered from the headers of the blocks
+	start_writer();
+	flush();
+	check_stats(1);
+	get_flash_log_stats(&stats);
+	CHECK(stats.min_erase_count >= boots * records * RECORD_SIZE / (FLASH_LOG_BLOCKS * FLASH_FILE_BLOCK_SIZE));
+
+	flash_file_close();
+}
+
+static void test_torn_write(void) {
+	FILE *file;
+	alt_u8 unwritten[sizeof(FlashLogINS) / 2];
+	alt_u16 head;
+	alt_u32 sequence;
+	ReadBack log;
+
+	CHECK(flash_file_open(NULL));
+	file = flash_file();
+
+	boot();
+	start_writer();
+	write_records(0, 1000);
+	flush();
+	head     = flash_log.head;
+	sequence = flash_log.sequence;
+
+	// the power failed while the last record was written: the end of its payload is still erased
+	memset(unwritten, 0xFF, sizeof(unwritten));
+	fseek(file, flash_log.page_offset - sizeof(unwritten), SEEK_SET);
+	fwrite(unwritten, 1, sizeof(unwritten), file);
+	fflush(file);
+
+	// the rest of the head block is not erased completely, so it is not written anymore
+	boot();
+	CHECK_EQUAL(flash_log.head, head);
+	CHECK_EQUAL(flash_log.head_open, 0);
+
+	read_back(&log);
+	CHECK_EQUAL(log.records, 999);
+	CHECK_EQUAL(log.last, 998);
+
+	// the log continues in the next block
+	start_writer();
+	write_records(1000, 100);
+	flush();
+	CHECK_EQUAL(flash_log.head, (head + 1) % FLASH_LOG_BLOCKS);
+	CHECK_EQUAL(flash_log.sequence, sequence + 1);
+
+	// the reader skips the torn record
+	boot();
+	read_back(&log);
+	CHECK_EQUAL(log.records, 1099);
+	CHECK_EQUAL(log.first, 0);
+	CHECK_EQUAL(log.last, 1099);
+	CHECK_EQUAL(log.gaps, 1);
+	CHECK_EQUAL(log.sessions, 2);
+
+	flash_file_close();
+}
+
+
+int main(void) {
+	test_boots();
+	test_torn_write();
+
+	return test_result("test_flash_log");
+}
@@ -0,0 +1,150 @@
+/*
+ * test_i2c.c
+ *
+ * Calibration of the I2C bus clock against the system timer (the SOPC has no timestamp timer)
+ * and the log of the edges on the bus (I2C_TRACE): a write is decoded from the log, and the
+ * time stamps (iterations of the delay loop) have to show the calibrated half clocks.
+ */
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include "test.h"
+#include "hal_stubs.h"
+#include "../terasic_lib/terasic_includes.h"
+#include "../terasic_lib/I2C.h"
+
+// the registers of the PIOs (data, direction): the base addresses are alt_u32, so the
+// registers have to be in the lower 4 GB of the address space of the host
+static alt_u32 *registers;
+
+#define SCL_BASE ((alt_u32) (uintptr_t) &registers[0])
+#define SDA_BASE ((alt_u32) (uintptr_t) &registers[4])
+
+static I2C_TRACE_ENTRY trace[I2C_TRACE_SIZE];
+
+
+/**
+ * Decode the bytes between START and STOP from the log: a bit is taken at every rising edge
+ * of SCL, a byte consists of 8 bits and the ACK.
+ *
+ * @result number of bytes, -1: SDA has changed while SCL was high (except START and STOP)
+ */
+static int decode(const I2C_TRACE_ENTRY *entries, int num, alt_u8 *bytes, int *starts, int *stops) {
+	int scl_level = 1, sda_level = 1;
+	int bits = 0, count = 0, value = 0;
+	int i;
+
+	*starts = *stops = 0;
+	for(i=0; i<num; i++) {
+		if(entries[i].Line == 0) {
+			if(entries[i].Value && !scl_level) {
+				if(bits < 8)
+					value = (value << 1) | sda_level;
+				if(++bits == 9) {
+					bytes[count++] = value;
+					bits = value = 0;
+				}
+			}
+			scl_level = entries[i].Value;
+		}
+		else if(entries[i].Line == 1) {
+			if(scl_level && entries[i].Value != sda_level) {
+				if(entries[i].Value) {
+					(*stops)++;
+				}
+				else {
+					(*starts)++;
+					bits = value = 0;
+				}
+			}
+			sda_level = entries[i].Value;
+		}
+	}
+
+	return count;
+}
+
+/**
+ * Shortest time between a rising and the next falling edge of SCL (time steps of the log).
+ */
+static alt_u32 min_high_time(const I2C_TRACE_ENTRY *entries, int num) {
+	alt_u32 rise = 0, min = 0xFFFFFFFF;
+	int i;
+
+	for(i=0; i<num; i++) {
+		if(entries[i].Line != 0)
+			continue;
+		if(entries[i].Value)
+			rise = entries[i].Time;
+		else if(entries[i].Time - rise < min && rise != 0)
+			min = entries[i].Time - rise;
+	}
+
+	return min;
+}
+
+
+static void test_calibration_without_clock(void) {
+	// the system timer does not run (e.g. interrupts disabled): no calibration, but no hang either
+	host_nticks_step = 0;
+	CHECK_EQUAL(I2C_SetSpeed(SCL_BASE, I2C_SPEED_STANDARD), 0);
+	CHECK_EQUAL(I2C_GetBusClock(), 0);
+	CHECK_EQUAL(I2C_TraceFreq(), 0);
+}
+
+static void test_calibration(void) {
+	alt_u32 clock;
+
+	// one tick every 64 batches: 61035 ps per operation
+	host_nticks_step = 64;
+	clock = I2C_SetSpeed(SCL_BASE, I2C_SPEED_STANDARD);
+	host_nticks_step = 0;
+
+	CHECK(clock >= 95000 && clock <= 105000);
+	CHECK_EQUAL(I2C_GetBusClock(), clock);
+	CHECK_EQUAL(I2C_TraceFreq(), 1000000000000ULL / 61035);
+}
+
+static void test_trace_of_write(void) {
+	alt_u8 bytes[16];
+	int num, count, starts, stops;
+	alt_u32 high;
+
+	I2C_SetWriteTimeout(0);
+	I2C_TraceGet(trace, I2C_TRACE_SIZE);
+
+	// the data register of SDA reads the last bit written, 0 acknowledges every byte
+	CHECK(I2C_Write(SCL_BASE, SDA_BASE, 0xA0, 0x10, 0x42));
+
+	num = I2C_TraceGet(trace, I2C_TRACE_SIZE);
+	CHECK(num > 0 && num < I2C_TRACE_SIZE);
+
+	count = decode(trace, num, bytes, &starts, &stops);
+	CHECK_EQUAL(starts, 1);
+	CHECK_EQUAL(stops, 1);
+	CHECK_EQUAL(count, 3);
+	CHECK_EQUAL(bytes[0], 0xA0);
+	CHECK_EQUAL(bytes[1], 0x10);
+	CHECK_EQUAL(bytes[2], 0x42);
+
+	// the time stamps are iterations of the delay loop: SCL is high for at least 4 us (standard mode)
+	high = min_high_time(trace, num);
+	CHECK(high > 0 && high != 0xFFFFFFFF);
+	CHECK((alt_u64) high * 1000000 >= 4ULL * I2C_TraceFreq());
+}
+
+
+int main(void) {
+	registers = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	if(registers == MAP_FAILED) {
+		printf("test_i2c: cannot map the registers of the PIOs\n");
+		return 1;
+	}
+
+	test_calibration_without_clock();
+	test_calibration();
+	test_trace_of_write();
+
+	return test_result("test_i2c");
+}
@@ -0,0 +1,139 @@
+/*
+ * test_ins_storage.c
+ *
+ * Round trip of the calibration record through the flash driver (flash.c) and a file that
+ * stands in for the EPCS (stubs/flash_file.c): what is written has to be read back and
+ * accepted, a damaged record, erased flash or another sensor have to be rejected.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "test.h"
+#include "flash_file.h"
+#include "../terasic_lib/terasic_includes.h"
+#include "../terasic_lib/flash.h"
+#include "../acceleration_sensor/ins_storage.h"
+
+#define SENSOR_ID 0xE5
+
+// the record is at the start of the last block
+#define RECORD_OFFSET ((FLASH_FILE_BLOCKS - INS_CALIBRATION_BLOCK) * FLASH_FILE_BLOCK_SIZE)
+
+
+static void make_record(INSCalibrationRecord *record, alt_u32 sequence) {
+	static const double bias[CALIBRATOR_DIM]     = { 12.0, -7.5, 251.25 };
+	static const double variance[CALIBRATOR_DIM] = { 4.0, 3.5, 6.0 };
+	INSCalibrator cal;
+
+	init_ins_calibrator(&cal);
+	seed_ins_calibrator(&cal, bias, variance, 4096.0);
+	pack_ins_calibration(record, &cal, SENSOR_ID, sequence, 1000 * sequence);
+}
+
+/**
+ * Change the file behind the driver, which then has to drop its read cache.
+ */
+static void corrupt(long offset, alt_u8 mask) {
+	FILE *file = flash_file();
+	int c;
+
+	fseek(file, offset, SEEK_SET);
+	c = fgetc(file);
+	fseek(file, offset, SEEK_SET);
+	fputc(c ^ mask, file);
+	fflush(file);
+
+	Flash_InvalidateCache();
+}
+
+
+static void test_round_trip(void) {
+	INSCalibrationRecord written, read;
+
+	CHECK(flash_file_open(NULL));
+	Flash_InvalidateCache();
+
+	make_record(&written, 1);
+	CHECK(check_ins_calibration(&written, SENSOR_ID));
+	CHECK(write_ins_calibration(EPCS_NAME, &written));
+	CHECK_EQUAL(flash_file_erases, 1);
+
+	memset(&read, 0, sizeof(read));
+	CHECK(read_ins_calibration(EPCS_NAME, &read));
+	CHECK(memcmp(&read, &written, sizeof(read)) == 0);
+	CHECK(check_ins_calibration(&read, SENSOR_ID));
+
+	// the next record replaces the first one
+	make_record(&written, 2);
+	CHECK(write_ins_calibration(EPCS_NAME, &written));
+	CHECK(read_ins_calibration(EPCS_NAME, &read));
+	CHECK_EQUAL(read.sequence, 2);
+	CHECK(check_ins_calibration(&read, SENSOR_ID));
+
+	flash_file_close();
+}
+
+static void test_rejected(void) {
+	INSCalibrationRecord written, read;
+
+	CHECK(flash_file_open(NULL));
+	Flash_InvalidateCache();
+
+	// erased flash
+	CHECK(read_ins_calibration(EPCS_NAME, &read));
+	CHECK(!check_ins_calibration(&read, SENSOR_ID));
+
+	make_record(&written, 1);
+	CHECK(write_ins_calibration(EPCS_NAME, &written));
+
+	// another sensor
+	CHECK(read_ins_calibration(EPCS_NAME, &read));
+	CHECK(!check_ins_calibration(&read, SENSOR_ID + 1));
+
+	// a flipped bit in the bias is caught by the CRC
+	corrupt(RECORD_OFFSET + offsetof(INSCalibrationRecord, bias), 0x01);
+	CHECK(read_ins_calibration(EPCS_NAME, &read));
+	CHECK(!check_ins_calibration(&read, SENSOR_ID));
+
+	// a damaged CRC
+	CHECK(write_ins_calibration(EPCS_NAME, &written));
+	corrupt(RECORD_OFFSET + offsetof(INSCalibrationRecord, crc), 0xFF);
+	CHECK(read_ins_calibration(EPCS_NAME, &read));
+	CHECK(!check_ins_calibration(&read, SENSOR_ID));
+
+	flash_file_close();
+}
+
+static void test_reboot(void) {
+	const char *path = "test_ins_storage.flash";
+	INSCalibrationRecord written, read;
+
+	remove(path);
+
+	CHECK(flash_file_open(path));
+	Flash_InvalidateCache();
+	make_record(&written, 7);
+	CHECK(write_ins_calibration(EPCS_NAME, &written));
+	flash_file_close();
+
+	// the content of the flash survives, the cache of the driver does not
+	CHECK(flash_file_open(path));
+	Flash_InvalidateCache();
+	CHECK(read_ins_calibration(EPCS_NAME, &read));
+	CHECK(memcmp(&read, &written, sizeof(read)) == 0);
+	CHECK(check_ins_calibration(&read, SENSOR_ID));
+	CHECK_EQUAL(flash_file_erases, 0);
+	flash_file_close();
+
+	remove(path);
+}
+
+
+int main(void) {
+	test_round_trip();
+	test_rejected();
+	test_reboot();
+
+	return test_result("test_ins_storage");
+}
@@ -0,0 +1,165 @@
+/*
+ * test_legocar.c
+ *
+ * Driving patterns of the car (legocar.c) on PWMs whose registers are mapped to memory:
+ * 'align_wheels' has to steer the wheels also while the car stands still, without touching
+ * the engines, and 'set_driving_power' and 'stop' have to set the engines only.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "test.h"
+#include "../motor_control/legocar.h"
+#include "../motor_control/wheel_direction.h"
+
+#define PWM_PERIOD 100000
+
+// the duty of a direction motor or an engine may differ by this from the exact one (rounding
+// of the angles of the swerve drive)
+#define POWER_TOLERANCE (Q15_ONE / 100)
+
+// the registers of the 8 PWMs, in the lower 4 GB of the address space of the host
+static alt_u32 *registers;
+
+static LegoCar car;
+
+
+static void init_car(void) {
+	alt_u32 bases[8];
+	int m;
+
+	for(m=0; m<8; m++)
+		bases[m] = (alt_u32) (uintptr_t) &registers[m * PWM_REG_COUNT];
+
+	init_legocar(&car, bases, PWM_PERIOD);
+}
+
+static int direction_writes(void) {
+	int w, writes = 0;
+
+	for(w=0; w<4; w++)
+		writes += get_bus_writes(&car.direction[w]);
+	return writes;
+}
+
+static int speed_writes(void) {
+	int w, writes = 0;
+
+	for(w=0; w<4; w++)
+		writes += get_bus_writes(&car.speed[w]);
+	return writes;
+}
+
+/**
+ * Check the duty of a motor in its registers.
+ *
+ * @param power the expected power (Q15)
+ */
+static int has_power(PWM_Motor *motor, int power) {
+	volatile unsigned int *r = motor->registers;
+	int duty = (int) ((long long) abs(power) * PWM_PERIOD / Q15_ONE);
+
+	if(abs(get_power_q15(motor) - power) > POWER_TOLERANCE)
+		return 0;
+	// a motor that has never been set has not been written
+	if(power == 0 && get_bus_writes(motor) == 0)
+		return 1;
+	return abs((int) r[PWM_REG_DUTY1] - duty) <= POWER_TOLERANCE * PWM_PERIOD / Q15_ONE;
+}
+
+
+static void test_align_stopped(void) {
+	const int direction = FLOAT_TO_Q15(0.5) * TURNING_INTERVAL_Q15 / Q15_ONE;
+	int w;
+
+	init_car();
+
+	// the car stands still, the wheels are aligned anyway
+	align_wheels(&car, MOVE_DIAGONAL, 0.5);
+	for(w=0; w<4; w++)
+		CHECK(has_power(&car.direction[w], direction));
+	CHECK_EQUAL(speed_writes(), 0);
+
+	// the front left and back right wheel point backwards when rotating
+	align_wheels(&car, MOVE_ROTATE, 0);
+	CHECK(has_power(&car.direction[FRONT_LEFT],  -TURNING_INTERVAL_Q15));
+	CHECK(has_power(&car.direction[FRONT_RIGHT],  TURNING_INTERVAL_Q15));
+	CHECK(has_power(&car.direction[BACK_LEFT],    TURNING_INTERVAL_Q15));
+	CHECK(has_power(&car.direction[BACK_RIGHT],  -TURNING_INTERVAL_Q15));
+	CHECK_EQUAL(speed_writes(), 0);
+	for(w=0; w<4; w++)
+		CHECK_EQUAL(get_power_q15(&car.speed[w]), 0);
+}
+
+static void test_power_only(void) {
+	const int power = FLOAT_TO_Q15(0.5);
+	int w, writes;
+
+	init_car();
+
+	align_wheels(&car, MOVE_DIAGONAL, -0.25);
+	writes = direction_writes();
+
+	// only the engines are set
+	set_driving_power(&car, MOVE_DIAGONAL, 0.5);
+	for(w=0; w<4; w++)
+		CHECK(has_power(&car.speed[w], power));
+	CHECK_EQUAL(direction_writes(), writes);
+
+	stop(&car);
+	for(w=0; w<4; w++)
+		CHECK(has_power(&car.speed[w], 0));
+	CHECK_EQUAL(direction_writes(), writes);
+
+	// rotating: the wheels pointing backwards run backwards
+	align_wheels(&car, MOVE_ROTATE, 0);
+	writes = direction_writes();
+	set_driving_power(&car, MOVE_ROTATE, 0.5);
+	CHECK(has_power(&car.speed[FRONT_LEFT],  -power));
+	CHECK(has_power(&car.speed[FRONT_RIGHT],  power));
+	CHECK(has_power(&car.speed[BACK_LEFT],   -power));
+	CHECK(has_power(&car.speed[BACK_RIGHT],   power));
+	CHECK_EQUAL(direction_writes(), writes);
+}
+
+static void test_align_after_stop(void) {
+	int w, writes;
+
+	init_car();
+
+	drive_pattern_q15(&car, MOVE_DIAGONAL, 0, FLOAT_TO_Q15(0.5));
+	stop(&car);
+
+	// the engines stay stopped, the wheels turn
+	writes = speed_writes();
+	align_wheels(&car, MOVE_DIAGONAL, 1);
+	for(w=0; w<4; w++) {
+		CHECK(has_power(&car.direction[w], TURNING_INTERVAL_Q15));
+		CHECK_EQUAL(get_power_q15(&car.speed[w]), 0);
+	}
+	CHECK_EQUAL(speed_writes(), writes);
+
+	// and the next power drives into the new direction
+	set_driving_power(&car, MOVE_DIAGONAL, -0.5);
+	for(w=0; w<4; w++) {
+		CHECK(has_power(&car.direction[w], TURNING_INTERVAL_Q15));
+		CHECK(has_power(&car.speed[w], FLOAT_TO_Q15(-0.5)));
+	}
+}
+
+
+int main(void) {
+	registers = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	if(registers == MAP_FAILED) {
+		printf("test_legocar: cannot map the registers of the PWMs\n");
+		return 1;
+	}
+
+	test_align_stopped();
+	test_power_only();
+	test_align_after_stop();
+
+	return test_result("test_legocar");
+}
@@ -0,0 +1,210 @@
+/*
+ * test_pwm_motor.c
+ *
+ * Writes of the PWM driver to the registers of the PWM: before every step the registers are
+ * filled with a value the driver never writes, so the registers that have been written on
+ * the bus can be counted independently of the counter of the driver (get_bus_writes).
+ * The duty values of the fixed-point path are compared with the float formula
+ * ('set_power_float') over a sweep of the powers.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "test.h"
+#include "../motor_control/pwm_motor.h"
+
+// a value that is never written to a register of the PWM
+#define POISON 0xDEADBEEF
+
+#define PWM_PERIOD 100000
+
+// the registers of the PWM: the base address is alt_u32, so the registers have to be in
+// the lower 4 GB of the address space of the host
+static alt_u32 *registers;
+
+#define PWM_BASE ((alt_u32) (uintptr_t) registers)
+
+
+static void poison_registers(void) {
+	int r;
+
+	for(r=0; r<PWM_REG_COUNT; r++)
+		registers[r] = POISON;
+}
+
+/**
+ * Number of registers that have been written since 'poison_registers'.
+ */
+static int written_registers(void) {
+	int r, written = 0;
+
+	for(r=0; r<PWM_REG_COUNT; r++)
+		if(registers[r] != POISON)
+			written++;
+
+	return written;
+}
+
+
+static void test_init_and_first_update(void) {
+	PWM_Motor motor;
+
+	// the initialization does not touch the bus
+	poison_registers();
+	init_pwm_motor(&motor, PWM_BASE, PWM_PERIOD);
+	CHECK_EQUAL(written_registers(), 0);
+	CHECK_EQUAL(get_bus_writes(&motor), 0);
+
+	// the content of the registers is unknown, so the first update writes all of them
+	set_power_q15(&motor, Q15_ONE / 2);
+	CHECK_EQUAL(written_registers(), PWM_REG_COUNT);
+	CHECK_EQUAL(get_bus_writes(&motor), PWM_REG_COUNT);
+	CHECK_EQUAL(registers[PWM_REG_PERIOD], PWM_PERIOD);
+	CHECK_EQUAL(registers[PWM_REG_DUTY1], PWM_PERIOD / 2);
+}
+
+static void test_repeated_power(void) {
+	PWM_Motor motor;
+	int i;
+
+	init_pwm_motor(&motor, PWM_BASE, PWM_PERIOD);
+	set_power_q15(&motor, Q15_ONE / 4);
+	reset_bus_writes(&motor);
+
+	// the same duty again and again: nothing is written
+	poison_registers();
+	for(i=0; i<100; i++)
+		set_power_q15(&motor, Q15_ONE / 4);
+	CHECK_EQUAL(written_registers(), 0);
+	CHECK_EQUAL(get_bus_writes(&motor), 0);
+
+	// the float path produces the same duty
+	set_power(&motor, 0.25);
+	CHECK_EQUAL(written_registers(), 0);
+	CHECK_EQUAL(get_bus_writes(&motor), 0);
+}
+
+static void test_changed_power(void) {
+	PWM_Motor motor;
+
+	init_pwm_motor(&motor, PWM_BASE, PWM_PERIOD);
+	set_power_q15(&motor, Q15_ONE / 4);
+	reset_bus_writes(&motor);
+
+	// a new duty: both duty registers
+	poison_registers();
+	set_power_q15(&motor, Q15_ONE / 2);
+	CHECK_EQUAL(written_registers(), 2);
+	CHECK_EQUAL(get_bus_writes(&motor), 2);
+	CHECK_EQUAL(registers[PWM_REG_DUTY1], PWM_PERIOD / 2);
+	CHECK_EQUAL(registers[PWM_REG_DUTY2], PWM_PERIOD / 2);
+
+	// the same duty backwards: only the enable register
+	poison_registers();
+	set_power_q15(&motor, -Q15_ONE / 2);
+	CHECK_EQUAL(written_registers(), 1);
+	CHECK_EQUAL(get_bus_writes(&motor), 3);
+	CHECK(registers[PWM_REG_ENABLE] != POISON);
+
+	// a new duty and direction: enable and both duty registers
+	poison_registers();
+	set_power_q15(&motor, Q15_ONE);
+	CHECK_EQUAL(written_registers(), 3);
+	CHECK_EQUAL(get_bus_writes(&motor), 6);
+	CHECK_EQUAL(registers[PWM_REG_DUTY1], PWM_PERIOD);
+}
+
+static void test_reinit(void) {
+	PWM_Motor motor;
+
+	init_pwm_motor(&motor, PWM_BASE, PWM_PERIOD);
+	set_power_q15(&motor, Q15_ONE / 2);
+
+	// after a new initialization the registers are written again, even with the same values
+	init_pwm_motor(&motor, PWM_BASE, PWM_PERIOD);
+	poison_registers();
+	set_power_q15(&motor, Q15_ONE / 2);
+	CHECK_EQUAL(written_registers(), PWM_REG_COUNT);
+	CHECK_EQUAL(get_bus_writes(&motor), PWM_REG_COUNT);
+}
+
+/**
+ * Sweep the powers from -1 to 1 and compare the duty of the fixed-point path with the duty of the
+ * float formula on a PWM with the given period.
+ *
+ * @param exact only powers that are exact in Q15 (else any float)
+ *
+ * @result the largest difference of the duty values in counts
+ */
+static int sweep_powers(unsigned int period, int exact) {
+	PWM_Motor fixed, reference;
+	float power;
+	int i, difference, max_difference = 0, enable_mismatches = 0;
+
+	init_pwm_motor(&fixed, PWM_BASE, period);
+	init_pwm_motor(&reference, PWM_BASE + PWM_REG_COUNT * sizeof(alt_u32), period);
+
+	for(i=-10000; i<=10000; i++) {
+		if(exact)
+			power = Q15_TO_FLOAT(i * Q15_ONE / 10000);
+		else
+			power = i / 10000.0f;
+
+		set_power(&fixed, power);
+		set_power_float(&reference, power);
+
+		difference = abs((int) fixed.shadow[PWM_REG_DUTY1] - (int) reference.shadow[PWM_REG_DUTY1]);
+		if(difference > max_difference)
+			max_difference = difference;
+
+		if(fixed.shadow[PWM_REG_DUTY1] != fixed.shadow[PWM_REG_DUTY2]
+		   || fixed.shadow[PWM_REG_ENABLE] != reference.shadow[PWM_REG_ENABLE])
+			enable_mismatches++;
+	}
+
+	CHECK_EQUAL(enable_mismatches, 0);
+	return max_difference;
+}
+
+static void test_duty_sweep(void) {
+	// the period of the motors in main.c, and one that is not a multiple of Q15_ONE
+	const unsigned int periods[] = { 100000, Q15_ONE, 12345, 1000 };
+	int p, difference;
+
+	for(p=0; p<4; p++) {
+		// powers that are exact in Q15: only the rounding of the float multiplication differs
+		difference = sweep_powers(periods[p], 1);
+		CHECK(difference <= 1);
+
+		// any power: 'set_power' rounds it to Q15 first
+		difference = sweep_powers(periods[p], 0);
+		CHECK(difference <= (int) (periods[p] / Q15_ONE) + 1);
+	}
+
+	// full power forwards and backwards has the full period as duty
+	PWM_Motor motor;
+	init_pwm_motor(&motor, PWM_BASE, PWM_PERIOD);
+	set_power(&motor, 1);
+	CHECK_EQUAL(motor.shadow[PWM_REG_DUTY1], PWM_PERIOD);
+	set_power(&motor, -1);
+	CHECK_EQUAL(motor.shadow[PWM_REG_DUTY1], PWM_PERIOD);
+}
+
+
+int main(void) {
+	registers = mmap(NULL, 4096, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	if(registers == MAP_FAILED) {
+		printf("test_pwm_motor: cannot map the registers of the PWM\n");
+		return 1;
+	}
+
+	test_init_and_first_update();
+	test_repeated_power();
+	test_changed_power();
+	test_reinit();
+	test_duty_sweep();
+
+	return test_result("test_pwm_motor");
+}
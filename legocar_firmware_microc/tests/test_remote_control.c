@@ -0,0 +1,303 @@
+/*
+ * test_remote_control.c
+ *
+ * Decoding of the commands of the host (remote_control.c): the bytes are fed through a
+ * stand-in for the receiver of the UART (receive_uart_byte), each with the system time of its
+ * arrival, as the interrupt of uart_0 stores them. Valid commands have to be decoded, garbage
+ * rejected without losing the next command, the number of commands per call limited, a lost
+ * connection detected and the latency measured from the arrival of the last byte.
+ */
+
+#include <string.h>
+
+#include "test.h"
+#include "hal_stubs.h"
+#include "../common/crc32.h"
+#include "../telemetry/uart_telemetry.h"
+#include "../telemetry/remote_control.h"
+
+#define RECEIVER_SIZE 4096
+
+// the bytes "received" by the UART and their arrival times
+static alt_u8  received[RECEIVER_SIZE];
+static alt_u32 arrival[RECEIVER_SIZE];
+static int     received_in, received_out;
+
+// the commands passed to 'apply'
+static RemoteCommand applied[16];
+static int           applied_count;
+
+
+int receive_uart_byte(alt_u8 *byte, alt_u32 *time) {
+	if(received_out == received_in)
+		return 0;
+
+	*byte = received[received_out];
+	*time = arrival[received_out];
+	received_out++;
+	return 1;
+}
+
+static void receive_bytes(const alt_u8 *data, int size) {
+	int i;
+
+	for(i=0; i<size && received_in < RECEIVER_SIZE; i++) {
+		received[received_in] = data[i];
+		arrival[received_in]  = host_nticks;
+		received_in++;
+	}
+}
+
+static int bytes_waiting(void) {
+	return received_in - received_out;
+}
+
+/**
+ * Encode a frame with COBS, including the terminating zero (as tools/remote_command.c).
+ */
+static int encode_frame(const alt_u8 *data, int size, alt_u8 *encoded) {
+	int code = 0, out = 1, i;
+
+	for(i=0; i<size; i++) {
+		if(data[i] != 0)
+			encoded[out++] = data[i];
+
+		if(data[i] == 0 || out - code == 0xFF) {
+			encoded[code] = out - code;
+			code = out++;
+		}
+	}
+
+	encoded[code] = out - code;
+	encoded[out++] = 0;
+
+	return out;
+}
+
+/**
+ * Send a command as the host does.
+ *
+ * @param length the length in the header (-1: the size of the payload)
+ * @param crc_error 1: the CRC is wrong
+ *
+ * @result number of bytes sent
+ */
+static int send_frame(alt_u8 type, alt_u8 sequence, const void *payload, int size, int length, int crc_error) {
+	alt_u8 frame[sizeof(CommandHeader) + 64 + sizeof(alt_u32)], encoded[2 * sizeof(frame)];
+	CommandHeader header = { type, sequence, length < 0 ? size : length };
+	alt_u32 crc;
+	int encoded_size;
+
+	memcpy(frame, &header, sizeof(header));
+	memcpy(frame + sizeof(header), payload, size);
+	crc = crc32(frame, sizeof(header) + size) ^ crc_error;
+	memcpy(frame + sizeof(header) + size, &crc, sizeof(crc));
+
+	encoded_size = encode_frame(frame, sizeof(header) + size + sizeof(crc), encoded);
+	receive_bytes(encoded, encoded_size);
+	return encoded_size;
+}
+
+static int send_velocity(alt_u8 sequence, alt_16 direction, alt_16 power) {
+	CommandVelocity velocity = { direction, power };
+	return send_frame(COMMAND_VELOCITY, sequence, &velocity, sizeof(velocity), -1, 0);
+}
+
+static void apply(const RemoteCommand *command) {
+	if(applied_count < 16)
+		applied[applied_count++] = *command;
+	command_applied(command);
+}
+
+static void reset(void) {
+	RemoteCommand command;
+
+	// a zero ends any frame that has been started
+	receive_bytes((const alt_u8 *) "", 1);
+	while(receive_command(&command, RECEIVER_SIZE))
+		;
+	received_in = received_out = 0;
+	applied_count = 0;
+}
+
+
+static void test_decode(void) {
+	CommandRotate rotate = { -12000 };
+	RemoteCommand command;
+	RemoteControlStats before, stats;
+
+	reset();
+	get_remote_control_stats(&before);
+
+	host_nticks = 500;
+	send_velocity(7, 0x1234, -5000);
+	CHECK(receive_command(&command, RECEIVER_SIZE));
+	CHECK_EQUAL(command.type, COMMAND_VELOCITY);
+	CHECK_EQUAL(command.sequence, 7);
+	CHECK_EQUAL(command.direction, 0x1234);
+	CHECK_EQUAL(command.power, -5000);
+	CHECK_EQUAL(command.received, 500);
+
+	// zeros in the frame are encoded by COBS
+	send_velocity(0, 0, 0x7FFF);
+	CHECK(receive_command(&command, RECEIVER_SIZE));
+	CHECK_EQUAL(command.sequence, 0);
+	CHECK_EQUAL(command.direction, 0);
+	CHECK_EQUAL(command.power, 0x7FFF);
+
+	send_frame(COMMAND_ROTATE, 8, &rotate, sizeof(rotate), -1, 0);
+	send_frame(COMMAND_STOP, 9, NULL, 0, -1, 0);
+	send_frame(COMMAND_QUERY, 10, NULL, 0, -1, 0);
+	CHECK(receive_command(&command, RECEIVER_SIZE));
+	CHECK_EQUAL(command.type, COMMAND_ROTATE);
+	CHECK_EQUAL(command.power, -12000);
+	CHECK(receive_command(&command, RECEIVER_SIZE));
+	CHECK_EQUAL(command.type, COMMAND_STOP);
+	CHECK(receive_command(&command, RECEIVER_SIZE));
+	CHECK_EQUAL(command.type, COMMAND_QUERY);
+	CHECK_EQUAL(command.sequence, 10);
+	CHECK(!receive_command(&command, RECEIVER_SIZE));
+
+	get_remote_control_stats(&stats);
+	CHECK_EQUAL(stats.commands - before.commands, 5);
+	CHECK_EQUAL(stats.errors - before.errors, 0);
+}
+
+static void test_garbage(void) {
+	static const alt_u8 noise[] = { 0x03, 0x41, 0x42, 0x43, 0x7E, 0x00, 0x05, 0x01, 0x00 };
+	alt_u8 long_frame[300];
+	CommandVelocity velocity = { 100, 200 };
+	CommandRotate rotate = { 300 };
+	RemoteCommand command;
+	RemoteControlStats before, stats;
+
+	reset();
+	get_remote_control_stats(&before);
+
+	// each of them is rejected, the valid command after them is decoded
+	receive_bytes(noise, sizeof(noise));
+	send_frame(COMMAND_VELOCITY, 1, &velocity, sizeof(velocity), -1, 1);                 // CRC
+	send_frame(COMMAND_VELOCITY, 2, &velocity, sizeof(velocity), sizeof(velocity) + 1, 0); // length
+	send_frame(COMMAND_VELOCITY, 3, &rotate, sizeof(rotate), -1, 0);                     // size of the payload
+	send_frame(COMMAND_STOP, 4, &rotate, sizeof(rotate), -1, 0);
+	send_frame(99, 5, NULL, 0, -1, 0);                                                   // type
+	memset(long_frame, 0x55, sizeof(long_frame));
+	receive_bytes(long_frame, sizeof(long_frame));                                       // too long
+	receive_bytes((const alt_u8 *) "\0\0\0", 3);                                         // empty frames
+	send_velocity(6, 1000, 2000);
+
+	CHECK(receive_command(&command, RECEIVER_SIZE));
+	CHECK_EQUAL(command.sequence, 6);
+	CHECK_EQUAL(command.direction, 1000);
+	CHECK_EQUAL(bytes_waiting(), 0);
+
+	get_remote_control_stats(&stats);
+	CHECK_EQUAL(stats.commands - before.commands, 1);
+	CHECK_EQUAL(stats.errors - before.errors, 8);
+
+	// a frame cut off by a lost byte
+	send_velocity(7, 1000, 2000);
+	received_in -= 3;
+	received[received_in++] = 0;
+	send_velocity(8, 1000, 2000);
+	CHECK(receive_command(&command, RECEIVER_SIZE));
+	CHECK_EQUAL(command.sequence, 8);
+	get_remote_control_stats(&stats);
+	CHECK_EQUAL(stats.errors - before.errors, 9);
+}
+
+static void test_limits(void) {
+	RemoteCommand command;
+	int size, i;
+
+	reset();
+
+	// at most max_bytes per call, the rest of the frame is decoded in the next call
+	size = send_velocity(1, 10, 20);
+	CHECK(!receive_command(&command, size - 1));
+	CHECK_EQUAL(bytes_waiting(), 1);
+	CHECK(receive_command(&command, size));
+	CHECK_EQUAL(command.sequence, 1);
+
+	// at most max_commands per call
+	for(i=0; i<6; i++)
+		send_velocity(10 + i, i, i);
+	CHECK_EQUAL(apply_commands(apply, 4, 64), 4);
+	CHECK_EQUAL(applied_count, 4);
+	CHECK_EQUAL(applied[3].sequence, 13);
+	CHECK_EQUAL(apply_commands(apply, 4, 64), 2);
+	CHECK_EQUAL(applied[5].sequence, 15);
+	CHECK_EQUAL(apply_commands(apply, 4, 64), 0);
+}
+
+static void test_timeout(void) {
+	reset();
+
+	// a command at 2000, the timeout is 1000 ticks
+	host_nticks = 2000;
+	send_velocity(1, 0, 100);
+	CHECK_EQUAL(apply_commands(apply, 4, 64), 1);
+
+	host_nticks = 3000;
+	CHECK(!command_timeout(1000));
+	host_nticks = 3001;
+	CHECK(command_timeout(1000));
+	// reported once
+	host_nticks = 5000;
+	CHECK(!command_timeout(1000));
+
+	// the next command starts the time again, invalid frames do not
+	send_frame(COMMAND_STOP, 2, NULL, 0, -1, 1);
+	CHECK_EQUAL(apply_commands(apply, 4, 64), 0);
+	host_nticks = 7000;
+	CHECK(!command_timeout(1000));
+	send_frame(COMMAND_QUERY, 3, NULL, 0, -1, 0);
+	CHECK_EQUAL(apply_commands(apply, 4, 64), 1);
+	host_nticks = 8000;
+	CHECK(!command_timeout(1000));
+	host_nticks = 8001;
+	CHECK(command_timeout(1000));
+}
+
+static void test_latency(void) {
+	RemoteControlStats stats;
+
+	reset();
+
+	// the last byte arrives at 10000, the control task applies the command 3 ticks later
+	host_nticks = 10000;
+	send_velocity(1, 0, 100);
+	host_nticks = 10003;
+	CHECK_EQUAL(apply_commands(apply, 4, 64), 1);
+	CHECK_EQUAL(applied[0].received, 10000);
+	get_remote_control_stats(&stats);
+	CHECK_EQUAL(stats.latency_last, 3);
+
+	// the arrival of the last byte counts, not of the first one
+	host_nticks = 11000;
+	send_velocity(2, 0, 100);
+	arrival[received_in - 1] = 11050;
+	host_nticks = 11150;
+	CHECK_EQUAL(apply_commands(apply, 4, 64), 1);
+	get_remote_control_stats(&stats);
+	CHECK_EQUAL(stats.latency_last, 100);
+	CHECK(stats.latency_max >= 100);
+
+	host_nticks = 12000;
+	send_velocity(3, 0, 100);
+	CHECK_EQUAL(apply_commands(apply, 4, 64), 1);
+	get_remote_control_stats(&stats);
+	CHECK_EQUAL(stats.latency_last, 0);
+	CHECK(stats.latency_max >= 100);
+}
+
+
+int main(void) {
+	test_decode();
+	test_garbage();
+	test_limits();
+	test_timeout();
+	test_latency();
+
+	return test_result("test_remote_control");
+}
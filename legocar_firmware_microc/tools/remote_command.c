@@ -0,0 +1,193 @@
+/*
+ * remote_command.c
+ *
+ * Host tool: send a command to the car (see telemetry/remote_control.h) over the serial port.
+ * The answer to 'query' is a TELEMETRY_STATE record in the telemetry stream, which is decoded
+ * with telemetry_decode.
+ *
+ * Build:  gcc -O2 -o remote_command remote_command.c
+ * Usage:  remote_command [-s sequence] [-p period_ms] device command
+ *
+ * Commands:
+ *   velocity <direction> <power>   align the wheels and drive (both between -1 and 1)
+ *   rotate <power>                 rotate on the spot
+ *   stop
+ *   query
+ *
+ * The car stops by itself, if it does not receive a command for one second. With -p the
+ * command is repeated with the given period until the tool is interrupted. If the device is
+ * "-", the frame is written to stdout.
+ *
+ *  Created on: 17.10.2026
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+
+// must match telemetry/remote_control.h
+#define COMMAND_VELOCITY 1
+#define COMMAND_ROTATE   2
+#define COMMAND_STOP     3
+#define COMMAND_QUERY    4
+
+#define HEADER_SIZE      4
+#define MAX_PAYLOAD      8
+#define CRC_SIZE         4
+#define FRAME_SIZE       (HEADER_SIZE + MAX_PAYLOAD + CRC_SIZE)
+
+
+static uint32_t crc32(const uint8_t *data, size_t size) {
+	uint32_t crc = 0xFFFFFFFF;
+	int bit;
+
+	while(size--) {
+		crc ^= *data++;
+		for(bit=0; bit<8; bit++)
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	}
+
+	return crc ^ 0xFFFFFFFF;
+}
+
+static void put_u16(uint8_t *data, uint16_t value) {
+	data[0] = value & 0xFF;
+	data[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *data, uint32_t value) {
+	put_u16(data, value & 0xFFFF);
+	put_u16(data + 2, value >> 16);
+}
+
+static int16_t to_q15(const char *text) {
+	double value = atof(text) * 32768;
+
+	if(value > 32767)
+		value = 32767;
+	if(value < -32768)
+		value = -32768;
+
+	return (int16_t) (value + (value < 0 ? -0.5 : 0.5));
+}
+
+/**
+ * Encode a frame with COBS, including the terminating zero.
+ */
+static size_t cobs_encode(const uint8_t *data, size_t size, uint8_t *encoded) {
+	size_t code = 0, out = 1, i;
+
+	for(i=0; i<size; i++) {
+		if(data[i] != 0)
+			encoded[out++] = data[i];
+
+		if(data[i] == 0 || out - code == 0xFF) {
+			encoded[code] = out - code;
+			code = out++;
+		}
+	}
+
+	encoded[code] = out - code;
+	encoded[out++] = 0;
+
+	return out;
+}
+
+/**
+ * Switch a serial port to raw mode with the baud rate of uart_0.
+ */
+static void configure_port(int fd) {
+	struct termios tio;
+
+	if(!isatty(fd) || tcgetattr(fd, &tio) != 0)
+		return;
+
+	cfmakeraw(&tio);
+	cfsetispeed(&tio, B115200);
+	cfsetospeed(&tio, B115200);
+	tcsetattr(fd, TCSANOW, &tio);
+}
+
+static void usage(const char *name) {
+	fprintf(stderr, "usage: %s [-s sequence] [-p period_ms] device velocity <direction> <power> | rotate <power> | stop | query\n", name);
+	exit(1);
+}
+
+int main(int argc, char **argv) {
+	uint8_t frame[FRAME_SIZE];
+	uint8_t encoded[FRAME_SIZE + 2];
+	int sequence = 0, period = 0, length = 0, type, fd, i = 1;
+	const char *device, *command;
+	size_t size;
+
+	while(i < argc && argv[i][0] == '-' && argv[i][1] != '\0') {
+		if(strcmp(argv[i], "-s") == 0 && i+1 < argc)
+			sequence = atoi(argv[i+1]);
+		else if(strcmp(argv[i], "-p") == 0 && i+1 < argc)
+			period = atoi(argv[i+1]);
+		else
+			usage(argv[0]);
+		i += 2;
+	}
+
+	if(i+1 >= argc)
+		usage(argv[0]);
+	device  = argv[i++];
+	command = argv[i++];
+
+	if(strcmp(command, "velocity") == 0 && i+1 < argc) {
+		type = COMMAND_VELOCITY;
+		put_u16(frame + HEADER_SIZE, to_q15(argv[i]));
+		put_u16(frame + HEADER_SIZE + 2, to_q15(argv[i+1]));
+		length = 4;
+	}
+	else if(strcmp(command, "rotate") == 0 && i < argc) {
+		type = COMMAND_ROTATE;
+		put_u16(frame + HEADER_SIZE, to_q15(argv[i]));
+		length = 2;
+	}
+	else if(strcmp(command, "stop") == 0) {
+		type = COMMAND_STOP;
+	}
+	else if(strcmp(command, "query") == 0) {
+		type = COMMAND_QUERY;
+	}
+	else {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if(strcmp(device, "-") == 0) {
+		fd = STDOUT_FILENO;
+	}
+	else if((fd = open(device, O_WRONLY | O_NOCTTY)) < 0) {
+		perror(device);
+		return 1;
+	}
+	configure_port(fd);
+
+	do {
+		frame[0] = type;
+		frame[1] = sequence++ & 0xFF;
+		put_u16(frame + 2, length);
+		put_u32(frame + HEADER_SIZE + length, crc32(frame, HEADER_SIZE + length));
+
+		size = cobs_encode(frame, HEADER_SIZE + length + CRC_SIZE, encoded);
+		if(write(fd, encoded, size) != (ssize_t) size) {
+			perror(device);
+			return 1;
+		}
+
+		if(period > 0)
+			usleep(period * 1000);
+	} while(period > 0);
+
+	if(fd != STDOUT_FILENO)
+		close(fd);
+
+	return 0;
+}
@@ -0,0 +1,268 @@
+/*
+ * telemetry_decode.c
+ *
+ * Host tool: decode the telemetry stream of the car (see telemetry/uart_telemetry.h) into CSV.
+ * The frames are separated at the zero bytes and decoded with COBS, frames with a wrong CRC or
+ * size are skipped. Gaps in the sequence numbers are counted as lost records.
+ *
+ * Build:  gcc -O2 -o telemetry_decode telemetry_decode.c
+ * Usage:  telemetry_decode [-r session|ins|motor|tasks|state] [file]
+ *
+ * Without a file the stream is read from stdin, e.g. from the serial port:
+ *   stty -F /dev/ttyUSB0 115200 raw && telemetry_decode -r ins /dev/ttyUSB0 > ins.csv
+ *
+ * With -r only the records of one type are written, with a header line. Otherwise all
+ * records are written, the first column is the type.
+ *
+ *  Created on: 17.10.2026
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+// must match telemetry/uart_telemetry.h
+#define TELEMETRY_VERSION     1
+#define TELEMETRY_MAX_PAYLOAD 64
+#define HEADER_SIZE           8
+#define CRC_SIZE              4
+#define FRAME_SIZE            (HEADER_SIZE + TELEMETRY_MAX_PAYLOAD + CRC_SIZE)
+
+#define TELEMETRY_SESSION 0
+#define TELEMETRY_INS     1
+#define TELEMETRY_MOTOR   2
+#define TELEMETRY_TASKS   3
+#define TELEMETRY_STATE   4
+#define TELEMETRY_TYPES   5
+
+
+static const char *record_names[TELEMETRY_TYPES] = { "session", "ins", "motor", "tasks", "state" };
+
+static const char *record_columns[TELEMETRY_TYPES] = {
+	"version,ticks_per_second",
+	"sample_x,sample_y,sample_z,samples,acc_x,acc_y,acc_z,speed_x,speed_y,speed_z",
+	"mode,speed_fl,speed_fr,speed_bl,speed_br,direction_fl,direction_fr,direction_bl,direction_br",
+	"releases_1khz,releases_100hz,releases_10hz,misses_1khz,misses_100hz,misses_10hz,"
+	"overruns_1khz,overruns_100hz,overruns_10hz,dropped",
+	"command_sequence,mode,direction,power,commands,errors,latency_last,latency_max"
+};
+
+// size of the payload of every type
+static const unsigned record_sizes[TELEMETRY_TYPES] = { 8, 32, 20, 40, 24 };
+
+
+static unsigned long ticks_per_second = 1000;
+
+
+static uint32_t crc32(const uint8_t *data, size_t size) {
+	uint32_t crc = 0xFFFFFFFF;
+	int bit;
+
+	while(size--) {
+		crc ^= *data++;
+		for(bit=0; bit<8; bit++)
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	}
+
+	return crc ^ 0xFFFFFFFF;
+}
+
+static uint16_t get_u16(const uint8_t *data) {
+	return data[0] | (data[1] << 8);
+}
+
+static uint32_t get_u32(const uint8_t *data) {
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+static int16_t get_i16(const uint8_t *data) {
+	return (int16_t) get_u16(data);
+}
+
+static float get_float(const uint8_t *data) {
+	uint32_t bits = get_u32(data);
+	float value;
+
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static double q15(const uint8_t *data) {
+	return get_i16(data) / 32768.0;
+}
+
+/**
+ * Decode a COBS frame (without the terminating zero).
+ *
+ * @result size of the decoded frame, -1: the frame is invalid or too long
+ */
+static int cobs_decode(const uint8_t *encoded, size_t size, uint8_t *data, size_t max_size) {
+	size_t in = 0, out = 0;
+	uint8_t code, i;
+
+	while(in < size) {
+		code = encoded[in++];
+		if(code == 0)
+			return -1;
+
+		for(i=1; i<code; i++) {
+			if(in >= size || out >= max_size)
+				return -1;
+			data[out++] = encoded[in++];
+		}
+
+		// a block shorter than 254 bytes ends with a zero, except at the end of the frame
+		if(code != 0xFF && in < size) {
+			if(out >= max_size)
+				return -1;
+			data[out++] = 0;
+		}
+	}
+
+	return out;
+}
+
+static void print_record(int type, int sequence, uint32_t timestamp, const uint8_t *p, int with_type) {
+	int i;
+
+	if(with_type)
+		printf("%s,", record_names[type]);
+	printf("%d,%lu,%.3f", sequence, (unsigned long) timestamp, (double) timestamp / ticks_per_second);
+
+	switch(type) {
+	case TELEMETRY_SESSION:
+		printf(",%lu,%lu", (unsigned long) get_u32(p), (unsigned long) get_u32(p + 4));
+		break;
+
+	case TELEMETRY_INS:
+		for(i=0; i<4; i++)
+			printf(",%d", get_i16(p + 2*i));
+		for(i=0; i<6; i++)
+			printf(",%.4f", get_float(p + 8 + 4*i));
+		break;
+
+	case TELEMETRY_MOTOR:
+		printf(",%ld", (long) (int32_t) get_u32(p));
+		for(i=0; i<8; i++)
+			printf(",%.4f", q15(p + 4 + 2*i));
+		break;
+
+	case TELEMETRY_TASKS:
+		for(i=0; i<10; i++)
+			printf(",%lu", (unsigned long) get_u32(p + 4*i));
+		break;
+
+	case TELEMETRY_STATE:
+		printf(",%d,%d,%.4f,%.4f", p[0], p[1], q15(p + 2), q15(p + 4));
+		for(i=0; i<4; i++)
+			printf(",%lu", (unsigned long) get_u32(p + 8 + 4*i));
+		break;
+	}
+
+	printf("\n");
+}
+
+int main(int argc, char **argv) {
+	uint8_t encoded[2 * FRAME_SIZE];
+	uint8_t frame[FRAME_SIZE];
+	unsigned long frames = 0, errors = 0, lost = 0, records = 0;
+	size_t fill = 0;
+	int filter = -1, next_sequence = -1;
+	int c, i, size, type, sequence, length, gap;
+	const char *path = NULL;
+	FILE *in = stdin;
+
+	for(i=1; i<argc; i++) {
+		if(strcmp(argv[i], "-r") == 0 && i+1 < argc) {
+			for(type=0; type<TELEMETRY_TYPES; type++)
+				if(strcmp(argv[i+1], record_names[type]) == 0)
+					filter = type;
+			if(filter < 0) {
+				fprintf(stderr, "unknown record type: %s\n", argv[i+1]);
+				return 1;
+			}
+			i++;
+		}
+		else if(argv[i][0] == '-') {
+			fprintf(stderr, "usage: %s [-r session|ins|motor|tasks|state] [file]\n", argv[0]);
+			return 1;
+		}
+		else {
+			path = argv[i];
+		}
+	}
+
+	if(path && !(in = fopen(path, "rb"))) {
+		perror(path);
+		return 1;
+	}
+
+	if(filter >= 0)
+		printf("sequence,timestamp,time,%s\n", record_columns[filter]);
+	else
+		printf("record,sequence,timestamp,time,...\n");
+
+	while((c = fgetc(in)) != EOF) {
+		if(c != 0) {
+			// too long for a frame: skip it up to the next zero
+			if(fill < sizeof(encoded))
+				encoded[fill] = c;
+			fill++;
+			continue;
+		}
+
+		if(fill == 0)
+			continue;
+
+		frames++;
+		size = (fill <= sizeof(encoded)) ? cobs_decode(encoded, fill, frame, sizeof(frame)) : -1;
+		fill = 0;
+
+		if(size < HEADER_SIZE + CRC_SIZE
+		   || crc32(frame, size - CRC_SIZE) != get_u32(frame + size - CRC_SIZE)) {
+			errors++;
+			continue;
+		}
+
+		type     = frame[0];
+		sequence = frame[1];
+		length   = get_u16(frame + 2);
+		if(length != size - HEADER_SIZE - CRC_SIZE || type >= TELEMETRY_TYPES || length < (int) record_sizes[type]) {
+			errors++;
+			continue;
+		}
+
+		// the sequence starts anew with every session
+		if(type == TELEMETRY_SESSION) {
+			ticks_per_second = get_u32(frame + HEADER_SIZE + 4);
+			if(ticks_per_second == 0)
+				ticks_per_second = 1000;
+			if(get_u32(frame + HEADER_SIZE) != TELEMETRY_VERSION)
+				fprintf(stderr, "warning: telemetry version %lu, expected %d\n",
+				        (unsigned long) get_u32(frame + HEADER_SIZE), TELEMETRY_VERSION);
+		}
+		else if(next_sequence >= 0) {
+			gap = (sequence - next_sequence) & 0xFF;
+			// records sent by two tasks at once may also arrive swapped, the late one is no gap
+			if(gap >= 0x80) {
+				records++;
+				if(filter < 0 || filter == type)
+					print_record(type, sequence, get_u32(frame + 4), frame + HEADER_SIZE, filter < 0);
+				continue;
+			}
+			lost += gap;
+		}
+		next_sequence = (sequence + 1) & 0xFF;
+
+		records++;
+		if(filter < 0 || filter == type)
+			print_record(type, sequence, get_u32(frame + 4), frame + HEADER_SIZE, filter < 0);
+	}
+
+	fprintf(stderr, "%lu frames, %lu records, %lu invalid, %lu lost\n", frames, records, errors, lost);
+
+	if(in != stdin)
+		fclose(in);
+
+	return 0;
+}